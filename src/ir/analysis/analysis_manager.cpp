@@ -0,0 +1,122 @@
+#include "ir/analysis/analysis_manager.h"
+#include "ir/analysis/bounds_analysis.h"
+#include "ir/analysis/graph_analyzer.h"
+#include "ir/analysis/linear_order.h"
+#include "ir/analysis/liveness_analyzer.h"
+#include "ir/analysis/loop_analyzer.h"
+#include "ir/graph.h"
+
+AnalysisManager::AnalysisManager(Graph *graph)
+    : graph_(graph), linear_order_mode_(analysis::LinearOrderMode::LOOP_CONTIGUOUS) {}
+
+// Dependents hold pointers into their prerequisites, so they must go first.
+AnalysisManager::~AnalysisManager() { InvalidateAll(); }
+
+GraphAnalyzer &AnalysisManager::GetGraphAnalyzer() {
+    if (graph_analyzer_ == nullptr) {
+        graph_analyzer_ = std::make_unique<GraphAnalyzer>(graph_);
+        graph_analyzer_->BuildDominatorTree();
+        ++compute_counts_[static_cast<size_t>(AnalysisKind::DOMINATORS)];
+    }
+    return *graph_analyzer_;
+}
+
+LoopAnalyzer &AnalysisManager::GetLoopAnalyzer() {
+    if (loop_analyzer_ == nullptr) {
+        GraphAnalyzer &dominators = GetGraphAnalyzer();
+        loop_analyzer_ = std::make_unique<LoopAnalyzer>(graph_, &dominators);
+        loop_analyzer_->Analyze();
+        ++compute_counts_[static_cast<size_t>(AnalysisKind::LOOPS)];
+    }
+    return *loop_analyzer_;
+}
+
+analysis::BoundsAnalysis &AnalysisManager::GetBoundsAnalysis() {
+    if (bounds_analysis_ == nullptr) {
+        LoopAnalyzer &loops = GetLoopAnalyzer();
+        bounds_analysis_ = std::make_unique<analysis::BoundsAnalysis>(graph_);
+        bounds_analysis_->Run(&loops);
+        ++compute_counts_[static_cast<size_t>(AnalysisKind::BOUNDS)];
+    }
+    return *bounds_analysis_;
+}
+
+analysis::LinearOrder &AnalysisManager::GetLinearOrder() {
+    if (linear_order_ == nullptr) {
+        GraphAnalyzer &dominators = GetGraphAnalyzer();
+        if (linear_order_mode_ == analysis::LinearOrderMode::RPO) {
+            linear_order_ = std::make_unique<analysis::LinearOrder>(graph_, dominators);
+        } else {
+            linear_order_ = std::make_unique<analysis::LinearOrder>(graph_, dominators, GetLoopAnalyzer());
+        }
+        ++compute_counts_[static_cast<size_t>(AnalysisKind::LINEAR_ORDER)];
+    }
+    return *linear_order_;
+}
+
+analysis::LivenessAnalyzer &AnalysisManager::GetLivenessAnalyzer() {
+    if (liveness_analyzer_ == nullptr) {
+        analysis::LinearOrder &linear_order = GetLinearOrder();
+        LoopAnalyzer &loops = GetLoopAnalyzer();
+        liveness_analyzer_ = std::make_unique<analysis::LivenessAnalyzer>(graph_, &linear_order, &loops);
+        liveness_analyzer_->Analyze();
+        ++compute_counts_[static_cast<size_t>(AnalysisKind::LIVENESS)];
+    }
+    return *liveness_analyzer_;
+}
+
+bool AnalysisManager::IsValid(AnalysisKind kind) const {
+    switch (kind) {
+    case AnalysisKind::DOMINATORS: return graph_analyzer_ != nullptr;
+    case AnalysisKind::LOOPS: return loop_analyzer_ != nullptr;
+    case AnalysisKind::BOUNDS: return bounds_analysis_ != nullptr;
+    case AnalysisKind::LINEAR_ORDER: return linear_order_ != nullptr;
+    case AnalysisKind::LIVENESS: return liveness_analyzer_ != nullptr;
+    }
+    return false;
+}
+
+void AnalysisManager::Invalidate(AnalysisKind kind) {
+    // Drop the dependents before the analysis itself.
+    switch (kind) {
+    case AnalysisKind::DOMINATORS:
+        Invalidate(AnalysisKind::LOOPS);
+        Invalidate(AnalysisKind::LINEAR_ORDER);
+        graph_analyzer_.reset();
+        break;
+    case AnalysisKind::LOOPS:
+        Invalidate(AnalysisKind::BOUNDS);
+        Invalidate(AnalysisKind::LINEAR_ORDER);
+        Invalidate(AnalysisKind::LIVENESS);
+        loop_analyzer_.reset();
+        break;
+    case AnalysisKind::BOUNDS:
+        bounds_analysis_.reset();
+        break;
+    case AnalysisKind::LINEAR_ORDER:
+        Invalidate(AnalysisKind::LIVENESS);
+        linear_order_.reset();
+        break;
+    case AnalysisKind::LIVENESS:
+        liveness_analyzer_.reset();
+        break;
+    }
+}
+
+void AnalysisManager::SetLinearOrderMode(analysis::LinearOrderMode mode) {
+    if (mode != linear_order_mode_) {
+        linear_order_mode_ = mode;
+        Invalidate(AnalysisKind::LINEAR_ORDER);
+    }
+}
+
+void AnalysisManager::InvalidateAll() { Invalidate(AnalysisKind::DOMINATORS); }
+
+void AnalysisManager::KeepOnly(AnalysisSet preserved) {
+    for (size_t i = 0; i < NUM_KINDS; ++i) {
+        auto kind = static_cast<AnalysisKind>(i);
+        if (!preserved.Contains(kind)) {
+            Invalidate(kind);
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+
+class Graph;
+class GraphAnalyzer;
+class LoopAnalyzer;
+
+namespace analysis {
+class BoundsAnalysis;
+class LinearOrder;
+class LivenessAnalyzer;
+enum class LinearOrderMode;
+} // namespace analysis
+
+enum class AnalysisKind : uint8_t {
+    DOMINATORS,
+    LOOPS,
+    BOUNDS,
+    LINEAR_ORDER,
+    LIVENESS,
+};
+
+// Set of analyses a pass keeps valid.
+class AnalysisSet {
+  public:
+    constexpr AnalysisSet() = default;
+    constexpr AnalysisSet(std::initializer_list<AnalysisKind> kinds) {
+        for (AnalysisKind kind : kinds) {
+            bits_ |= Bit(kind);
+        }
+    }
+
+    static constexpr AnalysisSet None() { return {}; }
+    // Analyses that only look at the CFG; preserved by passes that rewrite instructions but keep the blocks.
+    static constexpr AnalysisSet ControlFlow() {
+        return {AnalysisKind::DOMINATORS, AnalysisKind::LOOPS, AnalysisKind::LINEAR_ORDER};
+    }
+
+    constexpr bool Contains(AnalysisKind kind) const { return (bits_ & Bit(kind)) != 0; }
+    constexpr void Insert(AnalysisKind kind) { bits_ |= Bit(kind); }
+    constexpr void Remove(AnalysisKind kind) { bits_ &= ~Bit(kind); }
+
+  private:
+    static constexpr uint32_t Bit(AnalysisKind kind) { return 1U << static_cast<uint32_t>(kind); }
+
+    uint32_t bits_ = 0;
+};
+
+// Lazily computes and caches the analyses of one Graph, so that passes share a single
+// dominator tree, loop forest, etc. instead of each rebuilding its own. Results stay cached
+// until they are invalidated: a pass that changes the graph reports what it preserved with
+// KeepOnly(), and invalidating an analysis also drops everything computed on top of it.
+class AnalysisManager {
+  public:
+    explicit AnalysisManager(Graph *graph);
+    ~AnalysisManager();
+
+    AnalysisManager(const AnalysisManager &) = delete;
+    AnalysisManager &operator=(const AnalysisManager &) = delete;
+
+    // RPO and dominator tree.
+    GraphAnalyzer &GetGraphAnalyzer();
+    LoopAnalyzer &GetLoopAnalyzer();
+    analysis::BoundsAnalysis &GetBoundsAnalysis();
+    analysis::LinearOrder &GetLinearOrder();
+    analysis::LivenessAnalyzer &GetLivenessAnalyzer();
+
+    bool IsValid(AnalysisKind kind) const;
+
+    // Layout used for the linear order (and thus liveness); loop-contiguous unless set otherwise.
+    void SetLinearOrderMode(analysis::LinearOrderMode mode);
+
+    void Invalidate(AnalysisKind kind);
+    void InvalidateAll();
+    // Invalidates every analysis that is not in `preserved` or that depends on one that is not.
+    void KeepOnly(AnalysisSet preserved);
+
+    // Number of times an analysis was (re)computed; lets tests check that results are reused.
+    uint32_t GetComputeCount(AnalysisKind kind) const { return compute_counts_[static_cast<size_t>(kind)]; }
+
+  private:
+    static constexpr size_t NUM_KINDS = static_cast<size_t>(AnalysisKind::LIVENESS) + 1;
+
+    Graph *graph_;
+    std::unique_ptr<GraphAnalyzer> graph_analyzer_;
+    std::unique_ptr<LoopAnalyzer> loop_analyzer_;
+    std::unique_ptr<analysis::BoundsAnalysis> bounds_analysis_;
+    std::unique_ptr<analysis::LinearOrder> linear_order_;
+    std::unique_ptr<analysis::LivenessAnalyzer> liveness_analyzer_;
+    uint32_t compute_counts_[NUM_KINDS] = {};
+    analysis::LinearOrderMode linear_order_mode_;
+};
@@ -40,6 +40,7 @@ static ConditionCode SwapConditionCode(ConditionCode cc) {
 }
 
 void BoundsAnalysis::Run(LoopAnalyzer *analyzer) {
+    loop_bounds_.Reset(graph_->GetBlockIdLimit());
     for (Loop *loop : analyzer->GetLoops()) {
         AnalyzeLoop(loop);
     }
@@ -155,11 +156,8 @@ void BoundsAnalysis::AnalyzeLoop(Loop *loop) {
 }
 
 const LoopBounds *BoundsAnalysis::GetLoopBounds(Loop *loop) const {
-    auto it = loop_bounds_.find(loop->GetHeader());
-    if (it != loop_bounds_.end()) {
-        return &it->second;
-    }
-    return nullptr;
+    const LoopBounds &bounds = loop_bounds_[loop->GetHeader()];
+    return bounds.is_countable ? &bounds : nullptr;
 }
 
 } // namespace analysis
@@ -3,7 +3,7 @@
 #include "ir/types.h"
 #include "ir/graph.h"
 #include "ir/analysis/loop_analyzer.h"
-#include <unordered_map>
+#include "ir/analysis/side_table.h"
 
 namespace analysis {
 
@@ -11,7 +11,7 @@ struct LoopBounds {
     Instruction *init = nullptr;
     Instruction *test = nullptr;
     Instruction *step = nullptr;
-    ConditionCode cc;
+    ConditionCode cc = ConditionCode::EQ;
     bool is_countable = false;
 };
 
@@ -25,7 +25,7 @@ class BoundsAnalysis {
 
   private:
     Graph *graph_;
-    std::unordered_map<BasicBlock *, LoopBounds> loop_bounds_;
+    BlockMap<LoopBounds> loop_bounds_;
 
     void AnalyzeLoop(Loop *loop);
 };
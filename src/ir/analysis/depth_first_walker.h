@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ir/analysis/side_table.h"
+#include "ir/basic_block.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Depth-first walk over the CFG driven by an explicit stack, so the depth of the
+// graph is bounded by heap rather than by the native stack of the compiler thread.
+// Successors are visited in order and callbacks fire exactly as a recursive walk would:
+//   on_enter(block, parent)        - block is discovered; parent is nullptr for the start block,
+//   on_edge(from, to, on_stack)    - edge to an already discovered block; on_stack marks back edges,
+//   on_exit(block)                 - all successors of block are done (postorder).
+// The walker keeps its scratch storage between walks.
+class DepthFirstWalker {
+  public:
+    template <typename OnEnter, typename OnEdge, typename OnExit>
+    void Walk(BasicBlock *start, size_t block_id_limit, OnEnter &&on_enter, OnEdge &&on_edge, OnExit &&on_exit) {
+        state_.Reset(block_id_limit, UNVISITED);
+        stack_.clear();
+
+        state_[start] = ON_STACK;
+        on_enter(start, static_cast<BasicBlock *>(nullptr));
+        stack_.emplace_back(start, 0);
+
+        while (!stack_.empty()) {
+            BasicBlock *block = stack_.back().first;
+            size_t &next_succ = stack_.back().second;
+            const auto &succs = block->GetSuccessors();
+            if (next_succ == succs.size()) {
+                state_[block] = DONE;
+                stack_.pop_back();
+                on_exit(block);
+                continue;
+            }
+
+            BasicBlock *succ = succs[next_succ++];
+            if (state_[succ] != UNVISITED) {
+                on_edge(block, succ, state_[succ] == ON_STACK);
+                continue;
+            }
+            state_[succ] = ON_STACK;
+            on_enter(succ, block);
+            stack_.emplace_back(succ, 0);
+        }
+    }
+
+  private:
+    static constexpr uint8_t UNVISITED = 0;
+    static constexpr uint8_t ON_STACK = 1;
+    static constexpr uint8_t DONE = 2;
+
+    BlockMap<uint8_t> state_;
+    std::vector<std::pair<BasicBlock *, size_t>> stack_;
+};
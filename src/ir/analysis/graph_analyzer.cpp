@@ -4,10 +4,11 @@
 #include <iostream>
 #include <queue>
 
+static constexpr uint32_t NO_NODE = UINT32_MAX;
+
 void GraphAnalyzer::ComputeRPO() {
-    std::unordered_set<BasicBlock *> visited;
     reverse_postorder_.clear();
-    rpo_numbers_.clear();
+    rpo_numbers_.Reset(graph_->GetBlockIdLimit(), INVALID_RPO_NUMBER);
 
     if (graph_->GetBlocks().empty()) {
         return;
@@ -16,7 +17,9 @@ void GraphAnalyzer::ComputeRPO() {
     const auto &blocks = graph_->GetBlocks();
     BasicBlock *start_block = const_cast<BasicBlock *>(&(*blocks.begin()));
 
-    DFS(start_block, visited);
+    walker_.Walk(
+        start_block, graph_->GetBlockIdLimit(), [](BasicBlock *, BasicBlock *) {},
+        [](BasicBlock *, BasicBlock *, bool) {}, [this](BasicBlock *block) { reverse_postorder_.push_back(block); });
 
     std::reverse(reverse_postorder_.begin(), reverse_postorder_.end());
 
@@ -27,35 +30,30 @@ void GraphAnalyzer::ComputeRPO() {
     start_block_ = reverse_postorder_.empty() ? nullptr : reverse_postorder_[0];
 }
 
-void GraphAnalyzer::DFS(BasicBlock *block, std::unordered_set<BasicBlock *> &visited) {
-    if (visited.count(block)) {
-        return;
-    }
-
-    visited.insert(block);
-
-    for (BasicBlock *succ : block->GetSuccessors()) {
-        DFS(succ, visited);
-    }
-
-    reverse_postorder_.push_back(block);
-}
-
 void GraphAnalyzer::BuildDominatorTree() {
     ComputeRPO();
 
+    dom_children_.Reset(graph_->GetBlockIdLimit());
+    dom_preorder_.clear();
+    dom_entry_.Reset(graph_->GetBlockIdLimit(), NO_NODE);
+    dom_exit_.Reset(graph_->GetBlockIdLimit(), NO_NODE);
+
     if (reverse_postorder_.empty()) {
         return;
     }
 
-    BasicBlock *start_block = reverse_postorder_[0];
-    immediate_dominators_.clear();
+    immediate_dominators_.Reset(graph_->GetBlockIdLimit(), nullptr);
+    immediate_dominators_[reverse_postorder_[0]] = reverse_postorder_[0];
 
-    for (BasicBlock *bb : reverse_postorder_) {
-        immediate_dominators_[bb] = nullptr;
+    if (algorithm_ == DominatorAlgorithm::SEMI_NCA) {
+        BuildDominatorTreeSemiNCA();
+    } else {
+        BuildDominatorTreeIterative();
     }
-    immediate_dominators_[start_block] = start_block;
+    NumberDominatorTree();
+}
 
+void GraphAnalyzer::BuildDominatorTreeIterative() {
     bool changed = true;
     while (changed) {
         changed = false;
@@ -100,13 +98,113 @@ void GraphAnalyzer::BuildDominatorTree() {
     }
 }
 
+void GraphAnalyzer::BuildDominatorTreeSemiNCA() {
+    uint32_t num_blocks = graph_->GetBlockIdLimit();
+    BlockMap<uint32_t> numbers(num_blocks, NO_NODE);
+    std::vector<BasicBlock *> preorder;
+    preorder.reserve(reverse_postorder_.size());
+    sn_parent_.clear();
+
+    // DFS preorder numbering and the spanning tree parents.
+    walker_.Walk(
+        reverse_postorder_[0], num_blocks,
+        [&](BasicBlock *block, BasicBlock *parent) {
+            numbers[block] = static_cast<uint32_t>(preorder.size());
+            sn_parent_.push_back(parent == nullptr ? NO_NODE : numbers[parent]);
+            preorder.push_back(block);
+        },
+        [](BasicBlock *, BasicBlock *, bool) {}, [](BasicBlock *) {});
+
+    size_t n = preorder.size();
+    sn_semi_.resize(n);
+    sn_label_.resize(n);
+    sn_ancestor_.assign(n, NO_NODE);
+    for (uint32_t i = 0; i < n; ++i) {
+        sn_semi_[i] = i;
+        sn_label_[i] = i;
+    }
+
+    for (uint32_t w = static_cast<uint32_t>(n) - 1; w > 0; --w) {
+        for (BasicBlock *pred : preorder[w]->GetPredecessors()) {
+            uint32_t v = numbers[pred];
+            if (v == NO_NODE) {
+                continue; // unreachable predecessor
+            }
+            uint32_t u = EvalSemiNCA(v);
+            sn_semi_[w] = std::min(sn_semi_[w], sn_semi_[u]);
+        }
+        sn_ancestor_[w] = sn_parent_[w];
+    }
+
+    // NCA pass: the idom is the nearest ancestor of the parent not deeper than semi.
+    std::vector<uint32_t> idom(n, 0);
+    for (uint32_t w = 1; w < n; ++w) {
+        uint32_t candidate = sn_parent_[w];
+        while (candidate > sn_semi_[w]) {
+            candidate = idom[candidate];
+        }
+        idom[w] = candidate;
+        immediate_dominators_[preorder[w]] = preorder[candidate];
+    }
+}
+
+uint32_t GraphAnalyzer::EvalSemiNCA(uint32_t v) {
+    if (sn_ancestor_[v] == NO_NODE) {
+        return v;
+    }
+
+    // Path compression without recursion: collect the path, then fold it top-down.
+    sn_compress_stack_.clear();
+    for (uint32_t x = v; sn_ancestor_[sn_ancestor_[x]] != NO_NODE; x = sn_ancestor_[x]) {
+        sn_compress_stack_.push_back(x);
+    }
+    while (!sn_compress_stack_.empty()) {
+        uint32_t x = sn_compress_stack_.back();
+        sn_compress_stack_.pop_back();
+        uint32_t a = sn_ancestor_[x];
+        if (sn_semi_[sn_label_[a]] < sn_semi_[sn_label_[x]]) {
+            sn_label_[x] = sn_label_[a];
+        }
+        sn_ancestor_[x] = sn_ancestor_[a];
+    }
+    return sn_label_[v];
+}
+
+void GraphAnalyzer::NumberDominatorTree() {
+    BasicBlock *start_block = reverse_postorder_[0];
+    for (size_t i = 1; i < reverse_postorder_.size(); ++i) {
+        BasicBlock *block = reverse_postorder_[i];
+        if (BasicBlock *idom = immediate_dominators_[block]) {
+            dom_children_[idom].push_back(block);
+        }
+    }
+
+    uint32_t counter = 0;
+    std::vector<std::pair<BasicBlock *, size_t>> stack;
+    dom_entry_[start_block] = counter++;
+    dom_preorder_.push_back(start_block);
+    stack.emplace_back(start_block, 0);
+    while (!stack.empty()) {
+        auto &[block, next_child] = stack.back();
+        const auto &children = dom_children_[block];
+        if (next_child == children.size()) {
+            dom_exit_[block] = counter++;
+            stack.pop_back();
+            continue;
+        }
+        BasicBlock *child = children[next_child++];
+        dom_entry_[child] = counter++;
+        dom_preorder_.push_back(child);
+        stack.emplace_back(child, 0);
+    }
+}
+
 BasicBlock *GraphAnalyzer::GetImmediateDominator(BasicBlock *block) const {
     if (block == start_block_) {
         return nullptr;
     }
 
-    auto it = immediate_dominators_.find(block);
-    return it != immediate_dominators_.end() ? it->second : nullptr;
+    return immediate_dominators_[block];
 }
 
 bool GraphAnalyzer::Dominates(BasicBlock *dominator, BasicBlock *dominated) const {
@@ -114,18 +212,11 @@ bool GraphAnalyzer::Dominates(BasicBlock *dominator, BasicBlock *dominated) cons
         return true;
     }
 
-    auto it = immediate_dominators_.find(dominated);
-    while (it != immediate_dominators_.end() && it->second != nullptr) {
-        if (it->second == dominator) {
-            return true;
-        }
-
-        if (it->second == it->first) {
-            break;
-        }
-
-        it = immediate_dominators_.find(it->second);
+    uint32_t dominator_entry = dom_entry_[dominator];
+    uint32_t dominated_entry = dom_entry_[dominated];
+    if (dominator_entry == NO_NODE || dominated_entry == NO_NODE) {
+        return false;
     }
 
-    return false;
+    return dominator_entry <= dominated_entry && dom_exit_[dominated] <= dom_exit_[dominator];
 }
\ No newline at end of file
@@ -1,14 +1,28 @@
 #pragma once
 
+#include "ir/analysis/depth_first_walker.h"
+#include "ir/analysis/side_table.h"
+#include "ir/basic_block.h"
 #include "ir/graph.h"
-#include <stack>
-#include <unordered_map>
-#include <unordered_set>
+#include <cstdint>
 #include <vector>
 
+enum class DominatorAlgorithm {
+    // Cooper-Harvey-Kennedy fixpoint over RPO; simple, but may need several sweeps.
+    ITERATIVE,
+    // Semi-dominators via path compression followed by the NCA pass; near-linear.
+    SEMI_NCA,
+};
+
 class GraphAnalyzer {
   public:
-    explicit GraphAnalyzer(Graph *graph) : graph_(graph) {}
+    static constexpr size_t INVALID_RPO_NUMBER = SIZE_MAX;
+
+    explicit GraphAnalyzer(Graph *graph, DominatorAlgorithm algorithm = DominatorAlgorithm::SEMI_NCA)
+        : graph_(graph), algorithm_(algorithm) {}
+
+    void SetDominatorAlgorithm(DominatorAlgorithm algorithm) { algorithm_ = algorithm; }
+    DominatorAlgorithm GetDominatorAlgorithm() const { return algorithm_; }
 
     void ComputeRPO();
     void BuildDominatorTree();
@@ -16,18 +30,38 @@ class GraphAnalyzer {
 
     const std::vector<BasicBlock *> &GetReversePostOrder() const { return reverse_postorder_; }
     BasicBlock *GetImmediateDominator(BasicBlock *block) const;
-    const std::unordered_map<BasicBlock *, size_t> &GetRPONumbers() const { return rpo_numbers_; }
+    const BlockMap<size_t> &GetRPONumbers() const { return rpo_numbers_; }
 
-    const std::unordered_map<BasicBlock *, BasicBlock *> &GetImmediateDominators() const {
-        return immediate_dominators_;
-    }
+    const BlockMap<BasicBlock *> &GetImmediateDominators() const { return immediate_dominators_; }
+
+    // Dominator tree in explicit form: children lists and a preorder walk from the start block.
+    const std::vector<BasicBlock *> &GetDominatedChildren(BasicBlock *block) const { return dom_children_[block]; }
+    const std::vector<BasicBlock *> &GetDominatorTreePreorder() const { return dom_preorder_; }
 
   private:
-    void DFS(BasicBlock *block, std::unordered_set<BasicBlock *> &visited);
+    void BuildDominatorTreeIterative();
+    void BuildDominatorTreeSemiNCA();
+    uint32_t EvalSemiNCA(uint32_t v);
+    void NumberDominatorTree();
 
     Graph *graph_;
+    DominatorAlgorithm algorithm_;
     BasicBlock *start_block_ = nullptr;
     std::vector<BasicBlock *> reverse_postorder_;
-    std::unordered_map<BasicBlock *, BasicBlock *> immediate_dominators_;
-    std::unordered_map<BasicBlock *, size_t> rpo_numbers_;
+    BlockMap<BasicBlock *> immediate_dominators_;
+    BlockMap<size_t> rpo_numbers_;
+    DepthFirstWalker walker_;
+
+    // Entry/exit numbers of the dominator tree walk: a dominates b iff a's interval encloses b's.
+    BlockMap<std::vector<BasicBlock *>> dom_children_;
+    std::vector<BasicBlock *> dom_preorder_;
+    BlockMap<uint32_t> dom_entry_;
+    BlockMap<uint32_t> dom_exit_;
+
+    // Semi-NCA scratch state, indexed by DFS preorder number.
+    std::vector<uint32_t> sn_parent_;
+    std::vector<uint32_t> sn_semi_;
+    std::vector<uint32_t> sn_label_;
+    std::vector<uint32_t> sn_ancestor_;
+    std::vector<uint32_t> sn_compress_stack_;
 };
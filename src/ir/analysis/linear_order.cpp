@@ -1,14 +1,74 @@
 #include "ir/analysis/linear_order.h"
 #include "ir/analysis/graph_analyzer.h"
+#include "ir/analysis/loop_analyzer.h"
+#include "ir/analysis/side_table.h"
 #include "ir/graph.h"
 
 namespace analysis {
 
-LinearOrder::LinearOrder(Graph *graph) : graph_(graph), graph_analyzer_(graph) { Build(); }
+LinearOrder::LinearOrder(Graph *graph, LinearOrderMode mode) : graph_(graph) {
+    if (mode == LinearOrderMode::RPO) {
+        GraphAnalyzer analyzer(graph);
+        analyzer.ComputeRPO();
+        Build(analyzer);
+        return;
+    }
 
-void LinearOrder::Build() {
-    graph_analyzer_.ComputeRPO();
-    linear_order_ = graph_analyzer_.GetReversePostOrder();
+    GraphAnalyzer analyzer(graph);
+    analyzer.BuildDominatorTree();
+    LoopAnalyzer loops(graph, &analyzer);
+    loops.Analyze();
+    Build(analyzer, loops);
+}
+
+LinearOrder::LinearOrder(Graph *graph, const GraphAnalyzer &analyzer) : graph_(graph) { Build(analyzer); }
+
+LinearOrder::LinearOrder(Graph *graph, const GraphAnalyzer &analyzer, const LoopAnalyzer &loops) : graph_(graph) {
+    Build(analyzer, loops);
+}
+
+void LinearOrder::Build(const GraphAnalyzer &analyzer) { linear_order_ = analyzer.GetReversePostOrder(); }
+
+// Every loop gets the list of its items in RPO: the blocks whose innermost loop it is, plus one
+// entry per directly nested loop at the position of that loop's header. Expanding the items of
+// the root recursively emits each loop as one contiguous run, and since blocks stay in RPO within
+// their loop, forward edges of reducible loops still point forward.
+void LinearOrder::Build(const GraphAnalyzer &analyzer, const LoopAnalyzer &loops) {
+    struct Item {
+        BasicBlock *block;
+        Loop *loop;
+    };
+    const auto &rpo = analyzer.GetReversePostOrder();
+    std::vector<Item> root_items;
+    BlockMap<std::vector<Item>> loop_items(graph_->GetBlockIdLimit());
+    auto items_of = [&](Loop *loop) -> std::vector<Item> & {
+        return loop == nullptr ? root_items : loop_items[loop->GetHeader()];
+    };
+
+    for (BasicBlock *block : rpo) {
+        if (Loop *loop = loops.GetLoopWithHeader(block)) {
+            items_of(loop->GetOuterLoop()).push_back({nullptr, loop});
+        }
+        items_of(loops.GetLoopForBlock(block)).push_back({block, nullptr});
+    }
+
+    linear_order_.clear();
+    linear_order_.reserve(rpo.size());
+    std::vector<std::pair<const std::vector<Item> *, size_t>> stack;
+    stack.emplace_back(&root_items, 0);
+    while (!stack.empty()) {
+        auto &[items, next] = stack.back();
+        if (next == items->size()) {
+            stack.pop_back();
+            continue;
+        }
+        const Item &item = (*items)[next++];
+        if (item.block != nullptr) {
+            linear_order_.push_back(item.block);
+        } else {
+            stack.emplace_back(&items_of(item.loop), 0);
+        }
+    }
 }
 
 } // namespace analysis
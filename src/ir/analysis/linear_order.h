@@ -5,20 +5,33 @@
 
 class Graph;
 class BasicBlock;
+class LoopAnalyzer;
 
 namespace analysis {
 
+enum class LinearOrderMode {
+    // Reverse postorder with every loop laid out contiguously: inner loops nested in their outer
+    // loop, loop exits after the body. Keeps live intervals of loop code short.
+    LOOP_CONTIGUOUS,
+    // Plain reverse postorder.
+    RPO,
+};
+
 class LinearOrder {
   public:
-    explicit LinearOrder(Graph *graph);
+    explicit LinearOrder(Graph *graph, LinearOrderMode mode = LinearOrderMode::LOOP_CONTIGUOUS);
+    // Plain RPO taken from an analyzer whose RPO is already computed.
+    LinearOrder(Graph *graph, const GraphAnalyzer &analyzer);
+    // Loop-contiguous order on top of analyses that are already up to date.
+    LinearOrder(Graph *graph, const GraphAnalyzer &analyzer, const LoopAnalyzer &loops);
 
     const std::vector<BasicBlock *> &GetBlocks() const { return linear_order_; }
 
   private:
-    void Build();
+    void Build(const GraphAnalyzer &analyzer);
+    void Build(const GraphAnalyzer &analyzer, const LoopAnalyzer &loops);
 
     Graph *graph_;
-    GraphAnalyzer graph_analyzer_;
     std::vector<BasicBlock *> linear_order_;
 };
 
@@ -52,6 +52,73 @@ bool LiveInterval::IsLiveAt(uint32_t point) const {
     return false;
 }
 
+void LiveInterval::AddUsePosition(uint32_t pos) {
+    auto it = std::lower_bound(use_positions_.begin(), use_positions_.end(), pos);
+    if (it == use_positions_.end() || *it != pos) {
+        use_positions_.insert(it, pos);
+    }
+}
+
+uint32_t LiveInterval::GetNextUse(uint32_t pos) const {
+    auto it = std::lower_bound(use_positions_.begin(), use_positions_.end(), pos);
+    return it == use_positions_.end() ? INVALID_POSITION : *it;
+}
+
+uint32_t LiveInterval::FirstIntersection(const LiveInterval &other) const {
+    // Both range lists are sorted and disjoint, so one merge-like pass finds the earliest overlap.
+    auto it = ranges_.begin();
+    auto other_it = other.ranges_.begin();
+    while (it != ranges_.end() && other_it != other.ranges_.end()) {
+        if (it->Intersects(*other_it)) {
+            return std::max(it->start, other_it->start);
+        }
+        if (it->end <= other_it->start) {
+            ++it;
+        } else {
+            ++other_it;
+        }
+    }
+    return INVALID_POSITION;
+}
+
+LiveInterval *LiveInterval::SplitAt(uint32_t pos) {
+    auto child = std::make_unique<LiveInterval>(inst_);
+    child->split_parent_ = split_parent_;
+
+    auto it = std::find_if(ranges_.begin(), ranges_.end(), [pos](const LiveRange &range) { return range.end > pos; });
+    if (it != ranges_.end() && it->start < pos) {
+        child->ranges_.push_back({pos, it->end});
+        it->end = pos;
+        ++it;
+    }
+    child->ranges_.insert(child->ranges_.end(), it, ranges_.end());
+    ranges_.erase(it, ranges_.end());
+
+    auto use = std::lower_bound(use_positions_.begin(), use_positions_.end(), pos);
+    child->use_positions_.assign(use, use_positions_.end());
+    use_positions_.erase(use, use_positions_.end());
+
+    LiveInterval *result = child.get();
+    auto &siblings = split_parent_->split_children_;
+    auto insert_at = std::upper_bound(siblings.begin(), siblings.end(), result->GetStart(),
+                                      [](uint32_t start, const auto &sibling) { return start < sibling->GetStart(); });
+    siblings.insert(insert_at, std::move(child));
+    return result;
+}
+
+LiveInterval *LiveInterval::GetSplitChildAt(uint32_t pos) {
+    LiveInterval *parent = split_parent_;
+    if (parent->IsLiveAt(pos)) {
+        return parent;
+    }
+    for (const auto &child : parent->split_children_) {
+        if (child->IsLiveAt(pos)) {
+            return child.get();
+        }
+    }
+    return nullptr;
+}
+
 void LiveInterval::Dump(std::ostream &os) const {
     os << "i" << inst_->GetId() << ": ";
     for (const auto &range : ranges_) {
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <iosfwd>
+#include <memory>
 #include <vector>
 
 #include "ir/instruction.h"
@@ -23,21 +24,56 @@ struct LiveRange {
 
 class LiveInterval {
   public:
-    explicit LiveInterval(Instruction *inst) : inst_(inst) {}
+    static constexpr uint32_t INVALID_POSITION = UINT32_MAX;
+
+    explicit LiveInterval(Instruction *inst) : inst_(inst), split_parent_(this) {}
 
     void AddRange(uint32_t start, uint32_t end);
     void SetStart(uint32_t pos);
 
+    // Positions where an operand must be in its location: the gap just before the using
+    // instruction. Phi inputs are not recorded, they are read by moves on the incoming edges.
+    void AddUsePosition(uint32_t pos);
+    const std::vector<uint32_t> &GetUsePositions() const { return use_positions_; }
+    // First use at or after `pos`, or INVALID_POSITION.
+    uint32_t GetNextUse(uint32_t pos) const;
+
     bool IsLiveAt(uint32_t point) const;
 
+    // Bounds of the whole lifetime; the interval must not be empty.
+    uint32_t GetStart() const { return ranges_.front().start; }
+    uint32_t GetEnd() const { return ranges_.back().end; }
+
+    // First position where both intervals are live, or INVALID_POSITION. Lifetime holes are
+    // respected, so an interval that fits into a hole of the other does not intersect it.
+    uint32_t FirstIntersection(const LiveInterval &other) const;
+    bool Intersects(const LiveInterval &other) const { return FirstIntersection(other) != INVALID_POSITION; }
+
     Instruction *GetInstruction() const { return inst_; }
     const std::vector<LiveRange> &GetRanges() const { return ranges_; }
 
+    // Where the register allocator keeps the value during this interval.
+    Location GetLocation() const { return location_; }
+    void SetLocation(Location location) { location_ = location; }
+
+    // Moves the part of the lifetime from `pos` on into a new child interval, which can then get
+    // a location of its own; `pos` must lie strictly inside the interval. Children are owned by
+    // the interval that was split first (the split parent) and kept sorted by start.
+    LiveInterval *SplitAt(uint32_t pos);
+    LiveInterval *GetSplitParent() const { return split_parent_; }
+    const std::vector<std::unique_ptr<LiveInterval>> &GetSplitChildren() const { return split_children_; }
+    // The part of the value (the split parent or one of its children) that is live at `pos`.
+    LiveInterval *GetSplitChildAt(uint32_t pos);
+
     void Dump(std::ostream &os) const;
 
   private:
     Instruction *inst_;
     std::vector<LiveRange> ranges_;
+    std::vector<uint32_t> use_positions_;
+    Location location_;
+    LiveInterval *split_parent_;
+    std::vector<std::unique_ptr<LiveInterval>> split_children_;
 };
 
 } // namespace analysis
@@ -8,17 +8,29 @@
 
 namespace analysis {
 
-LivenessAnalyzer::LivenessAnalyzer(Graph *graph) : graph_(graph), linear_order_(graph), loop_analyzer_(graph) {}
+LivenessAnalyzer::LivenessAnalyzer(Graph *graph)
+    : graph_(graph), own_linear_order_(std::make_unique<LinearOrder>(graph)),
+      own_loop_analyzer_(std::make_unique<LoopAnalyzer>(graph)), linear_order_(own_linear_order_.get()),
+      loop_analyzer_(own_loop_analyzer_.get()) {}
+
+LivenessAnalyzer::LivenessAnalyzer(Graph *graph, const LinearOrder *linear_order, const LoopAnalyzer *loop_analyzer)
+    : graph_(graph), linear_order_(linear_order), loop_analyzer_(loop_analyzer) {}
 
 LivenessAnalyzer::~LivenessAnalyzer() {
-    for (auto const &[inst, interval] : intervals_) {
+    for (auto *interval : intervals_) {
         delete interval;
     }
 }
 
 void LivenessAnalyzer::NumberInstructions() {
+    inst_positions_.Reset(graph_->GetInstIdLimit(), 0);
+    block_positions_.Reset(graph_->GetBlockIdLimit(), LiveRange{0, 0});
+    intervals_.Reset(graph_->GetInstIdLimit(), nullptr);
+    value_numbers_.Reset(graph_->GetInstIdLimit(), INVALID_VALUE_NUMBER);
+    values_.clear();
+
     uint32_t current_pos = 0;
-    const auto &blocks = linear_order_.GetBlocks();
+    const auto &blocks = linear_order_->GetBlocks();
     for (BasicBlock *bb : blocks) {
         if (current_pos % 2 != 0)
             current_pos++;
@@ -27,130 +39,172 @@ void LivenessAnalyzer::NumberInstructions() {
         for (Instruction *inst = bb->GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
             inst_positions_[inst] = current_pos;
             current_pos += 2;
+            GetOrCreateValueNumber(inst);
         }
         uint32_t to = current_pos;
         block_positions_[bb] = {from, to};
     }
+
+    // Operands defined outside the linear order (arguments, unreachable blocks) are numbered after it.
+    for (BasicBlock *bb : blocks) {
+        for (Instruction *inst = bb->GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
+            for (Instruction *input : inst->GetInputs()) {
+                if (input != nullptr) {
+                    GetOrCreateValueNumber(input);
+                }
+            }
+        }
+    }
+}
+
+uint32_t LivenessAnalyzer::GetOrCreateValueNumber(Instruction *inst) {
+    uint32_t &number = value_numbers_[inst];
+    if (number == INVALID_VALUE_NUMBER) {
+        number = static_cast<uint32_t>(values_.size());
+        values_.push_back(inst);
+    }
+    return number;
 }
 
 LiveInterval *LivenessAnalyzer::GetOrCreateInterval(Instruction *inst) {
-    auto it = intervals_.find(inst);
-    if (it != intervals_.end()) {
-        return it->second;
+    auto *&interval = intervals_[inst];
+    if (interval == nullptr) {
+        interval = new LiveInterval(inst);
     }
-    auto *new_interval = new LiveInterval(inst);
-    intervals_[inst] = new_interval;
-    return new_interval;
+    return interval;
 }
 
 void LivenessAnalyzer::Analyze() {
-    loop_analyzer_.Analyze();
+    if (own_loop_analyzer_ != nullptr) {
+        own_loop_analyzer_->Analyze();
+    }
     NumberInstructions();
 
-    std::unordered_map<BasicBlock *, std::unordered_set<Instruction *>> live_in_sets;
-    const auto &blocks = linear_order_.GetBlocks();
+    live_in_.Reset(graph_->GetBlockIdLimit());
+    const auto &blocks = linear_order_->GetBlocks();
 
     for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
-        ProcessBlock(*it, live_in_sets);
+        ProcessBlock(*it);
     }
+    PropagateLoopLiveness();
 }
 
-void LivenessAnalyzer::ProcessBlock(BasicBlock *block,
-                                    std::unordered_map<BasicBlock *, std::unordered_set<Instruction *>> &live_in_sets) {
-    std::unordered_set<Instruction *> live;
-
-    for (auto *succ : block->GetSuccessors()) {
-        if (live_in_sets.count(succ)) {
-            live.insert(live_in_sets.at(succ).begin(), live_in_sets.at(succ).end());
-        }
-    }
-
-    uint32_t block_from = block_positions_.at(block).start;
-    uint32_t block_to = block_positions_.at(block).end;
+void LivenessAnalyzer::ProcessBlock(BasicBlock *block) {
+    BitVector live(values_.size());
+    CollectLiveOut(block, live);
 
-    for (auto *succ : block->GetSuccessors()) {
-        for (auto *inst = succ->GetFirstInstruction(); inst && inst->GetOpcode() == Opcode::PHI;
-             inst = inst->GetNext()) {
-            auto *phi = static_cast<PhiInst *>(inst);
-            auto &preds = succ->GetPredecessors();
-            for (size_t i = 0; i < preds.size(); ++i) {
-                if (preds[i] == block) {
-                    if (i < phi->GetInputs().size() && phi->GetInputs()[i] != nullptr) {
-                        live.insert(phi->GetInputs()[i]);
-                    }
-                }
-            }
-        }
-    }
+    uint32_t block_from = block_positions_[block].start;
+    uint32_t block_to = block_positions_[block].end;
 
-    for (auto *inst : live) {
-        GetOrCreateInterval(inst)->AddRange(block_from, block_to);
-    }
+    live.ForEachSetBit([&](size_t value) { GetOrCreateInterval(values_[value])->AddRange(block_from, block_to); });
 
     for (auto *inst = block->GetLastInstruction(); inst != nullptr; inst = inst->GetPrev()) {
-        uint32_t inst_pos = inst_positions_.at(inst);
+        uint32_t inst_pos = inst_positions_[inst];
 
         if (inst->GetOpcode() != Opcode::PHI && inst->GetType() != Type::VOID &&
             !dynamic_cast<TerminatorInst *>(inst)) {
             GetOrCreateInterval(inst)->SetStart(inst_pos);
-            live.erase(inst);
+            live.Clear(value_numbers_[inst]);
         }
 
         if (inst->GetOpcode() != Opcode::PHI) {
+            // Operands are needed in the gap before the instruction. The first instruction of a block
+            // has no gap of its own, so its operands are kept live at the instruction itself.
+            uint32_t use_pos = inst_pos > block_from ? inst_pos - 1 : inst_pos;
             for (auto *input : inst->GetInputs()) {
                 if (input == nullptr)
                     continue;
-                GetOrCreateInterval(input)->AddRange(block_from, inst_pos);
-                live.insert(input);
+                auto *interval = GetOrCreateInterval(input);
+                interval->AddRange(block_from, use_pos + 1);
+                interval->AddUsePosition(use_pos);
+                live.Set(value_numbers_[input]);
             }
         }
     }
 
     for (auto *inst = block->GetFirstInstruction(); inst && inst->GetOpcode() == Opcode::PHI; inst = inst->GetNext()) {
         GetOrCreateInterval(inst)->SetStart(block_from);
-        live.erase(inst);
+        live.Clear(value_numbers_[inst]);
     }
 
-    if (loop_analyzer_.IsLoopHeader(block)) {
-        Loop *loop = loop_analyzer_.GetLoopForBlock(block);
+    if (loop_analyzer_->IsLoopHeader(block)) {
+        Loop *loop = loop_analyzer_->GetLoopForBlock(block);
         if (loop) {
-            uint32_t loop_end = block_positions_.at(block).end;
+            uint32_t loop_end = block_positions_[block].end;
             for (auto *loop_block : loop->GetBlocks()) {
-                if (block_positions_.count(loop_block)) {
-                    loop_end = std::max(loop_end, block_positions_.at(loop_block).end);
-                }
+                loop_end = std::max(loop_end, block_positions_[loop_block].end);
             }
 
-            for (auto *inst : live) {
-                GetOrCreateInterval(inst)->AddRange(block_from, loop_end);
-            }
-            for (auto *inst = block->GetFirstInstruction(); inst && inst->GetOpcode() == Opcode::PHI;
-                 inst = inst->GetNext()) {
-                GetOrCreateInterval(inst)->AddRange(block_from, loop_end);
+            live.ForEachSetBit(
+                [&](size_t value) { GetOrCreateInterval(values_[value])->AddRange(block_from, loop_end); });
+        }
+    }
+
+    // Live-in values are defined before the block in linear order, so the high words are mostly empty.
+    live.ShrinkToFit();
+    live_in_[block] = std::move(live);
+}
+
+void LivenessAnalyzer::CollectLiveOut(BasicBlock *block, BitVector &live) const {
+    for (auto *succ : block->GetSuccessors()) {
+        live.Union(live_in_[succ]);
+    }
+
+    for (auto *succ : block->GetSuccessors()) {
+        for (auto *inst = succ->GetFirstInstruction(); inst && inst->GetOpcode() == Opcode::PHI;
+             inst = inst->GetNext()) {
+            auto *phi = static_cast<PhiInst *>(inst);
+            auto &preds = succ->GetPredecessors();
+            for (size_t i = 0; i < preds.size(); ++i) {
+                if (preds[i] == block) {
+                    if (i < phi->GetInputs().size() && phi->GetInputs()[i] != nullptr) {
+                        live.Set(value_numbers_[phi->GetInputs()[i]]);
+                    }
+                }
             }
         }
     }
+}
 
-    live_in_sets[block] = std::move(live);
+BitVector LivenessAnalyzer::GetLiveOut(BasicBlock *block) const {
+    BitVector live(values_.size());
+    CollectLiveOut(block, live);
+    return live;
 }
 
-uint32_t LivenessAnalyzer::GetInstructionPosition(Instruction *inst) const {
-    auto it = inst_positions_.find(inst);
-    if (it != inst_positions_.end()) {
-        return it->second;
+// The reverse sweep sees no live-in for loop headers when it reaches their latches. A value live
+// into a header is live throughout the loop, so header live-ins are pushed down the loop tree and
+// then into the blocks of each innermost loop, which makes the sets exact with one union per block.
+// Live-out sets follow, as they are derived from the live-ins of the successors.
+void LivenessAnalyzer::PropagateLoopLiveness() {
+    std::vector<Loop *> worklist(loop_analyzer_->GetRootLoop()->GetInnerLoops().begin(),
+                                 loop_analyzer_->GetRootLoop()->GetInnerLoops().end());
+    while (!worklist.empty()) {
+        Loop *loop = worklist.back();
+        worklist.pop_back();
+        for (Loop *inner : loop->GetInnerLoops()) {
+            live_in_[inner->GetHeader()].Union(live_in_[loop->GetHeader()]);
+            worklist.push_back(inner);
+        }
+    }
+
+    for (BasicBlock *block : linear_order_->GetBlocks()) {
+        Loop *loop = loop_analyzer_->GetLoopForBlock(block);
+        if (loop != nullptr && block != loop->GetHeader()) {
+            live_in_[block].Union(live_in_[loop->GetHeader()]);
+        }
     }
-    return 0;
+}
+
+uint32_t LivenessAnalyzer::GetInstructionPosition(Instruction *inst) const {
+    return inst_positions_[inst];
 }
 
 LiveInterval *LivenessAnalyzer::GetLiveInterval(Instruction *inst) const {
-    auto it = intervals_.find(inst);
-    if (it != intervals_.end()) {
-        return it->second;
-    }
-    return nullptr;
+    return intervals_[inst];
 }
 
-const std::vector<BasicBlock *> &LivenessAnalyzer::GetLinearOrder() const { return linear_order_.GetBlocks(); }
+const std::vector<BasicBlock *> &LivenessAnalyzer::GetLinearOrder() const { return linear_order_->GetBlocks(); }
 
 void LivenessAnalyzer::Dump(std::ostream &os) const {
     os << "Liveness Analysis Results:\n";
@@ -162,16 +216,15 @@ void LivenessAnalyzer::Dump(std::ostream &os) const {
     os << "\n\n";
 
     os << "Instruction Positions:\n";
+    // Blocks are numbered along the linear order, so this walk is already sorted by position.
     std::vector<const Instruction *> ordered_insts;
-    ordered_insts.reserve(inst_positions_.size());
-    for (auto const &[inst, pos] : inst_positions_) {
-        ordered_insts.push_back(inst);
+    for (const auto *bb : GetLinearOrder()) {
+        for (const auto *inst = bb->GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
+            ordered_insts.push_back(inst);
+        }
     }
-    std::sort(ordered_insts.begin(), ordered_insts.end(), [this](const Instruction *a, const Instruction *b) {
-        return inst_positions_.at(const_cast<Instruction *>(a)) < inst_positions_.at(const_cast<Instruction *>(b));
-    });
     for (const auto *inst : ordered_insts) {
-        os << "  " << inst_positions_.at(const_cast<Instruction *>(inst)) << ": i" << inst->GetId() << "  (";
+        os << "  " << inst_positions_[inst] << ": i" << inst->GetId() << "  (";
         inst->Print(os);
         os << ")\n";
     }
@@ -179,9 +232,8 @@ void LivenessAnalyzer::Dump(std::ostream &os) const {
 
     os << "Live Intervals:\n";
     for (const auto *inst : ordered_insts) {
-        auto it = intervals_.find(const_cast<Instruction *>(inst));
-        if (it != intervals_.end()) {
-            it->second->Dump(os);
+        if (auto *interval = intervals_[inst]) {
+            interval->Dump(os);
             os << "\n";
         }
     }
@@ -3,8 +3,10 @@
 #include "ir/analysis/linear_order.h"
 #include "ir/analysis/live_interval.h"
 #include "ir/analysis/loop_analyzer.h"
-#include <unordered_map>
-#include <unordered_set>
+#include "ir/analysis/side_table.h"
+#include "ir/bit_vector.h"
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 class Graph;
@@ -15,7 +17,11 @@ namespace analysis {
 
 class LivenessAnalyzer {
   public:
+    static constexpr uint32_t INVALID_VALUE_NUMBER = UINT32_MAX;
+
     explicit LivenessAnalyzer(Graph *graph);
+    // Runs on top of analyses owned elsewhere (the AnalysisManager); both must be up to date.
+    LivenessAnalyzer(Graph *graph, const LinearOrder *linear_order, const LoopAnalyzer *loop_analyzer);
     ~LivenessAnalyzer();
 
     void Analyze();
@@ -23,22 +29,40 @@ class LivenessAnalyzer {
     LiveInterval *GetLiveInterval(Instruction *inst) const;
     const std::vector<BasicBlock *> &GetLinearOrder() const;
     uint32_t GetInstructionPosition(Instruction *inst) const;
+    // Positions [start, end) of the block's instructions; instructions sit at even positions.
+    LiveRange GetBlockRange(BasicBlock *block) const { return block_positions_[block]; }
+
+    // Live sets are bit vectors over a dense numbering of the values (instructions in linear order).
+    // Only live-in sets are stored; live-out is derived from the successors when asked for.
+    const BitVector &GetLiveIn(BasicBlock *block) const { return live_in_[block]; }
+    BitVector GetLiveOut(BasicBlock *block) const;
+    uint32_t GetValueNumber(Instruction *inst) const { return value_numbers_[inst]; }
+    Instruction *GetValue(uint32_t value_number) const { return values_[value_number]; }
+    size_t GetValueCount() const { return values_.size(); }
 
     void Dump(std::ostream &os) const;
 
   private:
     void NumberInstructions();
     LiveInterval *GetOrCreateInterval(Instruction *inst);
-    void ProcessBlock(BasicBlock *block,
-                      std::unordered_map<BasicBlock *, std::unordered_set<Instruction *>> &live_in_sets);
+    uint32_t GetOrCreateValueNumber(Instruction *inst);
+    void ProcessBlock(BasicBlock *block);
+    void CollectLiveOut(BasicBlock *block, BitVector &live) const;
+    void PropagateLoopLiveness();
 
     Graph *graph_;
-    LinearOrder linear_order_;
-    LoopAnalyzer loop_analyzer_;
+    std::unique_ptr<LinearOrder> own_linear_order_;
+    std::unique_ptr<LoopAnalyzer> own_loop_analyzer_;
+    const LinearOrder *linear_order_;
+    const LoopAnalyzer *loop_analyzer_;
+
+    InstMap<LiveInterval *> intervals_;
+    BlockMap<LiveRange> block_positions_;
+    InstMap<uint32_t> inst_positions_;
 
-    std::unordered_map<Instruction *, LiveInterval *> intervals_;
-    std::unordered_map<BasicBlock *, LiveRange> block_positions_;
-    std::unordered_map<Instruction *, uint32_t> inst_positions_;
+    InstMap<uint32_t> value_numbers_;
+    std::vector<Instruction *> values_;
+    BlockMap<BitVector> live_in_;
 };
 
 } // namespace analysis
@@ -2,10 +2,16 @@
 #include <algorithm>
 #include <iostream>
 
-Loop::Loop(BasicBlock *header) : header_(header) { blocks_.push_back(header); }
+Loop::Loop(BasicBlock *header) : header_(header) {
+    blocks_.push_back(header);
+    if (header != nullptr) {
+        block_set_.Set(header->GetId());
+    }
+}
 
 void Loop::AddBlock(BasicBlock *block) {
-    if (std::find(blocks_.begin(), blocks_.end(), block) == blocks_.end()) {
+    if (!ContainsBlock(block)) {
+        block_set_.Set(block->GetId());
         blocks_.push_back(block);
     }
 }
@@ -27,9 +33,7 @@ void Loop::AddBackEdge(BasicBlock *latch) {
     }
 }
 
-bool Loop::ContainsBlock(BasicBlock *block) const {
-    return std::find(blocks_.begin(), blocks_.end(), block) != blocks_.end();
-}
+bool Loop::ContainsBlock(BasicBlock *block) const { return block_set_.Test(block->GetId()); }
 
 bool Loop::ContainsLoop(Loop *loop) const {
     if (std::find(inner_loops_.begin(), inner_loops_.end(), loop) != inner_loops_.end()) {
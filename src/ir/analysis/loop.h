@@ -1,8 +1,8 @@
 #pragma once
 
 #include "ir/basic_block.h"
+#include "ir/bit_vector.h"
 #include <iosfwd>
-#include <unordered_set>
 #include <vector>
 
 class Loop {
@@ -32,6 +32,8 @@ class Loop {
   private:
     BasicBlock *header_;
     std::vector<BasicBlock *> blocks_;
+    // Membership of blocks_ by block id, so ContainsBlock does not scan the body.
+    BitVector block_set_;
     std::vector<BasicBlock *> latches_;
     std::vector<Loop *> inner_loops_;
     Loop *outer_loop_ = nullptr;
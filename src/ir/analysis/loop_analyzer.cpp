@@ -3,9 +3,12 @@
 #include "ir/graph.h"
 #include <algorithm>
 #include <iostream>
-#include <stack>
 
-LoopAnalyzer::LoopAnalyzer(Graph *graph) : graph_(graph), graph_analyzer_(graph) {}
+LoopAnalyzer::LoopAnalyzer(Graph *graph)
+    : graph_(graph), own_graph_analyzer_(graph), graph_analyzer_(&own_graph_analyzer_) {}
+
+LoopAnalyzer::LoopAnalyzer(Graph *graph, const GraphAnalyzer *dominators)
+    : graph_(graph), own_graph_analyzer_(graph), graph_analyzer_(dominators) {}
 
 LoopAnalyzer::~LoopAnalyzer() {
     for (Loop *loop : loops_) {
@@ -15,7 +18,9 @@ LoopAnalyzer::~LoopAnalyzer() {
 }
 
 void LoopAnalyzer::Analyze() {
-    graph_analyzer_.BuildDominatorTree();
+    if (graph_analyzer_ == &own_graph_analyzer_) {
+        own_graph_analyzer_.BuildDominatorTree();
+    }
     CollectBackEdges();
     PopulateLoops();
     BuildLoopTree();
@@ -23,100 +28,101 @@ void LoopAnalyzer::Analyze() {
 }
 
 void LoopAnalyzer::CollectBackEdges() {
-    dfs_numbers_.clear();
-    dfs_exit_numbers_.clear();
-    in_stack_.clear();
+    uint32_t num_blocks = graph_->GetBlockIdLimit();
+    dfs_numbers_.Reset(num_blocks, -1);
+    dfs_exit_numbers_.Reset(num_blocks, -1);
     back_edges_.clear();
     dfs_counter_ = 0;
 
-    std::unordered_set<BasicBlock *> visited;
-    if (!graph_analyzer_.GetReversePostOrder().empty()) {
-        MarkDFS(graph_analyzer_.GetReversePostOrder()[0], visited, in_stack_);
+    if (graph_analyzer_->GetReversePostOrder().empty()) {
+        return;
     }
-}
 
-void LoopAnalyzer::MarkDFS(BasicBlock *block, std::unordered_set<BasicBlock *> &visited,
-                           std::unordered_set<BasicBlock *> &in_stack) {
-    visited.insert(block);
-    in_stack.insert(block);
-    dfs_numbers_[block] = dfs_counter_++;
-
-    for (BasicBlock *succ : block->GetSuccessors()) {
-        if (in_stack.count(succ)) {
-            if (dfs_numbers_[block] >= dfs_numbers_[succ]) {
-                back_edges_.emplace_back(block, succ);
+    // An edge into a block that is still on the DFS stack closes a cycle.
+    walker_.Walk(
+        graph_analyzer_->GetReversePostOrder()[0], num_blocks,
+        [this](BasicBlock *block, BasicBlock *) { dfs_numbers_[block] = dfs_counter_++; },
+        [this](BasicBlock *from, BasicBlock *to, bool on_stack) {
+            if (on_stack) {
+                back_edges_.emplace_back(from, to);
             }
-        } else if (!visited.count(succ)) {
-            MarkDFS(succ, visited, in_stack);
-        }
-    }
-
-    in_stack.erase(block);
-    dfs_exit_numbers_[block] = dfs_counter_++;
+        },
+        [this](BasicBlock *block) { dfs_exit_numbers_[block] = dfs_counter_++; });
 }
 
 bool LoopAnalyzer::IsDescendant(BasicBlock *parent, BasicBlock *child) const {
     if (parent == child)
         return true;
-    auto p_entry = dfs_numbers_.find(parent);
-    auto p_exit = dfs_exit_numbers_.find(parent);
-    auto c_entry = dfs_numbers_.find(child);
-    auto c_exit = dfs_exit_numbers_.find(child);
+    int p_entry = dfs_numbers_[parent];
+    int c_entry = dfs_numbers_[child];
 
-    if (p_entry == dfs_numbers_.end() || c_entry == dfs_numbers_.end())
+    if (p_entry < 0 || c_entry < 0)
         return false;
 
-    return p_entry->second <= c_entry->second && c_exit->second <= p_exit->second;
+    return p_entry <= c_entry && dfs_exit_numbers_[child] <= dfs_exit_numbers_[parent];
 }
 
 void LoopAnalyzer::PopulateLoops() {
+    header_to_loop_.Reset(graph_->GetBlockIdLimit(), nullptr);
+    block_to_all_loops_.Reset(graph_->GetBlockIdLimit());
+    visit_marks_.Reset(graph_->GetBlockIdLimit(), 0);
+    visit_epoch_ = 0;
+
     for (auto &back_edge : back_edges_) {
         BasicBlock *latch = back_edge.first;
         BasicBlock *header = back_edge.second;
 
-        Loop *loop = nullptr;
-        if (header_to_loop_.count(header)) {
-            loop = header_to_loop_[header];
-        } else {
+        Loop *loop = header_to_loop_[header];
+        if (loop == nullptr) {
             loop = new Loop(header);
             loops_.push_back(loop);
             header_to_loop_[header] = loop;
 
-            bool is_reducible = graph_analyzer_.Dominates(header, latch);
+            bool is_reducible = graph_analyzer_->Dominates(header, latch);
             loop->SetReducible(is_reducible);
         }
 
         loop->AddBackEdge(latch);
-        FindLoopBlocks(loop, latch);
     }
-}
 
-void LoopAnalyzer::FindLoopBlocks(Loop *loop, BasicBlock *latch) {
-    std::stack<BasicBlock *> stack;
-    std::unordered_set<BasicBlock *> visited;
+    // Each loop body is collected with a single walk shared by all of its latches: a latch
+    // already reached from another one contributes no new blocks. Loops are completed in
+    // creation order, so every per-block loop list comes out in the order of loops_.
+    for (Loop *loop : loops_) {
+        uint32_t epoch = ++visit_epoch_;
+        block_to_all_loops_[loop->GetHeader()].push_back(loop);
+        for (BasicBlock *latch : loop->GetBackEdges()) {
+            if (visit_marks_[latch] != epoch) {
+                FindLoopBlocks(loop, latch, epoch);
+            }
+        }
+    }
+}
 
-    stack.push(latch);
-    visited.insert(latch);
+void LoopAnalyzer::FindLoopBlocks(Loop *loop, BasicBlock *latch, uint32_t epoch) {
+    std::vector<BasicBlock *> &stack = walk_stack_;
+    stack.clear();
+    stack.push_back(latch);
+    visit_marks_[latch] = epoch;
 
     BasicBlock *header = loop->GetHeader();
 
     while (!stack.empty()) {
-        BasicBlock *current = stack.top();
-        stack.pop();
+        BasicBlock *current = stack.back();
+        stack.pop_back();
 
         if (current == header) {
             continue;
         }
 
-        if (!loop->ContainsBlock(current)) {
-            loop->AddBlock(current);
-        }
+        loop->AddBlock(current);
+        block_to_all_loops_[current].push_back(loop);
 
         for (BasicBlock *pred : current->GetPredecessors()) {
             bool is_valid = false;
 
             if (loop->IsReducible()) {
-                if (graph_analyzer_.Dominates(header, pred)) {
+                if (graph_analyzer_->Dominates(header, pred)) {
                     is_valid = true;
                 }
             } else {
@@ -125,9 +131,9 @@ void LoopAnalyzer::FindLoopBlocks(Loop *loop, BasicBlock *latch) {
                 }
             }
 
-            if (!visited.count(pred) && is_valid) {
-                visited.insert(pred);
-                stack.push(pred);
+            if (visit_marks_[pred] != epoch && is_valid) {
+                visit_marks_[pred] = epoch;
+                stack.push_back(pred);
             }
         }
     }
@@ -135,39 +141,22 @@ void LoopAnalyzer::FindLoopBlocks(Loop *loop, BasicBlock *latch) {
 
 void LoopAnalyzer::BuildLoopTree() {
     root_loop_ = new Loop(nullptr);
+    block_to_innermost_loop_.Reset(graph_->GetBlockIdLimit(), nullptr);
 
-    std::unordered_set<BasicBlock *> all_blocks;
-    for (const auto &bb : graph_->GetBlocks()) {
-        all_blocks.insert(const_cast<BasicBlock *>(&bb));
-    }
-
-    for (BasicBlock *block : all_blocks) {
+    // Only the loops recorded for a block can contain it, so the innermost one is picked
+    // from that short list instead of from every loop of the graph.
+    for (auto &bb : graph_->GetBlocks()) {
+        BasicBlock *block = &bb;
         Loop *innermost_loop = nullptr;
 
-        for (Loop *loop : loops_) {
-            if (loop->ContainsBlock(block)) {
-                if (innermost_loop == nullptr) {
-                    innermost_loop = loop;
-                } else {
-                    if (IsInnerLoop(loop, innermost_loop)) {
-                        innermost_loop = loop;
-                    }
-                }
+        for (Loop *loop : block_to_all_loops_[block]) {
+            if (innermost_loop == nullptr || IsInnerLoop(loop, innermost_loop)) {
+                innermost_loop = loop;
             }
         }
 
         if (innermost_loop != nullptr) {
             block_to_innermost_loop_[block] = innermost_loop;
-
-            std::vector<Loop *> loops_for_block;
-            for (Loop *loop : loops_) {
-                if (loop->ContainsBlock(block)) {
-                    loops_for_block.push_back(loop);
-                }
-            }
-            std::sort(loops_for_block.begin(), loops_for_block.end(),
-                      [this](Loop *a, Loop *b) { return !IsInnerLoop(a, b); });
-            block_to_all_loops_[block] = loops_for_block;
         } else {
             root_loop_->AddBlock(block);
         }
@@ -176,25 +165,38 @@ void LoopAnalyzer::BuildLoopTree() {
     for (Loop *loop : loops_) {
         Loop *outer = nullptr;
 
-        for (Loop *candidate : loops_) {
-            if (candidate != loop && candidate->ContainsBlock(loop->GetHeader())) {
+        for (Loop *candidate : block_to_all_loops_[loop->GetHeader()]) {
+            if (candidate != loop) {
                 if (outer == nullptr || IsInnerLoop(candidate, outer)) {
                     outer = candidate;
                 }
             }
         }
 
+        // Every loop is attached exactly once, here, so it cannot be in the tree yet.
         if (outer != nullptr) {
-            if (!outer->ContainsLoop(loop)) {
-                outer->AddInnerLoop(loop);
-            }
+            outer->AddInnerLoop(loop);
         } else {
-            if (!root_loop_->ContainsLoop(loop)) {
-                root_loop_->AddInnerLoop(loop);
-                loop->SetOuterLoop(nullptr);
-            }
+            root_loop_->AddInnerLoop(loop);
+            loop->SetOuterLoop(nullptr);
         }
     }
+
+    // Order the loops of every block from the outermost to the innermost one.
+    BlockMap<uint32_t> depth_of_header(graph_->GetBlockIdLimit(), 0);
+    for (Loop *loop : loops_) {
+        uint32_t depth = 0;
+        for (Loop *outer = loop->GetOuterLoop(); outer != nullptr; outer = outer->GetOuterLoop()) {
+            ++depth;
+        }
+        depth_of_header[loop->GetHeader()] = depth;
+    }
+    for (auto &bb : graph_->GetBlocks()) {
+        auto &loops = block_to_all_loops_[&bb];
+        std::stable_sort(loops.begin(), loops.end(), [&depth_of_header](Loop *a, Loop *b) {
+            return depth_of_header[a->GetHeader()] < depth_of_header[b->GetHeader()];
+        });
+    }
 }
 
 bool LoopAnalyzer::IsInnerLoop(Loop *inner, Loop *outer) const {
@@ -234,20 +236,14 @@ void LoopAnalyzer::CheckLoopCountable(Loop *loop) {
 }
 
 Loop *LoopAnalyzer::GetLoopForBlock(BasicBlock *block) const {
-    auto it = block_to_innermost_loop_.find(block);
-    return it != block_to_innermost_loop_.end() ? it->second : nullptr;
+    return block_to_innermost_loop_[block];
 }
 
 const std::vector<Loop *> &LoopAnalyzer::GetLoopsForBlock(BasicBlock *block) const {
-    static std::vector<Loop *> empty;
-    auto it = block_to_all_loops_.find(block);
-    if (it != block_to_all_loops_.end()) {
-        return it->second;
-    }
-    return empty;
+    return block_to_all_loops_[block];
 }
 
-bool LoopAnalyzer::IsLoopHeader(BasicBlock *block) const { return header_to_loop_.count(block) > 0; }
+bool LoopAnalyzer::IsLoopHeader(BasicBlock *block) const { return header_to_loop_[block] != nullptr; }
 
 void LoopAnalyzer::Dump(std::ostream &os) const {
     os << "Loop Analysis Results:\n";
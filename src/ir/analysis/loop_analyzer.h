@@ -1,16 +1,17 @@
 #pragma once
 
+#include "ir/analysis/depth_first_walker.h"
 #include "ir/analysis/graph_analyzer.h"
 #include "ir/analysis/loop.h"
+#include "ir/analysis/side_table.h"
 #include "ir/graph.h"
-#include <stack>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 class LoopAnalyzer {
   public:
     explicit LoopAnalyzer(Graph *graph);
+    // Reuses a dominator tree that is already built, e.g. the one cached by the AnalysisManager.
+    LoopAnalyzer(Graph *graph, const GraphAnalyzer *dominators);
     ~LoopAnalyzer();
 
     void Analyze();
@@ -20,6 +21,7 @@ class LoopAnalyzer {
     const std::vector<Loop *> &GetLoopsForBlock(BasicBlock *block) const;
     Loop *GetRootLoop() const { return root_loop_; }
     bool IsLoopHeader(BasicBlock *block) const;
+    Loop *GetLoopWithHeader(BasicBlock *header) const { return header_to_loop_[header]; }
 
     void Dump(std::ostream &os) const;
 
@@ -30,26 +32,29 @@ class LoopAnalyzer {
     void ClassifyLoops();
 
     bool IsBackEdge(BasicBlock *from, BasicBlock *to) const;
-    void FindLoopBlocks(Loop *loop, BasicBlock *latch);
-    void DFSForLoopBlocks(BasicBlock *block, BasicBlock *header, std::unordered_set<BasicBlock *> &visited, Loop *loop);
-    void MarkDFS(BasicBlock *block, std::unordered_set<BasicBlock *> &visited,
-                 std::unordered_set<BasicBlock *> &in_stack);
+    void FindLoopBlocks(Loop *loop, BasicBlock *latch, uint32_t epoch);
     void CheckLoopCountable(Loop *loop);
     bool IsInnerLoop(Loop *inner, Loop *outer) const;
     bool IsDescendant(BasicBlock *parent, BasicBlock *child) const;
 
     Graph *graph_;
-    GraphAnalyzer graph_analyzer_;
+    GraphAnalyzer own_graph_analyzer_;
+    const GraphAnalyzer *graph_analyzer_;
     std::vector<Loop *> loops_;
     Loop *root_loop_ = nullptr;
 
-    std::unordered_map<BasicBlock *, Loop *> header_to_loop_;
-    std::unordered_map<BasicBlock *, Loop *> block_to_innermost_loop_;
-    std::unordered_map<BasicBlock *, std::vector<Loop *>> block_to_all_loops_;
+    BlockMap<Loop *> header_to_loop_;
+    BlockMap<Loop *> block_to_innermost_loop_;
+    BlockMap<std::vector<Loop *>> block_to_all_loops_;
     std::vector<std::pair<BasicBlock *, BasicBlock *>> back_edges_;
 
-    std::unordered_map<BasicBlock *, int> dfs_numbers_;
-    std::unordered_map<BasicBlock *, int> dfs_exit_numbers_;
-    std::unordered_set<BasicBlock *> in_stack_;
+    BlockMap<int> dfs_numbers_;
+    BlockMap<int> dfs_exit_numbers_;
+    DepthFirstWalker walker_;
     int dfs_counter_ = 0;
+
+    // Per-loop visitation stamps, so FindLoopBlocks needs no allocation per back edge.
+    BlockMap<uint32_t> visit_marks_;
+    uint32_t visit_epoch_ = 0;
+    std::vector<BasicBlock *> walk_stack_;
 };
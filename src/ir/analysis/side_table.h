@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+class BasicBlock;
+class Instruction;
+
+// Flat side table indexed by the dense ids the Graph hands out to blocks and
+// instructions. Lookups of keys that were never written yield the default value,
+// so analyses use a sentinel default instead of a separate "contains" check.
+// Note: prefer uint8_t over bool for flags, std::vector<bool> has no references.
+template <typename Key, typename T> class IdMap {
+  public:
+    IdMap() = default;
+    explicit IdMap(size_t size, const T &default_value = T()) : default_(default_value), data_(size, default_value) {}
+
+    void Reset(size_t size) {
+        data_.clear();
+        data_.resize(size, default_);
+    }
+    void Reset(size_t size, const T &default_value) {
+        default_ = default_value;
+        Reset(size);
+    }
+    void clear() { data_.clear(); }
+
+    T &operator[](const Key *key) {
+        size_t id = key->GetId();
+        if (id >= data_.size()) {
+            data_.resize(id + 1, default_);
+        }
+        return data_[id];
+    }
+
+    const T &operator[](const Key *key) const {
+        size_t id = key->GetId();
+        return id < data_.size() ? data_[id] : default_;
+    }
+
+    const T &at(const Key *key) const {
+        size_t id = key->GetId();
+        if (id >= data_.size()) {
+            throw std::out_of_range("IdMap: id is out of range");
+        }
+        return data_[id];
+    }
+
+    size_t size() const { return data_.size(); }
+    const T &GetDefault() const { return default_; }
+
+    auto begin() { return data_.begin(); }
+    auto end() { return data_.end(); }
+    auto begin() const { return data_.begin(); }
+    auto end() const { return data_.end(); }
+
+  private:
+    T default_{};
+    std::vector<T> data_;
+};
+
+template <typename T> using BlockMap = IdMap<BasicBlock, T>;
+template <typename T> using InstMap = IdMap<Instruction, T>;
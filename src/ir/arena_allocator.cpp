@@ -0,0 +1,34 @@
+#include "ir/arena_allocator.h"
+#include <algorithm>
+
+ArenaAllocator::~ArenaAllocator() {
+    for (char *chunk : chunks_) {
+        delete[] chunk;
+    }
+}
+
+void *ArenaAllocator::Allocate(size_t size, size_t align) {
+    uintptr_t aligned = (cur_ + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+    if (cur_ == 0 || aligned + size > end_) {
+        return AllocateInNewChunk(size, align);
+    }
+    cur_ = aligned + size;
+    allocated_bytes_ += size;
+    return reinterpret_cast<void *>(aligned);
+}
+
+void *ArenaAllocator::AllocateInNewChunk(size_t size, size_t align) {
+    // Oversized requests get a dedicated chunk so the current one keeps being filled.
+    size_t chunk_size = std::max(chunk_size_, size + align);
+    char *chunk = new char[chunk_size];
+    chunks_.push_back(chunk);
+
+    uintptr_t begin = reinterpret_cast<uintptr_t>(chunk);
+    uintptr_t aligned = (begin + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+    if (chunk_size == chunk_size_ || cur_ == 0) {
+        cur_ = aligned + size;
+        end_ = begin + chunk_size;
+    }
+    allocated_bytes_ += size;
+    return reinterpret_cast<void *>(aligned);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Bump-pointer allocator owning all IR storage of a Graph. Memory is only
+// released in bulk when the arena is destroyed; objects placed into the arena
+// are not destroyed by it, so owners must run non-trivial destructors themselves.
+class ArenaAllocator {
+  public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit ArenaAllocator(size_t chunk_size = DEFAULT_CHUNK_SIZE) : chunk_size_(chunk_size) {}
+    ~ArenaAllocator();
+
+    ArenaAllocator(const ArenaAllocator &) = delete;
+    ArenaAllocator &operator=(const ArenaAllocator &) = delete;
+
+    void *Allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+    template <typename T, typename... Args> T *New(Args &&...args) {
+        void *mem = Allocate(sizeof(T), alignof(T));
+        return new (mem) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T> T *AllocateArray(size_t count) {
+        return static_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    size_t GetAllocatedBytes() const { return allocated_bytes_; }
+    size_t GetChunkCount() const { return chunks_.size(); }
+
+  private:
+    void *AllocateInNewChunk(size_t size, size_t align);
+
+    size_t chunk_size_;
+    std::vector<char *> chunks_;
+    uintptr_t cur_ = 0;
+    uintptr_t end_ = 0;
+    size_t allocated_bytes_ = 0;
+};
+
+// std-compatible adapter so that standard containers can place their nodes into an arena.
+// Deallocation is a no-op: the memory is reclaimed together with the arena.
+template <typename T> class ArenaStdAllocator {
+  public:
+    using value_type = T;
+
+    explicit ArenaStdAllocator(ArenaAllocator *arena) : arena_(arena) {}
+    template <typename U> ArenaStdAllocator(const ArenaStdAllocator<U> &other) : arena_(other.GetArena()) {}
+
+    T *allocate(size_t n) { return arena_->AllocateArray<T>(n); }
+    void deallocate(T *, size_t) {}
+
+    ArenaAllocator *GetArena() const { return arena_; }
+
+    template <typename U> bool operator==(const ArenaStdAllocator<U> &other) const {
+        return arena_ == other.GetArena();
+    }
+    template <typename U> bool operator!=(const ArenaStdAllocator<U> &other) const {
+        return arena_ != other.GetArena();
+    }
+
+  private:
+    ArenaAllocator *arena_;
+};
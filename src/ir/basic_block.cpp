@@ -1,13 +1,21 @@
 #include "ir/basic_block.h"
 #include "ir/instruction.h"
 #include "ir/graph.h"
+#include <algorithm>
 #include <ostream>
+#include <stdexcept>
 
 void BasicBlock::PushBackInstruction(Instruction *inst) {
     if (first_inst_ == nullptr) {
         first_inst_ = inst;
         last_inst_ = inst;
+        inst->order_ = ORDER_STEP;
     } else {
+        if (last_inst_->order_ > UINT32_MAX - ORDER_STEP) {
+            order_valid_ = false;
+        } else {
+            inst->order_ = last_inst_->order_ + ORDER_STEP;
+        }
         last_inst_->next_ = inst;
         inst->prev_ = last_inst_;
         last_inst_ = inst;
@@ -18,6 +26,12 @@ void BasicBlock::PushBackInstruction(Instruction *inst) {
 
 void BasicBlock::InsertBefore(Instruction *new_inst, Instruction *before_inst) {
     new_inst->basic_block_ = this;
+    uint32_t lower = before_inst->prev_ ? before_inst->prev_->order_ : 0;
+    if (before_inst->order_ - lower > 1) {
+        new_inst->order_ = lower + (before_inst->order_ - lower) / 2;
+    } else {
+        order_valid_ = false;
+    }
     if (before_inst == first_inst_) {
         new_inst->next_ = first_inst_;
         first_inst_->prev_ = new_inst;
@@ -46,6 +60,11 @@ void BasicBlock::RemoveInstruction(Instruction *inst) {
     inst->basic_block_ = nullptr;
 }
 
+void BasicBlock::EraseInstruction(Instruction *inst) {
+    RemoveInstruction(inst);
+    inst->ClearInputs();
+}
+
 BasicBlock *BasicBlock::SplitAt(Instruction *inst) {
     BasicBlock *new_bb = parent_graph_->CreateBasicBlock();
 
@@ -74,10 +93,58 @@ BasicBlock *BasicBlock::SplitAt(Instruction *inst) {
     for (Instruction *curr = new_bb->first_inst_; curr != nullptr; curr = curr->next_) {
         curr->basic_block_ = new_bb;
     }
+    // The moved tail keeps increasing indices, so both halves stay ordered.
+    new_bb->order_valid_ = order_valid_;
 
     return new_bb;
 }
 
+BasicBlock *BasicBlock::SplitEdge(size_t succ_idx) {
+    BasicBlock *succ = successors_[succ_idx];
+    BasicBlock *new_bb = parent_graph_->CreateBasicBlock();
+    new_bb->PushBackInstruction(parent_graph_->NewInstruction<JumpInst>(succ));
+    new_bb->predecessors_.push_back(this);
+    new_bb->successors_.push_back(succ);
+
+    // Parallel edges to the same block are matched up in order, so each phi input keeps its edge.
+    auto occurrence = std::count(successors_.begin(), successors_.begin() + succ_idx, succ);
+    for (auto &pred : succ->predecessors_) {
+        if (pred == this && occurrence-- == 0) {
+            pred = new_bb;
+            break;
+        }
+    }
+    successors_[succ_idx] = new_bb;
+
+    if (auto *branch = dynamic_cast<BranchInst *>(last_inst_)) {
+        // The true target is always the first successor of a branch.
+        if (succ_idx == 0) {
+            branch->SetTrueBB(new_bb);
+        } else {
+            branch->SetFalseBB(new_bb);
+        }
+    } else if (auto *jump = dynamic_cast<JumpInst *>(last_inst_)) {
+        jump->SetTarget(new_bb);
+    }
+    return new_bb;
+}
+
+void BasicBlock::RenumberInstructions() const {
+    uint32_t order = 0;
+    for (Instruction *inst = first_inst_; inst != nullptr; inst = inst->next_) {
+        order += ORDER_STEP;
+        inst->order_ = order;
+    }
+    order_valid_ = true;
+}
+
+bool BasicBlock::IsBefore(const Instruction *a, const Instruction *b) const {
+    if (!order_valid_) {
+        RenumberInstructions();
+    }
+    return a->order_ < b->order_;
+}
+
 void BasicBlock::AddPredecessor(BasicBlock *pred) { predecessors_.push_back(pred); }
 
 void BasicBlock::AddSuccessor(BasicBlock *succ) { successors_.push_back(succ); }
@@ -104,6 +171,27 @@ void BasicBlock::ClearSuccessors() {
     successors_.clear();
 }
 
+void BasicBlock::RemoveSuccessor(BasicBlock *succ) {
+    auto it = std::find(successors_.begin(), successors_.end(), succ);
+    if (it == successors_.end()) {
+        return;
+    }
+
+    auto &preds = succ->predecessors_;
+    auto pred_it = std::find(preds.begin(), preds.end(), this);
+    if (pred_it == preds.end()) {
+        throw std::runtime_error("Successor does not list the block as a predecessor");
+    }
+    successors_.erase(it);
+    size_t index = std::distance(preds.begin(), pred_it);
+    preds.erase(pred_it);
+    for (auto *inst = succ->first_inst_; inst != nullptr && inst->GetOpcode() == Opcode::PHI; inst = inst->next_) {
+        if (index < inst->GetInputs().size()) {
+            inst->RemoveInput(index);
+        }
+    }
+}
+
 static void PrintBlockList(std::ostream &os, const char *label, const std::vector<BasicBlock *> &list) {
     os << label << ":";
 
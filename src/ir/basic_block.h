@@ -23,14 +23,25 @@ class BasicBlock {
     void PushBackInstruction(Instruction *inst);
     void InsertBefore(Instruction *new_inst, Instruction *before_inst);
     void RemoveInstruction(Instruction *inst);
+    // Unlinks the instruction and drops the use edges of its inputs.
+    void EraseInstruction(Instruction *inst);
     BasicBlock *SplitAt(Instruction *inst);
+    // Inserts an empty block (a single jump) on the edge to successor `succ_idx` and returns it.
+    BasicBlock *SplitEdge(size_t succ_idx);
     void AddPredecessor(BasicBlock *pred);
     void AddSuccessor(BasicBlock *succ);
     void ReplacePredecessor(BasicBlock *old_pred, BasicBlock *new_pred);
     void RemovePredecessor(BasicBlock *pred);
     void ClearSuccessors();
+    // Drops the edge to `succ`, together with its entry in the predecessors and phis of `succ`.
+    void RemoveSuccessor(BasicBlock *succ);
     void Dump(std::ostream &os) const;
 
+    // O(1) intra-block ordering: true if `a` strictly precedes `b`, both being in this block.
+    // Order indices are assigned with gaps and renumbered lazily when an insert finds no room.
+    bool IsBefore(const Instruction *a, const Instruction *b) const;
+    void InvalidateInstructionOrder() { order_valid_ = false; }
+
   private:
     friend class Graph;
     friend class IRBuilder;
@@ -42,4 +53,8 @@ class BasicBlock {
     std::vector<BasicBlock *> successors_;
     Instruction *first_inst_ = nullptr;
     Instruction *last_inst_ = nullptr;
+
+    static constexpr uint32_t ORDER_STEP = 1U << 10;
+    void RenumberInstructions() const;
+    mutable bool order_valid_ = true;
 };
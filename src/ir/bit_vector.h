@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Dense set of small integers (block or instruction ids) packed into 64-bit words.
+// Setting a bit past the end grows the vector; testing one reads as unset.
+class BitVector {
+  public:
+    BitVector() = default;
+    explicit BitVector(size_t size) { Resize(size); }
+
+    size_t size() const { return size_; }
+
+    void Resize(size_t size) {
+        size_ = size;
+        words_.resize(WordCount(size), 0);
+        ClearTail();
+    }
+
+    bool Test(size_t idx) const { return idx < size_ && (words_[idx / WORD_BITS] & Mask(idx)) != 0; }
+
+    void Set(size_t idx) {
+        if (idx >= size_) {
+            Resize(idx + 1);
+        }
+        words_[idx / WORD_BITS] |= Mask(idx);
+    }
+
+    void Clear(size_t idx) {
+        if (idx < size_) {
+            words_[idx / WORD_BITS] &= ~Mask(idx);
+        }
+    }
+
+    void ClearAll() { std::fill(words_.begin(), words_.end(), 0); }
+
+    // Drops trailing zero words; cheap to do for sets whose high bits are rarely used.
+    void ShrinkToFit() {
+        size_t words = words_.size();
+        while (words > 0 && words_[words - 1] == 0) {
+            --words;
+        }
+        words_.resize(words);
+        words_.shrink_to_fit();
+        size_ = std::min(size_, words * WORD_BITS);
+    }
+
+    // Word-parallel set union; the loop is simple enough for the compiler to vectorize.
+    // Returns whether any bit was added. The result is at least as large as `other`.
+    bool Union(const BitVector &other) {
+        if (other.size_ > size_) {
+            Resize(other.size_);
+        }
+        uint64_t added = 0;
+        const uint64_t *src = other.words_.data();
+        uint64_t *dst = words_.data();
+        for (size_t i = 0, n = other.words_.size(); i < n; ++i) {
+            added |= src[i] & ~dst[i];
+            dst[i] |= src[i];
+        }
+        return added != 0;
+    }
+
+    bool Any() const {
+        return std::any_of(words_.begin(), words_.end(), [](uint64_t word) { return word != 0; });
+    }
+
+    size_t Count() const {
+        size_t count = 0;
+        for (uint64_t word : words_) {
+            count += std::popcount(word);
+        }
+        return count;
+    }
+
+    // Calls `func(idx)` for every set bit in increasing order.
+    template <typename Func> void ForEachSetBit(Func &&func) const {
+        for (size_t i = 0; i < words_.size(); ++i) {
+            for (uint64_t word = words_[i]; word != 0; word &= word - 1) {
+                func(i * WORD_BITS + std::countr_zero(word));
+            }
+        }
+    }
+
+  private:
+    static constexpr size_t WORD_BITS = 64;
+
+    static size_t WordCount(size_t bits) { return (bits + WORD_BITS - 1) / WORD_BITS; }
+    static uint64_t Mask(size_t idx) { return uint64_t{1} << (idx % WORD_BITS); }
+
+    // Keeps bits past size_ zero after shrinking, so growing again exposes cleared bits.
+    void ClearTail() {
+        if (size_ % WORD_BITS != 0) {
+            words_.back() &= (uint64_t{1} << (size_ % WORD_BITS)) - 1;
+        }
+    }
+
+    std::vector<uint64_t> words_;
+    size_t size_ = 0;
+};
@@ -1,7 +1,32 @@
 #include "ir/graph.h"
+#include "ir/analysis/analysis_manager.h"
 #include "ir/basic_block.h"
 #include "ir/instruction.h"
+#include <algorithm>
 #include <ostream>
+#include <stdexcept>
+#include <vector>
+
+Graph::Graph() : blocks_(ArenaStdAllocator<BasicBlock>(&arena_)) {}
+
+Graph::~Graph() {
+    // Analyses may still reference instructions, so they go before them.
+    analyses_.reset();
+    // Instructions live in the arena, so only their destructors have to run here;
+    // the memory itself is released in bulk together with the arena.
+    for (auto *inst : instructions_) {
+        if (inst != nullptr) {
+            inst->~Instruction();
+        }
+    }
+}
+
+AnalysisManager &Graph::GetAnalyses() {
+    if (analyses_ == nullptr) {
+        analyses_ = std::make_unique<AnalysisManager>(this);
+    }
+    return *analyses_;
+}
 
 BasicBlock *Graph::CreateBasicBlock() {
     blocks_.emplace_back(next_block_id_++, this);
@@ -11,15 +36,81 @@ BasicBlock *Graph::CreateBasicBlock() {
     return &blocks_.back();
 }
 
+void Graph::RemoveBasicBlock(BasicBlock *bb) {
+    auto it = std::find_if(blocks_.begin(), blocks_.end(), [bb](const BasicBlock &block) { return &block == bb; });
+    if (it != blocks_.end()) {
+        RemoveBasicBlock(it);
+    }
+}
+
+BlockList::iterator Graph::RemoveBasicBlock(BlockList::iterator it) {
+    BasicBlock *bb = &*it;
+    while (!bb->GetSuccessors().empty()) {
+        bb->RemoveSuccessor(bb->GetSuccessors().back());
+    }
+    for (auto *pred : bb->GetPredecessors()) {
+        std::erase(pred->successors_, bb);
+    }
+    for (auto *inst = bb->GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
+        inst->ClearInputs();
+        inst->SetBasicBlock(nullptr);
+    }
+    // Users left are in other blocks being removed; they lose the input before the value goes.
+    Instruction *next = nullptr;
+    for (auto *inst = bb->GetFirstInstruction(); inst != nullptr; inst = next) {
+        next = inst->GetNext();
+        inst->ReplaceAllUsesWith(nullptr);
+        DeleteInstruction(inst);
+    }
+    return blocks_.erase(it);
+}
+
+void Graph::DeleteInstruction(Instruction *inst) {
+    if (inst->GetBasicBlock() != nullptr || inst->GetFirstUser() != nullptr || !inst->GetInputs().empty()) {
+        throw std::runtime_error("Only detached instructions without inputs and users can be deleted");
+    }
+    // Ids are handed out in creation order, so the id is the slot of the instruction.
+    instructions_[inst->GetId()] = nullptr;
+    inst->~Instruction();
+}
+
 User *Graph::RegisterUse(Instruction *def, Instruction *user_inst, uint32_t input_idx) {
-    auto user = std::make_unique<User>(user_inst, input_idx);
-    User *node = user.get();
-    node->SetNextUser(def->head_user_);
-    def->head_user_ = node;
-    users_.push_back(std::move(user));
+    if (def == nullptr) {
+        return nullptr;
+    }
+    if (user_inst->input_users_.size() <= input_idx) {
+        user_inst->input_users_.resize(input_idx + 1, nullptr);
+    }
+
+    User *node = user_inst->input_users_[input_idx];
+    if (node == nullptr) {
+        if (free_users_) {
+            node = free_users_;
+            free_users_ = node->next_user_;
+            node->user_inst_ = user_inst;
+            node->input_idx_ = input_idx;
+            node->next_user_ = nullptr;
+        } else {
+            node = arena_.New<User>(user_inst, input_idx);
+        }
+        user_inst->input_users_[input_idx] = node;
+    } else if (node->def_ == def) {
+        return node;
+    } else if (node->def_) {
+        node->def_->UnlinkUser(node);
+    }
+
+    def->LinkUser(node);
     return node;
 }
 
+void Graph::ReleaseUser(User *user) {
+    user->def_ = nullptr;
+    user->prev_user_ = nullptr;
+    user->next_user_ = free_users_;
+    free_users_ = user;
+}
+
 // void Graph::Dump(std::ostream& os) const {
 //     for (const auto& bb : blocks_) {
 //         bb.Dump(os);
@@ -1,39 +1,87 @@
 #pragma once
 
+#include "ir/arena_allocator.h"
 #include <iosfwd>
 #include <list>
 #include <memory>
+#include <utility>
 #include <vector>
 
 class BasicBlock;
 class Instruction;
 class User;
 class ArgumentInst;
+class AnalysisManager;
+
+using BlockList = std::list<BasicBlock, ArenaStdAllocator<BasicBlock>>;
 
 class Graph {
   public:
-    Graph() = default;
+    Graph();
+    ~Graph();
+
+    Graph(const Graph &) = delete;
+    Graph &operator=(const Graph &) = delete;
+
     BasicBlock *CreateBasicBlock();
-    const std::list<BasicBlock> &GetBlocks() const { return blocks_; }
-    std::list<BasicBlock> &GetBlocks() { return blocks_; }
+    // Deletes a block that no block staying in the graph branches to, together with its
+    // instructions; values it defines must have no users left outside the removed blocks.
+    void RemoveBasicBlock(BasicBlock *bb);
+    // Same, for the block at `it`, without searching the block list; returns the block after it.
+    BlockList::iterator RemoveBasicBlock(BlockList::iterator it);
+    const BlockList &GetBlocks() const { return blocks_; }
+    BlockList &GetBlocks() { return blocks_; }
 
     BasicBlock *GetStartBlock() const { return start_block_; }
     void SetStartBlock(BasicBlock *bb) { start_block_ = bb; }
 
+    // Upper bounds of the dense ids handed out so far; used to size id-indexed side tables.
+    uint32_t GetBlockIdLimit() const { return next_block_id_; }
+    uint32_t GetInstIdLimit() const { return next_inst_id_; }
+
+    // Binds input `input_idx` of `user_inst` to `def` in the use-list of `def`. The use
+    // node of the slot is reused if one is already registered.
     User *RegisterUse(Instruction *def, Instruction *user_inst, uint32_t input_idx);
+    // Returns a use node that is no longer linked anywhere to the free list.
+    void ReleaseUser(User *user);
     void Dump(std::ostream &os) const;
     const auto &GetArguments() const { return args_; }
 
+    // Bytes of stack frame the register allocator needs for spill slots.
+    uint32_t GetFrameSize() const { return frame_size_; }
+    void SetFrameSize(uint32_t frame_size) { frame_size_ = frame_size; }
+
+    // Allocates a detached instruction in the graph arena and assigns it a fresh id.
+    template <typename InstType, typename... Args> InstType *NewInstruction(Args &&...args) {
+        auto *inst = arena_.New<InstType>(next_inst_id_++, std::forward<Args>(args)...);
+        inst->graph_ = this;
+        instructions_.push_back(inst);
+        return inst;
+    }
+
+    // Destroys an instruction that is in no block and neither has inputs nor users. The arena keeps
+    // its bytes until the graph goes, but heap storage of its operands is returned right away.
+    void DeleteInstruction(Instruction *inst);
+
+    ArenaAllocator *GetArena() { return &arena_; }
+
+    // Cached analyses of this graph, created on first use.
+    AnalysisManager &GetAnalyses();
+
   private:
     friend class IRBuilder;
     friend class Inliner;
 
-    std::list<BasicBlock> blocks_;
-    std::list<std::unique_ptr<Instruction>> instructions_;
-    std::list<std::unique_ptr<User>> users_;
+    // Must be declared first: everything below may hold memory from it.
+    ArenaAllocator arena_;
+    BlockList blocks_;
+    std::vector<Instruction *> instructions_;
+    User *free_users_ = nullptr;
 
     BasicBlock *start_block_ = nullptr;
     uint32_t next_block_id_ = 0;
     uint32_t next_inst_id_ = 0;
     std::vector<ArgumentInst *> args_;
+    uint32_t frame_size_ = 0;
+    std::unique_ptr<AnalysisManager> analyses_;
 };
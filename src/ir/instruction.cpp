@@ -39,6 +39,8 @@ static const char *OpcodeToString(Opcode op) {
         return "Load";
     case Opcode::STORE:
         return "Store";
+    case Opcode::SWAP:
+        return "Swap";
     case Opcode::CALL_STATIC:
         return "CallStatic";
     case Opcode::NULL_CHECK:
@@ -89,7 +91,7 @@ static const char *ConditionCodeToString(ConditionCode cc) {
     return "<unknown-cc>";
 }
 
-static void PrintInputs(std::ostream &os, const std::vector<Instruction *> &inputs) {
+static void PrintInputs(std::ostream &os, const InputList &inputs) {
     os << "(";
     for (size_t i = 0; i < inputs.size(); ++i) {
         if (i)
@@ -189,6 +191,12 @@ void StoreInst::Print(std::ostream &os) const {
     PrintUsers(os, this);
 }
 
+void SwapInst::Print(std::ostream &os) const {
+    os << "i" << GetId() << "." << TypeToString(GetType()) << " " << OpcodeToString(GetOpcode()) << " ";
+    PrintInputs(os, GetInputs());
+    PrintUsers(os, this);
+}
+
 void CallStaticInst::Print(std::ostream &os) const {
     os << "i" << GetId() << "." << TypeToString(GetType()) << " CallStatic ";
     PrintInputs(os, GetInputs());
@@ -214,43 +222,44 @@ void DeoptimizeInst::Print(std::ostream &os) const {
 }
 
 Instruction *ConstantInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new ConstantInst(0, GetType(), GetValue());
+    return target_graph->NewInstruction<ConstantInst>(GetType(), GetValue());
 }
 
 Instruction *BinaryInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new BinaryInst(0, GetOpcode(), GetType(), MapInput(GetInputs()[0], mapping),
-                          MapInput(GetInputs()[1], mapping));
+    return target_graph->NewInstruction<BinaryInst>(GetOpcode(), GetType(), MapInput(GetInputs()[0], mapping),
+                                                    MapInput(GetInputs()[1], mapping));
 }
 
 Instruction *CompareInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new CompareInst(0, GetType(), cc_, MapInput(GetInputs()[0], mapping), MapInput(GetInputs()[1], mapping));
+    return target_graph->NewInstruction<CompareInst>(GetType(), cc_, MapInput(GetInputs()[0], mapping),
+                                                     MapInput(GetInputs()[1], mapping));
 }
 
 Instruction *BranchInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new BranchInst(0, MapInput(GetInputs()[0], mapping), true_bb_, false_bb_);
+    return target_graph->NewInstruction<BranchInst>(MapInput(GetInputs()[0], mapping), true_bb_, false_bb_);
 }
 
 Instruction *JumpInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new JumpInst(0, target_bb_);
+    return target_graph->NewInstruction<JumpInst>(target_bb_);
 }
 
 Instruction *ReturnInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
     if (GetInputs().empty()) {
-        return new ReturnInst(0);
+        return target_graph->NewInstruction<ReturnInst>();
     }
-    return new ReturnInst(0, MapInput(GetInputs()[0], mapping));
+    return target_graph->NewInstruction<ReturnInst>(MapInput(GetInputs()[0], mapping));
 }
 
 Instruction *ArgumentInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new ArgumentInst(0, GetType());
+    return target_graph->NewInstruction<ArgumentInst>(GetType());
 }
 
 Instruction *CastInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new CastInst(0, GetType(), MapInput(GetInputs()[0], mapping));
+    return target_graph->NewInstruction<CastInst>(GetType(), MapInput(GetInputs()[0], mapping));
 }
 
 Instruction *PhiInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    auto *new_phi = new PhiInst(0, GetType());
+    auto *new_phi = target_graph->NewInstruction<PhiInst>(GetType());
     new_phi->ResizeInputs(GetInputs().size());
     for (size_t i = 0; i < GetInputs().size(); ++i) {
         new_phi->SetInput(i, MapInput(GetInputs()[i], mapping));
@@ -259,15 +268,24 @@ Instruction *PhiInst::Clone(Graph *target_graph, const InstMapping &mapping) con
 }
 
 Instruction *MoveInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new MoveInst(0, GetType(), MapInput(GetInputs()[0], mapping));
+    return target_graph->NewInstruction<MoveInst>(GetType(), MapInput(GetInputs()[0], mapping));
 }
 
 Instruction *LoadInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new LoadInst(0, GetType(), MapInput(GetInputs()[0], mapping));
+    return target_graph->NewInstruction<LoadInst>(GetType(), MapInput(GetInputs()[0], mapping));
 }
 
 Instruction *StoreInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new StoreInst(0, GetType(), MapInput(GetInputs()[0], mapping), MapInput(GetInputs()[1], mapping));
+    return target_graph->NewInstruction<StoreInst>(GetType(), MapInput(GetInputs()[0], mapping),
+                                                   MapInput(GetInputs()[1], mapping));
+}
+
+Instruction *SwapInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
+    if (IsSecondHalf()) {
+        return target_graph->NewInstruction<SwapInst>(GetType(), MapInput(GetInputs()[0], mapping));
+    }
+    return target_graph->NewInstruction<SwapInst>(GetType(), MapInput(GetInputs()[0], mapping),
+                                                  MapInput(GetInputs()[1], mapping));
 }
 
 Instruction *CallStaticInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
@@ -275,19 +293,20 @@ Instruction *CallStaticInst::Clone(Graph *target_graph, const InstMapping &mappi
     for (auto *arg : GetInputs()) {
         new_args.push_back(MapInput(arg, mapping));
     }
-    return new CallStaticInst(0, callee_, new_args);
+    return target_graph->NewInstruction<CallStaticInst>(callee_, new_args);
 }
 
 Instruction *NullCheckInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new NullCheckInst(0, MapInput(GetInputs()[0], mapping));
+    return target_graph->NewInstruction<NullCheckInst>(MapInput(GetInputs()[0], mapping));
 }
 
 Instruction *BoundsCheckInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new BoundsCheckInst(0, MapInput(GetInputs()[0], mapping), MapInput(GetInputs()[1], mapping));
+    return target_graph->NewInstruction<BoundsCheckInst>(MapInput(GetInputs()[0], mapping),
+                                                         MapInput(GetInputs()[1], mapping));
 }
 
 Instruction *DeoptimizeInst::Clone(Graph *target_graph, const InstMapping &mapping) const {
-    return new DeoptimizeInst(0);
+    return target_graph->NewInstruction<DeoptimizeInst>();
 }
 
 void PhiInst::AddIncoming(Instruction *value, BasicBlock *pred) {
@@ -307,27 +326,97 @@ void PhiInst::AddIncoming(Instruction *value, BasicBlock *pred) {
         ResizeInputs(index + 1);
     }
     SetInput(index, value);
+}
+
+void Instruction::LinkUser(User *user) {
+    user->def_ = this;
+    user->prev_user_ = nullptr;
+    user->next_user_ = head_user_;
+    if (head_user_) {
+        head_user_->prev_user_ = user;
+    }
+    head_user_ = user;
+}
 
-    parent_bb->GetGraph()->RegisterUse(value, this, static_cast<uint32_t>(index));
+void Instruction::UnlinkUser(User *user) {
+    if (user->prev_user_) {
+        user->prev_user_->next_user_ = user->next_user_;
+    } else {
+        head_user_ = user->next_user_;
+    }
+    if (user->next_user_) {
+        user->next_user_->prev_user_ = user->prev_user_;
+    }
+    user->def_ = nullptr;
+    user->prev_user_ = user->next_user_ = nullptr;
 }
 
-void Instruction::ReplaceAllUsesWith(Instruction *other_inst) {
-    if (this == other_inst)
+void Instruction::ReleaseInputUser(size_t idx) {
+    User *user = input_users_[idx];
+    if (user == nullptr) {
         return;
+    }
+    if (user->def_) {
+        user->def_->UnlinkUser(user);
+    }
+    input_users_[idx] = nullptr;
+    if (graph_) {
+        graph_->ReleaseUser(user);
+    }
+}
 
-    User *current_user = head_user_;
-    while (current_user) {
-        Instruction *user_inst = current_user->GetUserInstruction();
-        uint32_t idx = current_user->GetInputIndex();
+void Instruction::SetInput(size_t idx, Instruction *inst) {
+    User *user = input_users_[idx];
+    inputs_[idx] = inst;
+    if (user == nullptr) {
+        // The slot was empty or never linked, so it gets its use edge now.
+        if (inst != nullptr && graph_) {
+            graph_->RegisterUse(inst, this, static_cast<uint32_t>(idx));
+        }
+        return;
+    }
+    if (user->def_ == inst) {
+        return;
+    }
+    if (inst == nullptr) {
+        ReleaseInputUser(idx);
+        return;
+    }
+    if (user->def_) {
+        user->def_->UnlinkUser(user);
+    }
+    inst->LinkUser(user);
+}
 
-        user_inst->SetInput(idx, other_inst);
+void Instruction::ResizeInputs(size_t new_size) {
+    for (size_t i = new_size; i < input_users_.size(); ++i) {
+        ReleaseInputUser(i);
+    }
+    inputs_.resize(new_size);
+    input_users_.resize(new_size);
+}
 
-        if (auto *bb = user_inst->GetBasicBlock()) {
-            bb->GetGraph()->RegisterUse(other_inst, user_inst, idx);
+void Instruction::RemoveInput(size_t idx) {
+    ReleaseInputUser(idx);
+    for (size_t i = idx + 1; i < inputs_.size(); ++i) {
+        inputs_[i - 1] = inputs_[i];
+        input_users_[i - 1] = input_users_[i];
+        if (input_users_[i - 1]) {
+            input_users_[i - 1]->input_idx_ = static_cast<uint32_t>(i - 1);
         }
-
-        current_user = current_user->GetNextUser();
     }
+    inputs_.pop_back();
+    input_users_.pop_back();
+}
+
+void Instruction::ClearInputs() { ResizeInputs(0); }
 
-    head_user_ = nullptr;
+void Instruction::ReplaceAllUsesWith(Instruction *other_inst) {
+    if (this == other_inst)
+        return;
+
+    while (head_user_) {
+        User *current_user = head_user_;
+        current_user->GetUserInstruction()->SetInput(current_user->GetInputIndex(), other_inst);
+    }
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ir/small_vector.h"
 #include "ir/types.h"
 #include <cstdint>
 #include <iostream>
@@ -13,6 +14,10 @@ class User;
 
 using InstMapping = std::map<Instruction *, Instruction *>;
 
+// Operands are stored inline for fixed-arity opcodes and small phis/calls.
+static constexpr size_t INLINE_INPUTS = 2;
+using InputList = SmallVector<Instruction *, INLINE_INPUTS>;
+
 inline Instruction *MapInput(Instruction *input, const InstMapping &mapping) {
     if (input == nullptr)
         return nullptr;
@@ -33,16 +38,21 @@ class Location {
         UNASSIGNED,
         REGISTER,
         STACK,
+        // Held nowhere: the value is a constant and is created again wherever it is needed.
+        CONSTANT,
     };
 
     Location() : kind_(UNASSIGNED), value_(0) {}
 
     static Location MakeRegister(int32_t reg_num) { return Location(REGISTER, reg_num); }
     static Location MakeStack(int32_t offset) { return Location(STACK, offset); }
+    static Location MakeConstant() { return Location(CONSTANT, 0); }
 
     Kind GetKind() const { return kind_; }
     int32_t GetValue() const { return value_; }
 
+    bool operator==(const Location &other) const = default;
+
   private:
     Location(Kind kind, int32_t value) : kind_(kind), value_(value){};
 
@@ -56,13 +66,19 @@ class User {
 
     Instruction *GetUserInstruction() const { return user_inst_; }
     uint32_t GetInputIndex() const { return input_idx_; }
+    Instruction *GetDef() const { return def_; }
 
     User *GetNextUser() const { return next_user_; }
-    void SetNextUser(User *user) { next_user_ = user; }
+    User *GetPrevUser() const { return prev_user_; }
 
   private:
-    Instruction *const user_inst_;
-    const uint32_t input_idx_;
+    friend class Graph;
+    friend class Instruction;
+
+    Instruction *user_inst_;
+    uint32_t input_idx_;
+    Instruction *def_ = nullptr;
+    User *prev_user_ = nullptr;
     User *next_user_ = nullptr;
 };
 
@@ -74,9 +90,10 @@ class Instruction {
     Type GetType() const { return type_; }
     uint32_t GetId() const { return id_; }
     void SetId(uint32_t id) { id_ = id; }
+    Graph *GetGraph() const { return graph_; }
     BasicBlock *GetBasicBlock() const { return basic_block_; }
     void SetBasicBlock(BasicBlock *bb) { basic_block_ = bb; }
-    const std::vector<Instruction *> &GetInputs() const { return inputs_; }
+    const InputList &GetInputs() const { return inputs_; }
     User *GetFirstUser() const { return head_user_; }
 
     Instruction *GetNext() const { return next_; }
@@ -89,10 +106,18 @@ class Instruction {
     void ReplaceAllUsesWith(Instruction *other_inst);
     virtual Instruction *Clone(Graph *target_graph, const InstMapping &mapping) const = 0;
 
-    void ClearInputs() { inputs_.clear(); }
-    void AddInput(Instruction *input) { inputs_.push_back(input); }
-    void ResizeInputs(size_t new_size) { inputs_.resize(new_size); }
-    void SetInput(size_t idx, Instruction *inst) { inputs_[idx] = inst; }
+    // Input setters keep use-lists in sync: a registered use edge is moved to the new
+    // input (or released back to the graph when the slot is cleared).
+    void ClearInputs();
+    void AddInput(Instruction *input) {
+        inputs_.push_back(input);
+        input_users_.push_back(nullptr);
+    }
+    void ResizeInputs(size_t new_size);
+    void SetInput(size_t idx, Instruction *inst);
+    // Drops input `idx`; the inputs after it move down by one, keeping their use edges.
+    void RemoveInput(size_t idx);
+    User *GetInputUser(size_t idx) const { return idx < input_users_.size() ? input_users_[idx] : nullptr; }
 
   protected:
     Instruction(Opcode opcode, Type type, uint32_t id) : opcode_(opcode), type_(type), id_(id) {}
@@ -102,16 +127,24 @@ class Instruction {
     uint32_t id_;
     Location location_;
 
+    Graph *graph_ = nullptr;
     BasicBlock *basic_block_ = nullptr;
+    uint32_t order_ = 0; // position index inside basic_block_, see BasicBlock::IsBefore
+
     Instruction *prev_ = nullptr;
     Instruction *next_ = nullptr;
-    std::vector<Instruction *> inputs_;
+    InputList inputs_;
+    SmallVector<User *, INLINE_INPUTS> input_users_;
     User *head_user_ = nullptr;
 
   private:
     Instruction(const Instruction &) = delete;
     Instruction &operator=(const Instruction &) = delete;
 
+    void LinkUser(User *user);
+    void UnlinkUser(User *user);
+    void ReleaseInputUser(size_t idx);
+
     friend class BasicBlock;
     friend class IRBuilder;
     friend class PhiInst;
@@ -252,10 +285,31 @@ class StoreInst : public Instruction {
     Instruction *Clone(Graph *target_graph, const InstMapping &mapping) const override;
 };
 
+// Exchanges the contents of the locations of its two inputs, and stands for the first input, now in
+// the location of the second. The second input, now in the location of the first, is named by a
+// SwapInst that has the exchange as its only input and emits no code.
+class SwapInst : public Instruction {
+  public:
+    SwapInst(uint32_t id, Type type, Instruction *first, Instruction *second) : Instruction(Opcode::SWAP, type, id) {
+        AddInput(first);
+        AddInput(second);
+    }
+    SwapInst(uint32_t id, Type type, Instruction *exchange) : Instruction(Opcode::SWAP, type, id) {
+        AddInput(exchange);
+    }
+
+    bool IsSecondHalf() const { return GetInputs().size() == 1; }
+
+    void Print(std::ostream &os) const override;
+    Instruction *Clone(Graph *target_graph, const InstMapping &mapping) const override;
+};
+
 class CallStaticInst : public Instruction {
   public:
     CallStaticInst(uint32_t id, Graph *callee, const std::vector<Instruction *> &args)
         : Instruction(Opcode::CALL_STATIC, Type::VOID, id), callee_(callee) {
+        inputs_.reserve(args.size());
+        input_users_.reserve(args.size());
         for (auto *arg : args) {
             AddInput(arg);
         }
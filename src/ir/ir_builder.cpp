@@ -21,10 +21,7 @@ template <typename InstType, typename... Args> InstType *IRBuilder::CreateInstru
         throw std::runtime_error("Insert point not set in IRBuilder");
     }
 
-    auto inst_ptr = std::make_unique<InstType>(graph_->next_inst_id_++, std::forward<Args>(args)...);
-
-    auto *raw_ptr = inst_ptr.get();
-    graph_->instructions_.push_back(std::move(inst_ptr));
+    auto *raw_ptr = graph_->NewInstruction<InstType>(std::forward<Args>(args)...);
 
     if (insert_before_) {
         insert_bb_->InsertBefore(raw_ptr, insert_before_);
@@ -88,9 +85,7 @@ ReturnInst *IRBuilder::CreateRet(Instruction *value) { return CreateInstruction<
 ArgumentInst *IRBuilder::CreateArgument(Type type) {
     if (!graph_)
         throw std::runtime_error("Graph is not set");
-    auto arg_ptr = std::make_unique<ArgumentInst>(graph_->next_inst_id_++, type);
-    auto *raw_ptr = arg_ptr.get();
-    graph_->instructions_.push_back(std::move(arg_ptr));
+    auto *raw_ptr = graph_->NewInstruction<ArgumentInst>(type);
     graph_->args_.push_back(raw_ptr);
     return raw_ptr;
 }
@@ -101,9 +96,7 @@ PhiInst *IRBuilder::CreatePhi(Type type) {
     if (!insert_bb_) {
         throw std::runtime_error("Insert point not set in IRBuilder for Phi");
     }
-    auto phi_ptr = std::make_unique<PhiInst>(graph_->next_inst_id_++, type);
-    auto *raw_ptr = phi_ptr.get();
-    graph_->instructions_.push_back(std::move(phi_ptr));
+    auto *raw_ptr = graph_->NewInstruction<PhiInst>(type);
 
     raw_ptr->basic_block_ = insert_bb_;
     auto *first_inst = insert_bb_->first_inst_;
@@ -114,6 +107,7 @@ PhiInst *IRBuilder::CreatePhi(Type type) {
         raw_ptr->next_ = first_inst;
         first_inst->prev_ = raw_ptr;
         insert_bb_->first_inst_ = raw_ptr;
+        insert_bb_->InvalidateInstructionOrder();
     }
 
     return raw_ptr;
@@ -127,6 +121,14 @@ StoreInst *IRBuilder::CreateStore(Type type, Instruction *value, Instruction *to
     return CreateInstruction<StoreInst>(type, value, to);
 }
 
+SwapInst *IRBuilder::CreateSwap(Type type, Instruction *first, Instruction *second) {
+    return CreateInstruction<SwapInst>(type, first, second);
+}
+
+SwapInst *IRBuilder::CreateSwapSecondHalf(Type type, SwapInst *exchange) {
+    return CreateInstruction<SwapInst>(type, static_cast<Instruction *>(exchange));
+}
+
 CallStaticInst *IRBuilder::CreateCallStatic(Graph *callee, const std::vector<Instruction *> &args) {
     return CreateInstruction<CallStaticInst>(callee, args);
 }
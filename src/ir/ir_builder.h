@@ -18,6 +18,7 @@ class ReturnInst;
 class MoveInst;
 class LoadInst;
 class StoreInst;
+class SwapInst;
 class CallStaticInst;
 
 class IRBuilder {
@@ -47,6 +48,9 @@ class IRBuilder {
     MoveInst *CreateMove(Type type, Instruction *from);
     LoadInst *CreateLoad(Type type, Instruction *from);
     StoreInst *CreateStore(Type type, Instruction *value, Instruction *to);
+    SwapInst *CreateSwap(Type type, Instruction *first, Instruction *second);
+    // Names the second input of `exchange` in its new location.
+    SwapInst *CreateSwapSecondHalf(Type type, SwapInst *exchange);
 
     CallStaticInst *CreateCallStatic(Graph *callee, const std::vector<Instruction *> &args);
 
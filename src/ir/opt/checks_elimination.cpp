@@ -1,4 +1,5 @@
 #include "ir/opt/checks_elimination.h"
+#include "ir/analysis/analysis_manager.h"
 #include "ir/analysis/graph_analyzer.h"
 #include "ir/basic_block.h"
 #include "ir/instruction.h"
@@ -11,6 +12,8 @@ namespace opt {
 void ChecksElimination::Run() {
     EliminateDominatedChecks();
     EliminateRedundantBoundsChecks();
+    // Only checks have been erased so far; the CFG is untouched.
+    graph_->GetAnalyses().KeepOnly(AnalysisSet::ControlFlow());
     EliminateMustThrowChecks();
 }
 
@@ -55,20 +58,20 @@ void ChecksElimination::EliminateMustThrowChecks() {
         Instruction *curr = inst;
         while (curr != nullptr) {
             Instruction *next = curr->GetNext();
-            bb->RemoveInstruction(curr);
+            bb->EraseInstruction(curr);
             curr = next;
         }
 
         bb->ClearSuccessors();
     }
+    if (!must_throw.empty()) {
+        graph_->GetAnalyses().InvalidateAll();
+    }
 }
 
 void ChecksElimination::EliminateRedundantBoundsChecks() {
-    LoopAnalyzer loop_analyzer(graph_);
-    loop_analyzer.Analyze();
-
-    analysis::BoundsAnalysis bounds_analysis(graph_);
-    bounds_analysis.Run(&loop_analyzer);
+    LoopAnalyzer &loop_analyzer = graph_->GetAnalyses().GetLoopAnalyzer();
+    analysis::BoundsAnalysis &bounds_analysis = graph_->GetAnalyses().GetBoundsAnalysis();
 
     std::unordered_set<Instruction *> to_remove;
 
@@ -136,14 +139,13 @@ void ChecksElimination::EliminateRedundantBoundsChecks() {
 
     for (Instruction *inst : to_remove) {
         if (inst->GetBasicBlock() != nullptr) {
-            inst->GetBasicBlock()->RemoveInstruction(inst);
+            inst->GetBasicBlock()->EraseInstruction(inst);
         }
     }
 }
 
 void ChecksElimination::EliminateDominatedChecks() {
-    GraphAnalyzer analyzer(graph_);
-    analyzer.BuildDominatorTree();
+    const GraphAnalyzer &analyzer = graph_->GetAnalyses().GetGraphAnalyzer();
 
     const auto &rpo = analyzer.GetReversePostOrder();
 
@@ -196,7 +198,7 @@ void ChecksElimination::EliminateDominatedChecks() {
 
     for (Instruction *inst : to_remove) {
         if (inst->GetBasicBlock() != nullptr) {
-            inst->GetBasicBlock()->RemoveInstruction(inst);
+            inst->GetBasicBlock()->EraseInstruction(inst);
         }
     }
 }
@@ -209,13 +211,7 @@ bool ChecksElimination::Dominates(Instruction *dom, Instruction *inst, const Gra
         return analyzer.Dominates(dom_bb, inst_bb);
     }
 
-    for (Instruction *curr = dom->GetNext(); curr != nullptr; curr = curr->GetNext()) {
-        if (curr == inst) {
-            return true;
-        }
-    }
-
-    return false;
+    return dom_bb->IsBefore(dom, inst);
 }
 
 } // namespace opt
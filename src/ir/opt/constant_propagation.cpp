@@ -0,0 +1,299 @@
+#include "ir/opt/constant_propagation.h"
+#include "ir/analysis/analysis_manager.h"
+#include "ir/basic_block.h"
+#include "ir/instruction.h"
+#include "ir/ir_builder.h"
+
+namespace opt {
+
+static int64_t SignExtend(uint64_t value, Type type) {
+    uint32_t bits = GetTypeSize(type) * 8;
+    if (bits == 0 || bits >= 64) {
+        return static_cast<int64_t>(value);
+    }
+    uint32_t shift = 64 - bits;
+    return static_cast<int64_t>(value << shift) >> shift;
+}
+
+static bool Compare(ConditionCode cc, uint64_t lhs, uint64_t rhs, Type type) {
+    int64_t slhs = SignExtend(lhs, type);
+    int64_t srhs = SignExtend(rhs, type);
+    switch (cc) {
+    case ConditionCode::EQ:
+        return lhs == rhs;
+    case ConditionCode::NE:
+        return lhs != rhs;
+    case ConditionCode::LT:
+        return slhs < srhs;
+    case ConditionCode::GT:
+        return slhs > srhs;
+    case ConditionCode::LE:
+        return slhs <= srhs;
+    case ConditionCode::GE:
+        return slhs >= srhs;
+    case ConditionCode::UGT:
+        return lhs > rhs;
+    case ConditionCode::ULE:
+        return lhs <= rhs;
+    }
+    return false;
+}
+
+ConstantPropagation::Cell ConstantPropagation::Meet(Cell a, Cell b) {
+    if (a.state == Cell::UNDEFINED) {
+        return b;
+    }
+    if (b.state == Cell::UNDEFINED || a == b) {
+        return a;
+    }
+    return {Cell::VARYING, 0};
+}
+
+ConstantPropagation::Cell ConstantPropagation::EvaluatePhi(Instruction *phi) const {
+    const auto &flags = executable_preds_[phi->GetBasicBlock()];
+    const auto &inputs = phi->GetInputs();
+    Cell result;
+    for (size_t i = 0; i < inputs.size() && i < flags.size(); ++i) {
+        if (flags[i] && inputs[i] != nullptr) {
+            result = Meet(result, cells_[inputs[i]]);
+        }
+    }
+    return result;
+}
+
+ConstantPropagation::Cell ConstantPropagation::Evaluate(Instruction *inst) const {
+    Opcode opcode = inst->GetOpcode();
+    if (opcode == Opcode::Constant) {
+        return {Cell::CONSTANT, TruncateToType(static_cast<ConstantInst *>(inst)->GetValue(), inst->GetType())};
+    }
+    if (opcode == Opcode::PHI) {
+        return EvaluatePhi(inst);
+    }
+    if (opcode != Opcode::ADD && opcode != Opcode::MUL && opcode != Opcode::AND && opcode != Opcode::SHL &&
+        opcode != Opcode::CMP && opcode != Opcode::CAST && opcode != Opcode::U32_TO_U64) {
+        return {Cell::VARYING, 0};
+    }
+
+    // Undefined until every input is known; varying as soon as one input is.
+    uint64_t values[2] = {0, 0};
+    const auto &inputs = inst->GetInputs();
+    if (inputs.empty() || inputs.size() > 2) {
+        return {Cell::VARYING, 0};
+    }
+    bool undefined = false;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (inputs[i] == nullptr) {
+            return {Cell::VARYING, 0};
+        }
+        Cell cell = cells_[inputs[i]];
+        if (cell.state == Cell::VARYING) {
+            return cell;
+        }
+        undefined |= cell.state == Cell::UNDEFINED;
+        values[i] = cell.value;
+    }
+    if (undefined) {
+        return {};
+    }
+
+    Type type = inst->GetType();
+    uint64_t result = 0;
+    switch (opcode) {
+    case Opcode::ADD:
+        result = values[0] + values[1];
+        break;
+    case Opcode::MUL:
+        result = values[0] * values[1];
+        break;
+    case Opcode::AND:
+        result = values[0] & values[1];
+        break;
+    case Opcode::SHL:
+        result = values[1] >= 64 ? 0 : values[0] << values[1];
+        break;
+    case Opcode::CMP:
+        result = Compare(static_cast<CompareInst *>(inst)->GetCC(), values[0], values[1], inputs[0]->GetType());
+        break;
+    case Opcode::CAST:
+        result = FoldCastValue(values[0], inputs[0]->GetType(), type);
+        break;
+    default:
+        result = values[0];
+        break;
+    }
+    return {Cell::CONSTANT, TruncateToType(result, type)};
+}
+
+void ConstantPropagation::MarkEdge(BasicBlock *from, BasicBlock *to) {
+    const auto &preds = to->GetPredecessors();
+    auto &flags = executable_preds_[to];
+    flags.resize(preds.size(), 0);
+    bool marked = false;
+    for (size_t i = 0; i < preds.size(); ++i) {
+        if (preds[i] == from && !flags[i]) {
+            flags[i] = 1;
+            marked = true;
+        }
+    }
+    if (marked) {
+        edge_worklist_.emplace_back(from, to);
+    }
+}
+
+void ConstantPropagation::VisitTerminator(Instruction *inst) {
+    BasicBlock *bb = inst->GetBasicBlock();
+    if (inst->GetOpcode() == Opcode::JUMP) {
+        MarkEdge(bb, static_cast<JumpInst *>(inst)->GetTarget());
+        return;
+    }
+    if (inst->GetOpcode() != Opcode::JA) {
+        return;
+    }
+    auto *branch = static_cast<BranchInst *>(inst);
+    Cell cond = cells_[branch->GetInputs()[0]];
+    if (cond.state == Cell::CONSTANT) {
+        MarkEdge(bb, cond.value != 0 ? branch->GetTrueBB() : branch->GetFalseBB());
+    } else if (cond.state == Cell::VARYING) {
+        MarkEdge(bb, branch->GetTrueBB());
+        MarkEdge(bb, branch->GetFalseBB());
+    }
+}
+
+void ConstantPropagation::Visit(Instruction *inst) {
+    if (inst->GetOpcode() == Opcode::JUMP || inst->GetOpcode() == Opcode::JA) {
+        VisitTerminator(inst);
+        return;
+    }
+    Cell cell = Meet(cells_[inst], Evaluate(inst));
+    if (cell == cells_[inst]) {
+        return;
+    }
+    cells_[inst] = cell;
+    for (auto *user = inst->GetFirstUser(); user != nullptr; user = user->GetNextUser()) {
+        value_worklist_.push_back(user->GetUserInstruction());
+    }
+}
+
+void ConstantPropagation::Propagate() {
+    while (!edge_worklist_.empty() || !value_worklist_.empty()) {
+        while (!edge_worklist_.empty()) {
+            auto [from, to] = edge_worklist_.back();
+            edge_worklist_.pop_back();
+            // A block already visited only has to merge the new edge into its phis.
+            bool first_visit = !executable_[to];
+            executable_[to] = 1;
+            for (auto *inst = to->GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
+                if (!first_visit && inst->GetOpcode() != Opcode::PHI) {
+                    break;
+                }
+                Visit(inst);
+            }
+        }
+        while (!value_worklist_.empty()) {
+            Instruction *inst = value_worklist_.back();
+            value_worklist_.pop_back();
+            if (inst->GetBasicBlock() != nullptr && executable_[inst->GetBasicBlock()]) {
+                Visit(inst);
+            }
+        }
+    }
+}
+
+void ConstantPropagation::Run() {
+    num_folded_values_ = num_folded_branches_ = num_removed_blocks_ = 0;
+    BasicBlock *start = graph_->GetStartBlock();
+    if (start == nullptr) {
+        return;
+    }
+    cells_.Reset(graph_->GetInstIdLimit(), Cell{});
+    executable_.Reset(graph_->GetBlockIdLimit(), 0);
+    executable_preds_.Reset(graph_->GetBlockIdLimit(), {});
+    for (auto *arg : graph_->GetArguments()) {
+        cells_[arg] = {Cell::VARYING, 0};
+    }
+
+    executable_[start] = 1;
+    for (auto *inst = start->GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
+        Visit(inst);
+    }
+    Propagate();
+
+    ReplaceConstants();
+    FoldBranches();
+    RemoveDeadBlocks();
+
+    if (num_folded_branches_ != 0 || num_removed_blocks_ != 0) {
+        graph_->GetAnalyses().InvalidateAll();
+    } else {
+        graph_->GetAnalyses().KeepOnly(AnalysisSet::ControlFlow());
+    }
+}
+
+// Constants for phis go after the last phi, the others take the place of the folded instruction.
+void ConstantPropagation::ReplaceConstants() {
+    IRBuilder builder(graph_);
+    for (auto &bb : graph_->GetBlocks()) {
+        if (!executable_[&bb]) {
+            continue;
+        }
+        Instruction *next = nullptr;
+        for (auto *inst = bb.GetFirstInstruction(); inst != nullptr; inst = next) {
+            next = inst->GetNext();
+            Cell cell = cells_[inst];
+            if (cell.state != Cell::CONSTANT || inst->GetOpcode() == Opcode::Constant) {
+                continue;
+            }
+            Instruction *insert_point = inst;
+            while (insert_point != nullptr && insert_point->GetOpcode() == Opcode::PHI) {
+                insert_point = insert_point->GetNext();
+            }
+            if (insert_point != nullptr) {
+                builder.SetInsertPoint(insert_point);
+            } else {
+                builder.SetInsertPoint(&bb);
+            }
+            auto *constant = builder.CreateConstant(inst->GetType(), cell.value);
+            cells_[constant] = cell;
+            inst->ReplaceAllUsesWith(constant);
+            bb.EraseInstruction(inst);
+            graph_->DeleteInstruction(inst);
+            ++num_folded_values_;
+        }
+    }
+}
+
+void ConstantPropagation::FoldBranches() {
+    for (auto &bb : graph_->GetBlocks()) {
+        auto *last = bb.GetLastInstruction();
+        if (!executable_[&bb] || last == nullptr || last->GetOpcode() != Opcode::JA) {
+            continue;
+        }
+        auto *branch = static_cast<BranchInst *>(last);
+        Cell cond = cells_[branch->GetInputs()[0]];
+        if (cond.state != Cell::CONSTANT) {
+            continue;
+        }
+        BasicBlock *taken = cond.value != 0 ? branch->GetTrueBB() : branch->GetFalseBB();
+        BasicBlock *not_taken = cond.value != 0 ? branch->GetFalseBB() : branch->GetTrueBB();
+        // With both targets equal this drops the duplicate edge, leaving one for the jump.
+        bb.RemoveSuccessor(not_taken);
+        bb.EraseInstruction(branch);
+        graph_->DeleteInstruction(branch);
+        bb.PushBackInstruction(graph_->NewInstruction<JumpInst>(taken));
+        ++num_folded_branches_;
+    }
+}
+
+void ConstantPropagation::RemoveDeadBlocks() {
+    auto &blocks = graph_->GetBlocks();
+    for (auto it = blocks.begin(); it != blocks.end();) {
+        if (executable_[&*it]) {
+            ++it;
+            continue;
+        }
+        it = graph_->RemoveBasicBlock(it);
+        ++num_removed_blocks_;
+    }
+}
+
+} // namespace opt
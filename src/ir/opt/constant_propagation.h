@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ir/analysis/side_table.h"
+#include "ir/graph.h"
+#include "ir/instruction.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace opt {
+
+// Sparse conditional constant propagation (Wegman and Zadeck). Every value starts out undefined
+// and is lowered to a constant or to "varying" as the blocks that compute it become executable;
+// phis only meet the values of incoming edges already found executable, and a branch on a
+// constant only makes its taken edge executable. At the fixed point, values found constant are
+// replaced by constants, such branches become jumps, and blocks that never became executable are
+// deleted together with their entries in the phis of the blocks that stay.
+class ConstantPropagation {
+  public:
+    explicit ConstantPropagation(Graph *graph) : graph_(graph) {}
+
+    void Run();
+
+    // Results of the last Run.
+    uint32_t GetNumFoldedValues() const { return num_folded_values_; }
+    uint32_t GetNumFoldedBranches() const { return num_folded_branches_; }
+    uint32_t GetNumRemovedBlocks() const { return num_removed_blocks_; }
+
+  private:
+    struct Cell {
+        enum State : uint8_t { UNDEFINED, CONSTANT, VARYING };
+        State state = UNDEFINED;
+        uint64_t value = 0;
+
+        bool operator==(const Cell &other) const = default;
+    };
+
+    static Cell Meet(Cell a, Cell b);
+    Cell Evaluate(Instruction *inst) const;
+    Cell EvaluatePhi(Instruction *phi) const;
+
+    void MarkEdge(BasicBlock *from, BasicBlock *to);
+    void Visit(Instruction *inst);
+    void VisitTerminator(Instruction *inst);
+    void Propagate();
+
+    void ReplaceConstants();
+    void FoldBranches();
+    void RemoveDeadBlocks();
+
+    Graph *graph_;
+    InstMap<Cell> cells_;
+    BlockMap<uint8_t> executable_;
+    // Per block, whether the edge from each predecessor (by index) is executable.
+    BlockMap<std::vector<uint8_t>> executable_preds_;
+    std::vector<std::pair<BasicBlock *, BasicBlock *>> edge_worklist_;
+    std::vector<Instruction *> value_worklist_;
+
+    uint32_t num_folded_values_ = 0;
+    uint32_t num_folded_branches_ = 0;
+    uint32_t num_removed_blocks_ = 0;
+};
+
+} // namespace opt
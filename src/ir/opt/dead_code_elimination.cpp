@@ -0,0 +1,132 @@
+#include "ir/opt/dead_code_elimination.h"
+#include "ir/analysis/analysis_manager.h"
+#include "ir/basic_block.h"
+#include "ir/instruction.h"
+
+namespace opt {
+
+void DeadCodeElimination::Run() {
+    num_removed_phis_ = 0;
+    num_removed_ = 0;
+    RemoveTrivialPhis();
+    Mark();
+    Sweep();
+    // Only instructions were removed; the CFG is untouched.
+    graph_->GetAnalyses().KeepOnly(AnalysisSet::ControlFlow());
+}
+
+bool DeadCodeElimination::HasSideEffects(const Instruction *inst) {
+    switch (inst->GetOpcode()) {
+    case Opcode::RET:
+    case Opcode::JUMP:
+    case Opcode::JA:
+    case Opcode::STORE:
+    case Opcode::CALL_STATIC:
+    case Opcode::NULL_CHECK:
+    case Opcode::BOUNDS_CHECK:
+    case Opcode::DEOPTIMIZE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The single value a phi merges besides itself, or nullptr if it merges more than one.
+Instruction *DeadCodeElimination::GetTrivialPhiValue(const Instruction *phi) {
+    Instruction *value = nullptr;
+    for (auto *input : phi->GetInputs()) {
+        if (input == phi || input == value) {
+            continue;
+        }
+        if (value != nullptr || input == nullptr) {
+            return nullptr;
+        }
+        value = input;
+    }
+    return value;
+}
+
+// Replacing a phi can make the phis that use it trivial in turn, so those are looked at again.
+// Removed phis are destroyed only at the end, as the worklist may still name them.
+void DeadCodeElimination::RemoveTrivialPhis() {
+    std::vector<Instruction *> worklist;
+    std::vector<Instruction *> removed;
+    for (auto &bb : graph_->GetBlocks()) {
+        for (auto *inst = bb.GetFirstInstruction(); inst != nullptr && inst->GetOpcode() == Opcode::PHI;
+             inst = inst->GetNext()) {
+            worklist.push_back(inst);
+        }
+    }
+
+    while (!worklist.empty()) {
+        Instruction *phi = worklist.back();
+        worklist.pop_back();
+        // Already removed through an earlier entry.
+        if (phi->GetBasicBlock() == nullptr) {
+            continue;
+        }
+        Instruction *value = GetTrivialPhiValue(phi);
+        if (value == nullptr) {
+            continue;
+        }
+        for (auto *user = phi->GetFirstUser(); user != nullptr; user = user->GetNextUser()) {
+            auto *user_inst = user->GetUserInstruction();
+            if (user_inst != phi && user_inst->GetOpcode() == Opcode::PHI) {
+                worklist.push_back(user_inst);
+            }
+        }
+        phi->GetBasicBlock()->EraseInstruction(phi);
+        phi->ReplaceAllUsesWith(value);
+        removed.push_back(phi);
+    }
+
+    for (auto *phi : removed) {
+        graph_->DeleteInstruction(phi);
+    }
+    num_removed_phis_ = static_cast<uint32_t>(removed.size());
+}
+
+void DeadCodeElimination::Mark() {
+    live_.Reset(graph_->GetInstIdLimit(), 0);
+    std::vector<Instruction *> worklist;
+    for (auto &bb : graph_->GetBlocks()) {
+        for (auto *inst = bb.GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
+            if (HasSideEffects(inst)) {
+                live_[inst] = 1;
+                worklist.push_back(inst);
+            }
+        }
+    }
+
+    while (!worklist.empty()) {
+        Instruction *inst = worklist.back();
+        worklist.pop_back();
+        for (auto *input : inst->GetInputs()) {
+            if (input != nullptr && !live_[input]) {
+                live_[input] = 1;
+                worklist.push_back(input);
+            }
+        }
+    }
+}
+
+// Dead instructions may use each other, so all of them drop their inputs before any is destroyed.
+void DeadCodeElimination::Sweep() {
+    std::vector<Instruction *> dead;
+    for (auto &bb : graph_->GetBlocks()) {
+        Instruction *next = nullptr;
+        for (auto *inst = bb.GetFirstInstruction(); inst != nullptr; inst = next) {
+            next = inst->GetNext();
+            if (!live_[inst]) {
+                bb.EraseInstruction(inst);
+                dead.push_back(inst);
+            }
+        }
+    }
+    for (auto *inst : dead) {
+        graph_->DeleteInstruction(inst);
+    }
+    num_removed_ = static_cast<uint32_t>(dead.size());
+}
+
+} // namespace opt
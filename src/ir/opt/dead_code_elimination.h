@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ir/analysis/side_table.h"
+#include "ir/graph.h"
+#include "ir/instruction.h"
+#include <cstdint>
+#include <vector>
+
+namespace opt {
+
+// Deletes instructions whose results cannot reach anything observable. Phis that only merge one
+// value (or themselves) are replaced by that value first. Then every instruction with an effect
+// beyond its result (returns, stores, calls, checks, deoptimization and branches) is marked live,
+// along with everything it transitively reads; the rest is erased from its block and destroyed.
+class DeadCodeElimination {
+  public:
+    explicit DeadCodeElimination(Graph *graph) : graph_(graph) {}
+
+    void Run();
+
+    // Results of the last Run; the removed phis are not part of the removed instructions.
+    uint32_t GetNumRemovedPhis() const { return num_removed_phis_; }
+    uint32_t GetNumRemoved() const { return num_removed_; }
+
+  private:
+    static bool HasSideEffects(const Instruction *inst);
+    static Instruction *GetTrivialPhiValue(const Instruction *phi);
+
+    void RemoveTrivialPhis();
+    void Mark();
+    void Sweep();
+
+    Graph *graph_;
+    InstMap<uint8_t> live_;
+    uint32_t num_removed_phis_ = 0;
+    uint32_t num_removed_ = 0;
+};
+
+} // namespace opt
@@ -0,0 +1,122 @@
+#include "ir/opt/global_value_numbering.h"
+#include "ir/analysis/analysis_manager.h"
+#include "ir/analysis/graph_analyzer.h"
+#include "ir/basic_block.h"
+#include "ir/instruction.h"
+
+#include <functional>
+#include <utility>
+
+namespace opt {
+
+static constexpr uint32_t NO_INPUT = UINT32_MAX;
+
+size_t GlobalValueNumbering::ValueKeyHash::operator()(const ValueKey &key) const {
+    size_t hash = std::hash<uint64_t>{}(key.extra);
+    for (uint64_t part : {static_cast<uint64_t>(key.opcode), static_cast<uint64_t>(key.type),
+                          (uint64_t{key.lhs} << 32) | key.rhs}) {
+        hash ^= std::hash<uint64_t>{}(part) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+// Only opcodes without side effects whose result depends on nothing but the key are numbered.
+// Operands of commutative opcodes are ordered, so that `a + b` and `b + a` get the same key.
+bool GlobalValueNumbering::MakeKey(const Instruction *inst, ValueKey *key) {
+    *key = {inst->GetOpcode(), inst->GetType(), 0, NO_INPUT, NO_INPUT};
+    switch (inst->GetOpcode()) {
+    case Opcode::Constant:
+        key->extra = static_cast<const ConstantInst *>(inst)->GetValue();
+        return true;
+    case Opcode::CMP:
+        key->extra = static_cast<uint64_t>(static_cast<const CompareInst *>(inst)->GetCC());
+        break;
+    case Opcode::ADD:
+    case Opcode::MUL:
+    case Opcode::AND:
+    case Opcode::SHL:
+    case Opcode::CAST:
+    case Opcode::U32_TO_U64:
+        break;
+    default:
+        return false;
+    }
+
+    const auto &inputs = inst->GetInputs();
+    if (inputs.empty() || inputs.size() > 2) {
+        return false;
+    }
+    for (auto *input : inputs) {
+        if (input == nullptr) {
+            return false;
+        }
+    }
+    key->lhs = inputs[0]->GetId();
+    if (inputs.size() == 2) {
+        key->rhs = inputs[1]->GetId();
+    }
+    auto opcode = inst->GetOpcode();
+    if ((opcode == Opcode::ADD || opcode == Opcode::MUL || opcode == Opcode::AND) && key->lhs > key->rhs) {
+        std::swap(key->lhs, key->rhs);
+    }
+    return true;
+}
+
+// Walks the dominator tree depth-first; the keys a block adds are dropped again when the walk
+// leaves it, so that only the values of dominating blocks are available.
+void GlobalValueNumbering::Run() {
+    num_removed_ = 0;
+    available_.clear();
+    const GraphAnalyzer &analyzer = graph_->GetAnalyses().GetGraphAnalyzer();
+    if (analyzer.GetReversePostOrder().empty()) {
+        return;
+    }
+
+    struct Frame {
+        BasicBlock *block;
+        size_t next_child;
+        std::vector<ValueKey> scope;
+    };
+    std::vector<Frame> stack;
+    stack.push_back({analyzer.GetReversePostOrder().front(), 0, {}});
+    NumberBlock(stack.back().block, stack.back().scope);
+    while (!stack.empty()) {
+        Frame &frame = stack.back();
+        const auto &children = analyzer.GetDominatedChildren(frame.block);
+        if (frame.next_child < children.size()) {
+            BasicBlock *child = children[frame.next_child++];
+            stack.push_back({child, 0, {}});
+            NumberBlock(child, stack.back().scope);
+            continue;
+        }
+        for (const auto &key : frame.scope) {
+            available_.erase(key);
+        }
+        stack.pop_back();
+    }
+
+    // Only instructions were erased; the CFG is untouched.
+    graph_->GetAnalyses().KeepOnly(AnalysisSet::ControlFlow());
+}
+
+void GlobalValueNumbering::NumberBlock(BasicBlock *block, std::vector<ValueKey> &scope) {
+    Instruction *next = nullptr;
+    for (auto *inst = block->GetFirstInstruction(); inst != nullptr; inst = next) {
+        next = inst->GetNext();
+        ValueKey key;
+        if (!MakeKey(inst, &key)) {
+            continue;
+        }
+        auto [it, inserted] = available_.try_emplace(key, inst);
+        if (inserted) {
+            scope.push_back(key);
+            continue;
+        }
+        inst->ReplaceAllUsesWith(it->second);
+        block->EraseInstruction(inst);
+        graph_->DeleteInstruction(inst);
+        ++num_removed_;
+    }
+}
+
+} // namespace opt
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ir/graph.h"
+#include "ir/instruction.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace opt {
+
+// Removes pure computations that repeat one which dominates them: constants, arithmetic, compares
+// and casts of the same inputs. Blocks are visited along the dominator tree with a scoped table of
+// the values available in each block, keyed by opcode, type, condition or constant and the inputs,
+// so a value is only reused where its definition dominates. Redundant instructions are replaced by
+// the earlier one in all their uses and erased.
+class GlobalValueNumbering {
+  public:
+    explicit GlobalValueNumbering(Graph *graph) : graph_(graph) {}
+
+    void Run();
+
+    // Instructions erased by the last Run.
+    uint32_t GetNumRemoved() const { return num_removed_; }
+
+  private:
+    struct ValueKey {
+        Opcode opcode;
+        Type type;
+        // The value of a constant, or the condition code of a compare.
+        uint64_t extra;
+        uint32_t lhs;
+        uint32_t rhs;
+
+        bool operator==(const ValueKey &other) const = default;
+    };
+
+    struct ValueKeyHash {
+        size_t operator()(const ValueKey &key) const;
+    };
+
+    static bool MakeKey(const Instruction *inst, ValueKey *key);
+    void NumberBlock(BasicBlock *block, std::vector<ValueKey> &scope);
+
+    Graph *graph_;
+    uint32_t num_removed_ = 0;
+    std::unordered_map<ValueKey, Instruction *, ValueKeyHash> available_;
+};
+
+} // namespace opt
@@ -0,0 +1,324 @@
+#include "ir/opt/graph_coloring.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace opt {
+
+GraphColoring::GraphColoring(uint32_t num_nodes)
+    : num_nodes_(num_nodes), adj_lists_(num_nodes), degrees_(num_nodes, 0), spill_costs_(num_nodes, 1.0),
+      states_(num_nodes, NodeState::INITIAL), aliases_(num_nodes), colors_(num_nodes, SPILLED),
+      node_moves_(num_nodes), seen_(num_nodes, 0) {
+    if (num_nodes <= MATRIX_NODE_LIMIT) {
+        adj_set_.Resize(size_t{num_nodes} * num_nodes);
+    }
+    std::iota(aliases_.begin(), aliases_.end(), 0);
+}
+
+void GraphColoring::AddInterference(uint32_t a, uint32_t b) { AddEdge(a, b); }
+
+void GraphColoring::AddMove(uint32_t a, uint32_t b) {
+    if (a == b) {
+        return;
+    }
+    auto move = static_cast<uint32_t>(moves_.size());
+    moves_.push_back({a, b, MoveState::WORKLIST});
+    node_moves_[a].push_back(move);
+    node_moves_[b].push_back(move);
+    move_worklist_.push_back(move);
+}
+
+bool GraphColoring::Interfere(uint32_t a, uint32_t b) const {
+    if (num_nodes_ <= MATRIX_NODE_LIMIT) {
+        return adj_set_.Test(size_t{a} * num_nodes_ + b);
+    }
+    return adj_hash_.count(EdgeKey(a, b)) != 0;
+}
+
+void GraphColoring::AddEdge(uint32_t a, uint32_t b) {
+    if (a == b) {
+        return;
+    }
+    if (num_nodes_ <= MATRIX_NODE_LIMIT) {
+        if (Interfere(a, b)) {
+            return;
+        }
+        adj_set_.Set(size_t{a} * num_nodes_ + b);
+        adj_set_.Set(size_t{b} * num_nodes_ + a);
+    } else if (!adj_hash_.insert(EdgeKey(a, b)).second) {
+        return;
+    }
+    adj_lists_[a].push_back(b);
+    adj_lists_[b].push_back(a);
+    ++degrees_[a];
+    ++degrees_[b];
+}
+
+// Nodes on the select stack and nodes merged into another are no longer part of the graph.
+bool GraphColoring::IsRemoved(uint32_t node) const {
+    return states_[node] == NodeState::SELECTED || states_[node] == NodeState::COALESCED;
+}
+
+bool GraphColoring::IsMoveRelated(uint32_t node) const {
+    for (uint32_t move : node_moves_[node]) {
+        if (moves_[move].state == MoveState::WORKLIST || moves_[move].state == MoveState::ACTIVE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t GraphColoring::GetAlias(uint32_t node) const {
+    while (states_[node] == NodeState::COALESCED) {
+        node = aliases_[node];
+    }
+    return node;
+}
+
+void GraphColoring::PushNode(uint32_t node, NodeState state) {
+    states_[node] = state;
+    switch (state) {
+    case NodeState::SIMPLIFY:
+        simplify_worklist_.push_back(node);
+        break;
+    case NodeState::FREEZE:
+        freeze_worklist_.push_back(node);
+        break;
+    case NodeState::SPILL:
+        spill_worklist_.push_back(node);
+        break;
+    default:
+        break;
+    }
+}
+
+void GraphColoring::MakeWorklists() {
+    for (uint32_t node = 0; node < num_nodes_; ++node) {
+        if (degrees_[node] >= num_colors_) {
+            PushNode(node, NodeState::SPILL);
+        } else if (IsMoveRelated(node)) {
+            PushNode(node, NodeState::FREEZE);
+        } else {
+            PushNode(node, NodeState::SIMPLIFY);
+        }
+    }
+}
+
+bool GraphColoring::Run(uint32_t num_colors) {
+    num_colors_ = num_colors;
+    MakeWorklists();
+
+    // Takes the next node of a worklist that is still in the state of that worklist.
+    auto pop = [this](std::vector<uint32_t> &worklist, NodeState state) {
+        while (!worklist.empty()) {
+            uint32_t node = worklist.back();
+            worklist.pop_back();
+            if (states_[node] == state) {
+                return node;
+            }
+        }
+        return SPILLED;
+    };
+
+    while (true) {
+        if (uint32_t node = pop(simplify_worklist_, NodeState::SIMPLIFY); node != SPILLED) {
+            Simplify(node);
+        } else if (!move_worklist_.empty()) {
+            uint32_t move = move_worklist_.back();
+            move_worklist_.pop_back();
+            if (moves_[move].state == MoveState::WORKLIST) {
+                Coalesce(move);
+            }
+        } else if (uint32_t node = pop(freeze_worklist_, NodeState::FREEZE); node != SPILLED) {
+            Freeze(node);
+        } else if (std::any_of(spill_worklist_.begin(), spill_worklist_.end(),
+                               [this](uint32_t node) { return states_[node] == NodeState::SPILL; })) {
+            SelectSpill();
+        } else {
+            break;
+        }
+    }
+
+    AssignColors();
+    return std::none_of(colors_.begin(), colors_.end(), [](uint32_t color) { return color == SPILLED; });
+}
+
+void GraphColoring::Simplify(uint32_t node) {
+    states_[node] = NodeState::SELECTED;
+    select_stack_.push_back(node);
+    for (uint32_t neighbour : adj_lists_[node]) {
+        if (!IsRemoved(neighbour)) {
+            DecrementDegree(neighbour);
+        }
+    }
+}
+
+// A node that drops below the number of colors can be simplified once its moves are given up; the
+// moves of its neighbours may now pass the coalescing tests.
+void GraphColoring::DecrementDegree(uint32_t node) {
+    if (degrees_[node]-- != num_colors_) {
+        return;
+    }
+    EnableMoves(node);
+    for (uint32_t neighbour : adj_lists_[node]) {
+        if (!IsRemoved(neighbour)) {
+            EnableMoves(neighbour);
+        }
+    }
+    if (states_[node] == NodeState::SPILL) {
+        PushNode(node, IsMoveRelated(node) ? NodeState::FREEZE : NodeState::SIMPLIFY);
+    }
+}
+
+void GraphColoring::EnableMoves(uint32_t node) {
+    for (uint32_t move : node_moves_[node]) {
+        if (moves_[move].state == MoveState::ACTIVE) {
+            moves_[move].state = MoveState::WORKLIST;
+            move_worklist_.push_back(move);
+        }
+    }
+}
+
+void GraphColoring::Coalesce(uint32_t move) {
+    uint32_t u = GetAlias(moves_[move].a);
+    uint32_t v = GetAlias(moves_[move].b);
+    if (u == v) {
+        moves_[move].state = MoveState::COALESCED;
+        ++num_coalesced_moves_;
+        AddToSimplify(u);
+    } else if (Interfere(u, v)) {
+        moves_[move].state = MoveState::CONSTRAINED;
+        AddToSimplify(u);
+        AddToSimplify(v);
+    } else if (BriggsTest(u, v) || GeorgeTest(u, v)) {
+        moves_[move].state = MoveState::COALESCED;
+        ++num_coalesced_moves_;
+        Combine(u, v);
+        AddToSimplify(u);
+    } else {
+        // Tried again once a neighbour's degree drops.
+        moves_[move].state = MoveState::ACTIVE;
+    }
+}
+
+void GraphColoring::AddToSimplify(uint32_t node) {
+    if (states_[node] == NodeState::FREEZE && !IsMoveRelated(node) && degrees_[node] < num_colors_) {
+        PushNode(node, NodeState::SIMPLIFY);
+    }
+}
+
+// Briggs: the merged node has fewer than num_colors neighbours of significant degree, so it will
+// be simplified once its other neighbours are.
+bool GraphColoring::BriggsTest(uint32_t u, uint32_t v) {
+    ++round_;
+    uint32_t significant = 0;
+    for (uint32_t node : {u, v}) {
+        for (uint32_t neighbour : adj_lists_[node]) {
+            if (!IsRemoved(neighbour) && seen_[neighbour] != round_) {
+                seen_[neighbour] = round_;
+                significant += degrees_[neighbour] >= num_colors_;
+            }
+        }
+    }
+    return significant < num_colors_;
+}
+
+// George: every neighbour of `v` is of low degree or already a neighbour of `u`, so merging `v`
+// into `u` adds no constraint that `u` did not have.
+bool GraphColoring::GeorgeTest(uint32_t u, uint32_t v) const {
+    for (uint32_t neighbour : adj_lists_[v]) {
+        if (!IsRemoved(neighbour) && degrees_[neighbour] >= num_colors_ && !Interfere(neighbour, u)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void GraphColoring::Combine(uint32_t u, uint32_t v) {
+    states_[v] = NodeState::COALESCED;
+    aliases_[v] = u;
+    node_moves_[u].insert(node_moves_[u].end(), node_moves_[v].begin(), node_moves_[v].end());
+    spill_costs_[u] += spill_costs_[v];
+    EnableMoves(v);
+    for (uint32_t neighbour : adj_lists_[v]) {
+        if (!IsRemoved(neighbour)) {
+            AddEdge(neighbour, u);
+            DecrementDegree(neighbour);
+        }
+    }
+    if (degrees_[u] >= num_colors_ && states_[u] == NodeState::FREEZE) {
+        PushNode(u, NodeState::SPILL);
+    }
+}
+
+void GraphColoring::Freeze(uint32_t node) {
+    PushNode(node, NodeState::SIMPLIFY);
+    FreezeMoves(node);
+}
+
+void GraphColoring::FreezeMoves(uint32_t node) {
+    for (uint32_t move : node_moves_[node]) {
+        if (moves_[move].state != MoveState::WORKLIST && moves_[move].state != MoveState::ACTIVE) {
+            continue;
+        }
+        uint32_t a = GetAlias(moves_[move].a);
+        uint32_t other = a == GetAlias(node) ? GetAlias(moves_[move].b) : a;
+        moves_[move].state = MoveState::FROZEN;
+        AddToSimplify(other);
+    }
+}
+
+// Chaitin's metric: the cheapest node to spill per neighbour it would stop constraining.
+void GraphColoring::SelectSpill() {
+    uint32_t best = SPILLED;
+    double best_metric = 0;
+    std::erase_if(spill_worklist_, [this](uint32_t node) { return states_[node] != NodeState::SPILL; });
+    for (uint32_t node : spill_worklist_) {
+        double metric = spill_costs_[node] / degrees_[node];
+        if (best == SPILLED || metric < best_metric) {
+            best = node;
+            best_metric = metric;
+        }
+    }
+    PushNode(best, NodeState::SIMPLIFY);
+    FreezeMoves(best);
+}
+
+void GraphColoring::AssignColors() {
+    std::vector<uint8_t> taken(num_colors_);
+    while (!select_stack_.empty()) {
+        uint32_t node = select_stack_.back();
+        select_stack_.pop_back();
+        std::fill(taken.begin(), taken.end(), 0);
+        for (uint32_t neighbour : adj_lists_[node]) {
+            uint32_t alias = GetAlias(neighbour);
+            if (states_[alias] == NodeState::COLORED) {
+                taken[colors_[alias]] = 1;
+            }
+        }
+
+        uint32_t color = SPILLED;
+        for (uint32_t move : node_moves_[node]) {
+            uint32_t a = GetAlias(moves_[move].a);
+            uint32_t other = a == node ? GetAlias(moves_[move].b) : a;
+            if (states_[other] == NodeState::COLORED && !taken[colors_[other]]) {
+                color = colors_[other];
+                break;
+            }
+        }
+        for (uint32_t c = 0; c < num_colors_ && color == SPILLED; ++c) {
+            if (!taken[c]) {
+                color = c;
+            }
+        }
+        colors_[node] = color;
+        states_[node] = color == SPILLED ? NodeState::SPILLED : NodeState::COLORED;
+    }
+    for (uint32_t node = 0; node < num_nodes_; ++node) {
+        if (states_[node] == NodeState::COALESCED) {
+            colors_[node] = colors_[GetAlias(node)];
+        }
+    }
+}
+
+} // namespace opt
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ir/bit_vector.h"
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+namespace opt {
+
+// Colors an interference graph with iterated register coalescing (George and Appel), the
+// Chaitin-Briggs scheme with coalescing folded into its worklists:
+//  - simplify removes a node with fewer neighbours than colors, which can always be colored later;
+//  - coalesce merges the two nodes of a move when the Briggs or George test shows that the merged
+//    node is no harder to color;
+//  - freeze gives up the moves of a low-degree node, so that it can be simplified;
+//  - spill picks the node with the lowest cost per neighbour as a potential spill and removes it.
+// Select then colors the nodes in reverse order of removal, optimistically: a potential spill only
+// ends up spilled if its neighbours have taken all colors. Where it has a choice, a node takes the
+// color of a node it is moved from or to.
+class GraphColoring {
+  public:
+    static constexpr uint32_t SPILLED = UINT32_MAX;
+    // Largest graph whose interference is kept as a bit matrix (2 MB); larger graphs, which are
+    // sparse in practice, hash their edges instead.
+    static constexpr uint32_t MATRIX_NODE_LIMIT = 4096;
+
+    explicit GraphColoring(uint32_t num_nodes);
+
+    void AddInterference(uint32_t a, uint32_t b);
+    // A move between the nodes disappears if they get the same color.
+    void AddMove(uint32_t a, uint32_t b);
+    void SetSpillCost(uint32_t node, double cost) { spill_costs_[node] = cost; }
+
+    // Returns whether all nodes got one of `num_colors` colors.
+    bool Run(uint32_t num_colors);
+
+    // The color of `node` after Run, or SPILLED.
+    uint32_t GetColor(uint32_t node) const { return colors_[node]; }
+    // Moves whose nodes were merged by the last Run.
+    uint32_t GetNumCoalescedMoves() const { return num_coalesced_moves_; }
+
+  private:
+    enum class NodeState : uint8_t { INITIAL, SIMPLIFY, FREEZE, SPILL, COALESCED, SELECTED, COLORED, SPILLED };
+    enum class MoveState : uint8_t { WORKLIST, ACTIVE, COALESCED, CONSTRAINED, FROZEN };
+
+    struct Move {
+        uint32_t a;
+        uint32_t b;
+        MoveState state;
+    };
+
+    bool Interfere(uint32_t a, uint32_t b) const;
+    static uint64_t EdgeKey(uint32_t a, uint32_t b) {
+        return a < b ? uint64_t{a} << 32 | b : uint64_t{b} << 32 | a;
+    }
+    void AddEdge(uint32_t a, uint32_t b);
+    bool IsRemoved(uint32_t node) const;
+    bool IsMoveRelated(uint32_t node) const;
+    void MakeWorklists();
+    void PushNode(uint32_t node, NodeState state);
+
+    void Simplify(uint32_t node);
+    void DecrementDegree(uint32_t node);
+    void EnableMoves(uint32_t node);
+    void Coalesce(uint32_t move);
+    void AddToSimplify(uint32_t node);
+    bool BriggsTest(uint32_t u, uint32_t v);
+    bool GeorgeTest(uint32_t u, uint32_t v) const;
+    void Combine(uint32_t u, uint32_t v);
+    void Freeze(uint32_t node);
+    void FreezeMoves(uint32_t node);
+    void SelectSpill();
+    void AssignColors();
+    uint32_t GetAlias(uint32_t node) const;
+
+    uint32_t num_nodes_;
+    uint32_t num_colors_ = 0;
+    uint32_t num_coalesced_moves_ = 0;
+    // Interference as a num_nodes x num_nodes bit matrix, or as a set of edge keys above
+    // MATRIX_NODE_LIMIT nodes, and as neighbour lists for iteration.
+    BitVector adj_set_;
+    std::unordered_set<uint64_t> adj_hash_;
+    std::vector<std::vector<uint32_t>> adj_lists_;
+    std::vector<uint32_t> degrees_;
+    std::vector<double> spill_costs_;
+    std::vector<NodeState> states_;
+    std::vector<uint32_t> aliases_;
+    std::vector<uint32_t> colors_;
+    std::vector<Move> moves_;
+    std::vector<std::vector<uint32_t>> node_moves_;
+
+    // Worklists keep nodes that have since moved on; entries whose state differs are skipped.
+    std::vector<uint32_t> simplify_worklist_;
+    std::vector<uint32_t> freeze_worklist_;
+    std::vector<uint32_t> spill_worklist_;
+    std::vector<uint32_t> move_worklist_;
+    std::vector<uint32_t> select_stack_;
+    // Scratch for the Briggs test: the round in which a neighbour was last counted.
+    std::vector<uint32_t> seen_;
+    uint32_t round_ = 0;
+};
+
+} // namespace opt
@@ -1,4 +1,5 @@
 #include "ir/opt/inliner.h"
+#include "ir/analysis/analysis_manager.h"
 #include "ir/basic_block.h"
 #include "ir/graph.h"
 #include "ir/instruction.h"
@@ -23,8 +24,7 @@ void Inliner::HoistConstants(Graph *caller, Graph *callee, InstMapping &mapping)
                 continue;
             }
             auto *c = static_cast<ConstantInst *>(inst);
-            auto *new_c = new ConstantInst(caller->next_inst_id_++, c->GetType(), c->GetValue());
-            caller->instructions_.push_back(std::unique_ptr<Instruction>(new_c));
+            auto *new_c = caller->NewInstruction<ConstantInst>(c->GetType(), c->GetValue());
             if (start_bb->GetFirstInstruction()) {
                 start_bb->InsertBefore(new_c, start_bb->GetFirstInstruction());
             } else {
@@ -46,9 +46,12 @@ void Inliner::CloneBlocks(Graph *graph, Graph *callee, InstMapping &mapping,
                 continue;
             }
             auto *new_inst = inst->Clone(graph, mapping);
-            new_inst->SetId(graph->next_inst_id_++);
-            graph->instructions_.push_back(std::unique_ptr<Instruction>(new_inst));
             new_bb->PushBackInstruction(new_inst);
+            if (new_inst->GetOpcode() != Opcode::PHI) {
+                for (uint32_t i = 0; i < new_inst->GetInputs().size(); ++i) {
+                    graph->RegisterUse(new_inst->GetInputs()[i], new_inst, i);
+                }
+            }
             mapping[inst] = new_inst;
             if (new_inst->GetOpcode() == Opcode::RET) {
                 returns.push_back({static_cast<ReturnInst *>(new_inst), new_bb});
@@ -60,11 +63,16 @@ void Inliner::CloneBlocks(Graph *graph, Graph *callee, InstMapping &mapping,
 }
 
 void Inliner::PatchClonedInstructions(Graph *callee, std::map<BasicBlock *, BasicBlock *> &bb_map,
-                                    std::unordered_map<PhiInst *, PhiInst *> &phi_map, InstMapping &mapping,
-                                    Graph *caller) {
+                                    std::unordered_map<PhiInst *, PhiInst *> &phi_map, InstMapping &mapping) {
     for (auto &bb : callee->GetBlocks()) {
         auto *new_bb = bb_map[&bb];
         for (auto *inst = new_bb->GetFirstInstruction(); inst; inst = inst->GetNext()) {
+            if (inst->GetOpcode() != Opcode::PHI) {
+                // Inputs defined in blocks cloned later were not mapped yet at clone time.
+                for (size_t i = 0; i < inst->GetInputs().size(); ++i) {
+                    inst->SetInput(i, MapInput(inst->GetInputs()[i], mapping));
+                }
+            }
             if (inst->GetOpcode() == Opcode::JUMP) {
                 auto *jump = static_cast<JumpInst *>(inst);
                 jump->SetTarget(bb_map[jump->GetTarget()]);
@@ -75,10 +83,8 @@ void Inliner::PatchClonedInstructions(Graph *callee, std::map<BasicBlock *, Basi
             } else if (inst->GetOpcode() == Opcode::PHI) {
                 auto *phi = static_cast<PhiInst *>(inst);
                 auto *old_phi = phi_map[phi];
-                phi->ClearInputs();
                 for (size_t i = 0; i < old_phi->GetInputs().size(); ++i) {
-                    phi->AddInput(MapInput(old_phi->GetInputs()[i], mapping));
-                    caller->RegisterUse(phi->GetInputs().back(), phi, static_cast<uint32_t>(i));
+                    phi->SetInput(i, MapInput(old_phi->GetInputs()[i], mapping));
                 }
             }
         }
@@ -114,23 +120,23 @@ Instruction *Inliner::CreateMergePhi(Graph *graph, BasicBlock *cont_bb, CallStat
     if (returns.size() <= 1) {
         if (returns.size() == 1) {
             Instruction *val = returns[0].inst->GetInputs().empty() ? nullptr : returns[0].inst->GetInputs()[0];
-            returns[0].bb->RemoveInstruction(returns[0].inst);
+            returns[0].bb->EraseInstruction(returns[0].inst);
             builder.SetInsertPoint(returns[0].bb);
             builder.CreateJump(cont_bb);
             return val;
         }
         return nullptr;
     }
-    auto *phi = new PhiInst(graph->next_inst_id_++, call->GetType());
-    graph->instructions_.push_back(std::unique_ptr<Instruction>(phi));
+    auto *phi = graph->NewInstruction<PhiInst>(call->GetType());
     cont_bb->InsertBefore(phi, cont_bb->GetFirstInstruction());
     phi->SetBasicBlock(cont_bb);
     for (auto &ret : returns) {
-        ret.bb->RemoveInstruction(ret.inst);
+        Instruction *val = ret.inst->GetInputs().empty() ? nullptr : ret.inst->GetInputs()[0];
+        ret.bb->EraseInstruction(ret.inst);
         builder.SetInsertPoint(ret.bb);
         builder.CreateJump(cont_bb);
-        if (!ret.inst->GetInputs().empty()) {
-            phi->AddIncoming(ret.inst->GetInputs()[0], ret.bb);
+        if (val) {
+            phi->AddIncoming(val, ret.bb);
         }
     }
     return phi;
@@ -151,13 +157,14 @@ void Inliner::InlineCall(CallStaticInst *call) {
     std::vector<ReturnInfo> returns;
     std::unordered_map<PhiInst *, PhiInst *> phi_map;
     CloneBlocks(graph_, callee, mapping, bb_map, returns, phi_map);
-    PatchClonedInstructions(callee, bb_map, phi_map, mapping, graph_);
+    PatchClonedInstructions(callee, bb_map, phi_map, mapping);
     ConnectCFG(callee, caller_bb, cont_bb, bb_map, returns);
 
     Instruction *res = CreateMergePhi(graph_, cont_bb, call, returns);
     if (res) {
         call->ReplaceAllUsesWith(res);
     }
+    call->ClearInputs();
 }
 
 bool Inliner::Run() {
@@ -174,5 +181,8 @@ bool Inliner::Run() {
         InlineCall(call);
         changed = true;
     }
+    if (changed) {
+        graph_->GetAnalyses().InvalidateAll();
+    }
     return changed;
 }
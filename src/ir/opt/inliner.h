@@ -28,8 +28,7 @@ class Inliner {
                      std::map<BasicBlock *, BasicBlock *> &bb_map, std::vector<ReturnInfo> &returns,
                      std::unordered_map<PhiInst *, PhiInst *> &phi_map);
     void PatchClonedInstructions(Graph *callee, std::map<BasicBlock *, BasicBlock *> &bb_map,
-                                 std::unordered_map<PhiInst *, PhiInst *> &phi_map, InstMapping &mapping,
-                                 Graph *caller);
+                                 std::unordered_map<PhiInst *, PhiInst *> &phi_map, InstMapping &mapping);
     void ConnectCFG(Graph *callee, BasicBlock *caller_bb, BasicBlock *cont_bb,
                     std::map<BasicBlock *, BasicBlock *> &bb_map, std::vector<ReturnInfo> &returns);
     Instruction *CreateMergePhi(Graph *graph, BasicBlock *cont_bb, CallStaticInst *call,
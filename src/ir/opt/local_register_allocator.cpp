@@ -0,0 +1,331 @@
+#include "ir/opt/local_register_allocator.h"
+#include "ir/analysis/analysis_manager.h"
+#include "ir/analysis/graph_analyzer.h"
+#include "ir/basic_block.h"
+#include "ir/graph.h"
+#include "ir/instruction.h"
+#include "ir/ir_builder.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace opt {
+
+static constexpr uint32_t MAX_REGS = 64;
+
+static uint64_t Bit(uint32_t reg) { return uint64_t{1} << reg; }
+
+LocalRegisterAllocator::LocalRegisterAllocator(Graph *graph, uint32_t num_regs)
+    : graph_(graph), num_regs_(std::min(num_regs, MAX_REGS)), builder_(graph) {}
+
+// Blocks are visited in reverse postorder, so a value is stored before any block it does not
+// dominate loads it; copies into phis only read values of the predecessor they are in.
+void LocalRegisterAllocator::Run() {
+    // An instruction reading two values needs both in registers at once.
+    if (num_regs_ < 2) {
+        throw std::runtime_error("The block-local allocator needs at least two registers.");
+    }
+
+    SplitPhiEdges();
+    GraphAnalyzer analyzer(graph_);
+    analyzer.ComputeRPO();
+
+    uint32_t id_limit = graph_->GetInstIdLimit();
+    reg_of_.Reset(id_limit, NO_REG);
+    uses_left_.Reset(id_limit, 0);
+    global_.Reset(id_limit, 0);
+    home_of_.Reset(id_limit, nullptr);
+    reg_values_.assign(num_regs_, nullptr);
+    reg_holders_.assign(num_regs_, nullptr);
+    num_loads_ = 0;
+    num_stores_ = 0;
+    stack_offset_ = 0;
+
+    CollectGlobalValues(analyzer.GetReversePostOrder());
+    for (auto *block : analyzer.GetReversePostOrder()) {
+        AllocateBlock(block);
+    }
+
+    // The frame keeps the alignment of its largest slots.
+    graph_->SetFrameSize((stack_offset_ + 7) / 8 * 8);
+    // Loads and stores are inserted into the existing blocks.
+    graph_->GetAnalyses().KeepOnly(AnalysisSet::ControlFlow());
+}
+
+// Copies into phis go to the end of the predecessors, so an edge from a block with several
+// successors into a block with phis gets a block of its own.
+void LocalRegisterAllocator::SplitPhiEdges() {
+    std::vector<BasicBlock *> blocks;
+    for (auto &block : graph_->GetBlocks()) {
+        blocks.push_back(&block);
+    }
+
+    bool changed = false;
+    for (auto *block : blocks) {
+        if (block->GetSuccessors().size() < 2) {
+            continue;
+        }
+        for (size_t i = 0; i < block->GetSuccessors().size(); ++i) {
+            auto *first = block->GetSuccessors()[i]->GetFirstInstruction();
+            if (first != nullptr && first->GetOpcode() == Opcode::PHI) {
+                block->SplitEdge(i);
+                changed = true;
+            }
+        }
+    }
+    if (changed) {
+        graph_->GetAnalyses().KeepOnly(AnalysisSet::None());
+    }
+}
+
+// A phi input is used at the end of its predecessor, so a value only read by copies into phis
+// at the end of its own block stays local. Phis get their stack slots here.
+void LocalRegisterAllocator::CollectGlobalValues(const std::vector<BasicBlock *> &blocks) {
+    for (auto *block : blocks) {
+        for (auto *inst = block->GetFirstInstruction(); inst; inst = inst->GetNext()) {
+            bool is_phi = inst->GetOpcode() == Opcode::PHI;
+            if (is_phi) {
+                inst->SetLocation(AssignHome(inst));
+                home_of_[inst] = inst;
+            }
+            for (size_t i = 0; i < inst->GetInputs().size(); ++i) {
+                Instruction *input = inst->GetInputs()[i];
+                BasicBlock *use_block = is_phi ? block->GetPredecessors()[i] : block;
+                if (input != nullptr && input->GetBasicBlock() != use_block) {
+                    global_[input] = 1;
+                }
+            }
+        }
+    }
+}
+
+void LocalRegisterAllocator::CountUses(BasicBlock *block, const std::vector<PhiCopy> &phi_copies) {
+    for (auto *inst = block->GetFirstInstruction(); inst; inst = inst->GetNext()) {
+        if (inst->GetOpcode() == Opcode::PHI) {
+            continue;
+        }
+        for (auto *input : inst->GetInputs()) {
+            if (input != nullptr) {
+                ++uses_left_[input];
+            }
+        }
+    }
+    for (const auto &copy : phi_copies) {
+        ++uses_left_[copy.value];
+    }
+}
+
+void LocalRegisterAllocator::AllocateBlock(BasicBlock *block) {
+    block_ = block;
+    std::vector<PhiCopy> phi_copies;
+    if (block->GetSuccessors().size() == 1) {
+        BasicBlock *succ = block->GetSuccessors()[0];
+        const auto &preds = succ->GetPredecessors();
+        size_t pred_idx = std::find(preds.begin(), preds.end(), block) - preds.begin();
+        for (auto *phi = succ->GetFirstInstruction(); phi && phi->GetOpcode() == Opcode::PHI; phi = phi->GetNext()) {
+            Instruction *value = phi->GetInputs()[pred_idx];
+            if (value != nullptr && value != phi) {
+                phi_copies.push_back({phi, value});
+            }
+        }
+    }
+    CountUses(block, phi_copies);
+    free_regs_ = num_regs_ == MAX_REGS ? ~uint64_t{0} : Bit(num_regs_) - 1;
+
+    Instruction *last = block->GetLastInstruction();
+    Instruction *jump = last != nullptr && last->GetOpcode() == Opcode::JUMP ? last : nullptr;
+    Instruction *next = nullptr;
+    for (auto *inst = block->GetFirstInstruction(); inst; inst = next) {
+        next = inst->GetNext();
+        if (inst->GetOpcode() == Opcode::PHI) {
+            continue;
+        }
+        if (inst == jump && !phi_copies.empty()) {
+            InsertPhiCopies(std::exchange(phi_copies, {}), inst);
+        }
+
+        // All operands are in registers before any of them gives its register up.
+        uint64_t pinned = 0;
+        operands_.clear();
+        for (size_t i = 0; i < inst->GetInputs().size(); ++i) {
+            Instruction *input = inst->GetInputs()[i];
+            if (input == nullptr) {
+                continue;
+            }
+            inst->SetInput(i, UseInRegister(input, pinned, inst));
+            if (reg_of_[input] != NO_REG) {
+                pinned |= Bit(reg_of_[input]);
+            }
+            operands_.push_back(input);
+        }
+        for (auto *operand : operands_) {
+            Release(operand);
+        }
+
+        if (inst->GetType() == Type::VOID) {
+            continue;
+        }
+        uint32_t reg = TakeRegister(0, inst);
+        inst->SetLocation(Location::MakeRegister(reg));
+        Bind(reg, inst, inst);
+        if (global_[inst] && inst->GetOpcode() != Opcode::Constant) {
+            InsertBefore(next);
+            auto *store = builder_.CreateStore(inst->GetType(), inst, inst);
+            store->SetLocation(AssignHome(inst));
+            home_of_[inst] = store;
+            ++num_stores_;
+        }
+        if (uses_left_[inst] == 0) {
+            Free(reg);
+        }
+    }
+    if (!phi_copies.empty()) {
+        InsertPhiCopies(std::move(phi_copies), nullptr);
+    }
+
+    // Nothing stays in a register across the end of the block.
+    for (uint32_t reg = 0; reg < num_regs_; ++reg) {
+        if (reg_values_[reg] != nullptr) {
+            Free(reg);
+        }
+    }
+}
+
+// The copies form a parallel move: a phi read by another copy is only written once that copy is
+// done, and where the copies form a cycle the old value of one phi is kept in a register meanwhile.
+void LocalRegisterAllocator::InsertPhiCopies(std::vector<PhiCopy> copies, Instruction *before) {
+    auto is_read = [&copies](Instruction *phi) {
+        return std::any_of(copies.begin(), copies.end(), [phi](const PhiCopy &copy) { return copy.value == phi; });
+    };
+    uint64_t pinned = 0;
+    while (!copies.empty()) {
+        auto ready = std::find_if(copies.begin(), copies.end(), [&](const PhiCopy &copy) {
+            uint32_t reg = reg_of_[copy.phi];
+            return (reg != NO_REG && (pinned & Bit(reg)) != 0) || !is_read(copy.phi);
+        });
+        if (ready == copies.end()) {
+            ready = copies.begin();
+            UseInRegister(ready->phi, pinned, before);
+            pinned |= Bit(reg_of_[ready->phi]);
+        }
+        PhiCopy copy = *ready;
+        copies.erase(ready);
+
+        Instruction *holder = UseInRegister(copy.value, pinned, before);
+        InsertBefore(before);
+        auto *store = builder_.CreateStore(copy.phi->GetType(), holder, holder);
+        store->SetLocation(copy.phi->GetLocation());
+        ++num_stores_;
+        if (reg_of_[copy.value] != NO_REG && !is_read(copy.value)) {
+            pinned &= ~Bit(reg_of_[copy.value]);
+        }
+        Release(copy.value);
+    }
+}
+
+// Returns the instruction holding `value` in a register, loading it from its stack slot, or
+// creating the constant again, in front of `before` if no register holds it yet.
+Instruction *LocalRegisterAllocator::UseInRegister(Instruction *value, uint64_t pinned, Instruction *before) {
+    uint32_t reg = reg_of_[value];
+    if (reg != NO_REG) {
+        return reg_holders_[reg];
+    }
+    // Arguments are read from wherever the caller passes them.
+    if (value->GetBasicBlock() == nullptr) {
+        return value;
+    }
+
+    reg = TakeRegister(pinned, before);
+    InsertBefore(before);
+    Instruction *holder;
+    if (value->GetOpcode() == Opcode::Constant) {
+        holder = builder_.CreateConstant(value->GetType(), static_cast<ConstantInst *>(value)->GetValue());
+    } else if (home_of_[value] != nullptr) {
+        holder = builder_.CreateLoad(value->GetType(), home_of_[value]);
+        ++num_loads_;
+    } else {
+        throw std::runtime_error("i" + std::to_string(value->GetId()) + " is used before it is stored.");
+    }
+    holder->SetLocation(Location::MakeRegister(reg));
+    Bind(reg, value, holder);
+    return holder;
+}
+
+void LocalRegisterAllocator::Release(Instruction *value) {
+    if (--uses_left_[value] == 0 && reg_of_[value] != NO_REG) {
+        Free(reg_of_[value]);
+    }
+}
+
+// A free register that is not pinned, or else the one whose value has the fewest uses left in the
+// block, preferring values that need no store as they are already in their stack slot.
+uint32_t LocalRegisterAllocator::TakeRegister(uint64_t pinned, Instruction *before) {
+    uint64_t candidates = free_regs_ & ~pinned;
+    if (candidates != 0) {
+        return static_cast<uint32_t>(std::countr_zero(candidates));
+    }
+
+    auto needs_store = [this](Instruction *value) {
+        return home_of_[value] == nullptr && value->GetOpcode() != Opcode::Constant;
+    };
+    uint32_t victim = NO_REG;
+    uint64_t victim_cost = UINT64_MAX;
+    for (uint32_t reg = 0; reg < num_regs_; ++reg) {
+        if ((pinned & Bit(reg)) != 0) {
+            continue;
+        }
+        uint64_t cost = 2 * uint64_t{uses_left_[reg_values_[reg]]} + needs_store(reg_values_[reg]);
+        if (cost < victim_cost) {
+            victim = reg;
+            victim_cost = cost;
+        }
+    }
+    if (victim == NO_REG) {
+        throw std::runtime_error("Not enough registers for the operands of one instruction.");
+    }
+
+    Instruction *value = reg_values_[victim];
+    if (needs_store(value)) {
+        InsertBefore(before);
+        auto *store = builder_.CreateStore(value->GetType(), reg_holders_[victim], reg_holders_[victim]);
+        store->SetLocation(AssignHome(value));
+        home_of_[value] = store;
+        ++num_stores_;
+    }
+    Free(victim);
+    return victim;
+}
+
+void LocalRegisterAllocator::Bind(uint32_t reg, Instruction *value, Instruction *holder) {
+    reg_values_[reg] = value;
+    reg_holders_[reg] = holder;
+    reg_of_[value] = reg;
+    free_regs_ &= ~Bit(reg);
+}
+
+void LocalRegisterAllocator::Free(uint32_t reg) {
+    reg_of_[reg_values_[reg]] = NO_REG;
+    reg_values_[reg] = nullptr;
+    reg_holders_[reg] = nullptr;
+    free_regs_ |= Bit(reg);
+}
+
+void LocalRegisterAllocator::InsertBefore(Instruction *before) {
+    if (before != nullptr) {
+        builder_.SetInsertPoint(before);
+    } else {
+        builder_.SetInsertPoint(block_);
+    }
+}
+
+// Slots are never shared: each value gets its own, aligned to its size, growing the frame downwards.
+Location LocalRegisterAllocator::AssignHome(Instruction *value) {
+    uint32_t size = std::max(GetTypeSize(value->GetType()), 1U);
+    stack_offset_ = (stack_offset_ + 2 * size - 1) / size * size;
+    return Location::MakeStack(-static_cast<int32_t>(stack_offset_));
+}
+
+} // namespace opt
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ir/analysis/side_table.h"
+#include "ir/graph.h"
+#include "ir/instruction.h"
+#include "ir/ir_builder.h"
+#include <cstdint>
+#include <vector>
+
+namespace opt {
+
+// Single-pass allocator for first-tier compiles: each block is allocated on its own, in one walk
+// over its instructions and without liveness analysis. Values used in another block than their own
+// live in a stack slot of their own, written right after the definition, and are loaded again where
+// they are used; phis live in their stack slots and are written by copies at the end of their
+// predecessors. Within a block a value keeps its register until its last use in the block; when no
+// register is free, the value with the fewest uses left gives its register up. Constants are
+// created again instead of being stored.
+class LocalRegisterAllocator {
+  public:
+    // At most 64 registers are used, as free registers are kept in a bit mask. Run throws with fewer
+    // than two.
+    LocalRegisterAllocator(Graph *graph, uint32_t num_regs);
+
+    // Loads and stores inserted by the last Run.
+    uint32_t GetNumLoads() const { return num_loads_; }
+    uint32_t GetNumStores() const { return num_stores_; }
+
+    void Run();
+
+  private:
+    static constexpr uint32_t NO_REG = UINT32_MAX;
+
+    // A phi and the value it gets on the edge from the block being allocated.
+    struct PhiCopy {
+        Instruction *phi;
+        Instruction *value;
+    };
+
+    void SplitPhiEdges();
+    void CollectGlobalValues(const std::vector<BasicBlock *> &blocks);
+    void CountUses(BasicBlock *block, const std::vector<PhiCopy> &phi_copies);
+    void AllocateBlock(BasicBlock *block);
+    void InsertPhiCopies(std::vector<PhiCopy> copies, Instruction *before);
+
+    Instruction *UseInRegister(Instruction *value, uint64_t pinned, Instruction *before);
+    void Release(Instruction *value);
+    uint32_t TakeRegister(uint64_t pinned, Instruction *before);
+    void Bind(uint32_t reg, Instruction *value, Instruction *holder);
+    void Free(uint32_t reg);
+    // Code for `before` goes in front of it, or at the end of the block if it is null.
+    void InsertBefore(Instruction *before);
+    Location AssignHome(Instruction *value);
+
+    Graph *graph_;
+    uint32_t num_regs_;
+    IRBuilder builder_;
+    BasicBlock *block_ = nullptr;
+    uint32_t num_loads_ = 0;
+    uint32_t num_stores_ = 0;
+
+    // Registers without a value, one bit per register.
+    uint64_t free_regs_ = 0;
+    // Per register: the value it holds and the instruction that put it there.
+    std::vector<Instruction *> reg_values_;
+    std::vector<Instruction *> reg_holders_;
+    InstMap<uint32_t> reg_of_;
+    // Uses of a value left in the block being allocated, including the copies into phis at its end.
+    InstMap<uint32_t> uses_left_;
+    // Values used in another block than their own, including by phis on an edge from another block.
+    InstMap<uint8_t> global_;
+    // The instruction located in a value's stack slot: the phi itself, or the store that wrote it.
+    InstMap<Instruction *> home_of_;
+    uint32_t stack_offset_ = 0;
+    // Scratch: the values read by the instruction being allocated.
+    std::vector<Instruction *> operands_;
+};
+
+} // namespace opt
@@ -1,31 +1,97 @@
 #include "ir/opt/peephole_optimizer.h"
+#include "ir/analysis/analysis_manager.h"
 #include "ir/basic_block.h"
 #include "ir/graph.h"
 #include "ir/instruction.h"
 #include "ir/ir_builder.h"
 
-PeepholeOptimizer::PeepholeOptimizer(Graph *graph) : graph_(graph) {}
+#include <bit>
+#include <utility>
 
-void PeepholeOptimizer::Run() {
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        for (auto &bb : graph_->GetBlocks()) {
-            for (auto *inst = bb.GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
-                if (inst->GetFirstUser() == nullptr && inst->GetType() != Type::VOID) {
-                    continue;
-                }
-
-                Instruction *replacement = TryFold(inst);
-                if (replacement && replacement != inst) {
-                    inst->ReplaceAllUsesWith(replacement);
-                    changed = true;
-                }
+PeepholeOptimizer::PeepholeOptimizer(Graph *graph) : graph_(graph), builder_(graph) {}
+
+void PeepholeOptimizer::Push(Instruction *inst) {
+    if (inst->GetBasicBlock() != nullptr && !in_worklist_[inst]) {
+        in_worklist_[inst] = 1;
+        worklist_.push_back(inst);
+    }
+}
+
+static bool IsPure(const Instruction *inst) {
+    switch (inst->GetOpcode()) {
+    case Opcode::Constant:
+    case Opcode::ADD:
+    case Opcode::MUL:
+    case Opcode::AND:
+    case Opcode::SHL:
+    case Opcode::CMP:
+    case Opcode::CAST:
+    case Opcode::U32_TO_U64:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Erases `inst` if nothing reads it any more, then the operands that this leaves unused.
+void PeepholeOptimizer::EraseIfDead(Instruction *inst) {
+    std::vector<Instruction *> stack = {inst};
+    while (!stack.empty()) {
+        Instruction *dead = stack.back();
+        stack.pop_back();
+        if (dead->GetBasicBlock() == nullptr || dead->GetFirstUser() != nullptr || !IsPure(dead)) {
+            continue;
+        }
+        std::vector<Instruction *> inputs(dead->GetInputs().begin(), dead->GetInputs().end());
+        dead->GetBasicBlock()->EraseInstruction(dead);
+        erased_.push_back(dead);
+        for (auto *input : inputs) {
+            if (input != nullptr) {
+                stack.push_back(input);
             }
         }
     }
 }
 
+void PeepholeOptimizer::Run() {
+    in_worklist_.Reset(graph_->GetInstIdLimit(), 0);
+    worklist_.clear();
+    erased_.clear();
+    // Pushed backwards, so that instructions are first visited in program order.
+    for (auto it = graph_->GetBlocks().rbegin(); it != graph_->GetBlocks().rend(); ++it) {
+        for (auto *inst = it->GetLastInstruction(); inst != nullptr; inst = inst->GetPrev()) {
+            Push(inst);
+        }
+    }
+
+    while (!worklist_.empty()) {
+        Instruction *inst = worklist_.back();
+        worklist_.pop_back();
+        in_worklist_[inst] = 0;
+        if (inst->GetBasicBlock() == nullptr || (inst->GetFirstUser() == nullptr && inst->GetType() != Type::VOID)) {
+            continue;
+        }
+
+        Instruction *replacement = TryFold(inst);
+        if (replacement == nullptr || replacement == inst) {
+            continue;
+        }
+        for (auto *user = inst->GetFirstUser(); user != nullptr; user = user->GetNextUser()) {
+            Push(user->GetUserInstruction());
+        }
+        Push(replacement);
+        inst->ReplaceAllUsesWith(replacement);
+        EraseIfDead(inst);
+    }
+
+    for (auto *inst : erased_) {
+        graph_->DeleteInstruction(inst);
+    }
+    erased_.clear();
+    // Folding rewrites instructions in place and never touches the CFG.
+    graph_->GetAnalyses().KeepOnly(AnalysisSet::ControlFlow());
+}
+
 static ConstantInst *AsConstant(Instruction *inst) { return dynamic_cast<ConstantInst *>(inst); }
 
 static bool IsNegationOf(Instruction *inst, Instruction *target) {
@@ -49,9 +115,17 @@ static bool IsNegationOf(Instruction *inst, Instruction *target) {
 }
 
 Instruction *PeepholeOptimizer::TryFold(Instruction *inst) {
-    IRBuilder builder(graph_);
-    if (inst->GetBasicBlock()) {
-        builder.SetInsertPoint(inst->GetBasicBlock());
+    // New instructions go right before the folded one, where all its operands are available.
+    builder_.SetInsertPoint(inst);
+
+    if (inst->GetOpcode() == Opcode::MUL) {
+        return FoldMul(inst);
+    }
+    if (inst->GetOpcode() == Opcode::CMP) {
+        return FoldCompare(inst);
+    }
+    if (inst->GetOpcode() == Opcode::CAST) {
+        return FoldCast(inst);
     }
 
     if (auto *bin_op = dynamic_cast<BinaryInst *>(inst)) {
@@ -64,7 +138,8 @@ Instruction *PeepholeOptimizer::TryFold(Instruction *inst) {
         case Opcode::ADD:
             // Constant Folding
             if (lc && rc) {
-                return builder.CreateConstant(inst->GetType(), lc->GetValue() + rc->GetValue());
+                uint64_t sum = TruncateToType(lc->GetValue() + rc->GetValue(), inst->GetType());
+                return builder_.CreateConstant(inst->GetType(), sum);
             }
             // x + 0 -> x
             if (rc && rc->GetValue() == 0) {
@@ -75,18 +150,18 @@ Instruction *PeepholeOptimizer::TryFold(Instruction *inst) {
             }
             // x + x -> x << 1
             if (lhs == rhs) {
-                auto *one = builder.CreateConstant(Type::U32, 1);
-                return builder.CreateShl(lhs, one);
+                auto *one = builder_.CreateConstant(Type::U32, 1);
+                return builder_.CreateShl(lhs, one);
             }
             // x + (-x) -> 0
             if (IsNegationOf(rhs, lhs) || IsNegationOf(lhs, rhs)) {
-                return builder.CreateConstant(inst->GetType(), 0);
+                return builder_.CreateConstant(inst->GetType(), 0);
             }
             break;
 
         case Opcode::AND:
             if (lc && rc)
-                return builder.CreateConstant(inst->GetType(), lc->GetValue() & rc->GetValue());
+                return builder_.CreateConstant(inst->GetType(), lc->GetValue() & rc->GetValue());
             if (rc && rc->GetValue() == 0)
                 return rc;
             if (lc && lc->GetValue() == 0)
@@ -98,8 +173,11 @@ Instruction *PeepholeOptimizer::TryFold(Instruction *inst) {
             break;
 
         case Opcode::SHL:
-            if (lc && rc)
-                return builder.CreateConstant(inst->GetType(), lc->GetValue() << rc->GetValue());
+            if (lc && rc) {
+                // Shifting out all bits gives 0; in C++ a shift by 64 or more is undefined.
+                uint64_t shifted = rc->GetValue() >= 64 ? 0 : lc->GetValue() << rc->GetValue();
+                return builder_.CreateConstant(inst->GetType(), TruncateToType(shifted, inst->GetType()));
+            }
             if (rc && rc->GetValue() == 0)
                 return lhs;
             if (lc && lc->GetValue() == 0)
@@ -112,3 +190,80 @@ Instruction *PeepholeOptimizer::TryFold(Instruction *inst) {
     }
     return nullptr;
 }
+
+Instruction *PeepholeOptimizer::FoldMul(Instruction *inst) {
+    auto *lhs = inst->GetInputs()[0];
+    auto *rhs = inst->GetInputs()[1];
+    auto *lc = AsConstant(lhs);
+    auto *rc = AsConstant(rhs);
+    if (lc && rc) {
+        uint64_t product = TruncateToType(lc->GetValue() * rc->GetValue(), inst->GetType());
+        return builder_.CreateConstant(inst->GetType(), product);
+    }
+    // Canonicalize the constant to the right.
+    if (lc) {
+        std::swap(lhs, rhs);
+        std::swap(lc, rc);
+    }
+    if (!rc) {
+        return nullptr;
+    }
+    // Only the bits of the result type take part in the product.
+    uint64_t value = TruncateToType(rc->GetValue(), inst->GetType());
+    // x * 0 -> 0
+    if (value == 0) {
+        return rc->GetValue() == 0 ? rc : builder_.CreateConstant(inst->GetType(), 0);
+    }
+    // x * 1 -> x
+    if (value == 1) {
+        return lhs;
+    }
+    // x * 2^k -> x << k
+    if ((value & (value - 1)) == 0) {
+        auto *amount = builder_.CreateConstant(Type::U32, std::countr_zero(value));
+        return builder_.CreateShl(lhs, amount);
+    }
+    return nullptr;
+}
+
+// x cc x is decided by whether the condition holds for equal values.
+Instruction *PeepholeOptimizer::FoldCompare(Instruction *inst) {
+    if (inst->GetInputs()[0] != inst->GetInputs()[1]) {
+        return nullptr;
+    }
+    switch (static_cast<CompareInst *>(inst)->GetCC()) {
+    case ConditionCode::EQ:
+    case ConditionCode::LE:
+    case ConditionCode::GE:
+    case ConditionCode::ULE:
+        return builder_.CreateConstant(Type::BOOL, 1);
+    case ConditionCode::NE:
+    case ConditionCode::LT:
+    case ConditionCode::GT:
+    case ConditionCode::UGT:
+        return builder_.CreateConstant(Type::BOOL, 0);
+    }
+    return nullptr;
+}
+
+Instruction *PeepholeOptimizer::FoldCast(Instruction *inst) {
+    Instruction *from = inst->GetInputs()[0];
+    Type to_type = inst->GetType();
+    // A cast to the type the value already has does nothing.
+    if (from->GetType() == to_type) {
+        return from;
+    }
+    if (auto *constant = AsConstant(from)) {
+        return builder_.CreateConstant(to_type, FoldCastValue(constant->GetValue(), from->GetType(), to_type));
+    }
+    // cast(cast(x, T1), T2) -> cast(x, T2) if T1 keeps all bits that T2 takes: either both casts
+    // truncate, or T1 widens x with the same extension a direct cast to T2 would use.
+    if (from->GetOpcode() == Opcode::CAST && GetTypeSize(from->GetType()) >= GetTypeSize(to_type)) {
+        Instruction *source = from->GetInputs()[0];
+        if (source->GetType() == to_type) {
+            return source;
+        }
+        return builder_.CreateCast(to_type, source);
+    }
+    return nullptr;
+}
@@ -1,8 +1,16 @@
 #pragma once
 
+#include "ir/analysis/side_table.h"
+#include "ir/ir_builder.h"
+#include <vector>
+
 class Graph;
 class Instruction;
 
+// Local algebraic simplification driven by a worklist: every instruction is visited once, and
+// after a rewrite only the users of the replaced value and the replacement are visited again, so
+// a chain of folds costs time linear in its length. Originals left without users are erased, and
+// so are operands that lose their last user with them.
 class PeepholeOptimizer {
   public:
     explicit PeepholeOptimizer(Graph *graph);
@@ -10,6 +18,18 @@ class PeepholeOptimizer {
 
   private:
     Instruction *TryFold(Instruction *inst);
+    Instruction *FoldMul(Instruction *inst);
+    Instruction *FoldCompare(Instruction *inst);
+    Instruction *FoldCast(Instruction *inst);
+
+    void Push(Instruction *inst);
+    void EraseIfDead(Instruction *inst);
 
     Graph *graph_;
+    // Reused by all rewrites; placed right before the instruction being folded.
+    IRBuilder builder_;
+    std::vector<Instruction *> worklist_;
+    InstMap<uint8_t> in_worklist_;
+    // Erased instructions are destroyed at the end of Run, as the worklist may still name them.
+    std::vector<Instruction *> erased_;
 };
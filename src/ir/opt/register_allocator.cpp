@@ -1,207 +1,1024 @@
 #include "ir/opt/register_allocator.h"
+#include "ir/analysis/analysis_manager.h"
 #include "ir/analysis/linear_order.h"
 #include "ir/analysis/liveness_analyzer.h"
+#include "ir/analysis/loop_analyzer.h"
+#include "ir/basic_block.h"
 #include "ir/graph.h"
 #include "ir/instruction.h"
 #include "ir/ir_builder.h"
+#include "ir/opt/graph_coloring.h"
+#include "ir/opt/local_register_allocator.h"
 
 #include <algorithm>
-#include <iostream>
-#include <list>
-#include <set>
+#include <cmath>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
+#include <utility>
 
 namespace opt {
 
-RegisterAllocator::RegisterAllocator(Graph *graph, uint32_t num_total_regs) : graph_(graph) {
-    if (num_total_regs <= num_reserved_regs_) {
+using analysis::LiveInterval;
+
+// Reloads of up to two operands of one instruction, and a move between stack slots while a cycle
+// of moves is broken, each need a register of their own.
+static constexpr uint32_t SCRATCH_REGS = 2;
+
+RegisterAllocator::RegisterAllocator(Graph *graph, uint32_t num_total_regs, SpillHeuristic heuristic)
+    : graph_(graph), num_total_regs_(num_total_regs), spill_heuristic_(heuristic) {}
+
+// The reserved registers are the last ones; the others are allocated.
+void RegisterAllocator::ReserveRegisters(uint32_t num_reserved) {
+    if (num_total_regs_ <= num_reserved) {
         // Not enough registers to do anything useful
         num_regs_ = 0;
         reserved_regs_start_ = 0;
     } else {
-        num_regs_ = num_total_regs - num_reserved_regs_;
+        num_regs_ = num_total_regs_ - num_reserved;
         reserved_regs_start_ = num_regs_;
     }
-
-    for (uint32_t i = 0; i < num_regs_; ++i) {
-        free_regs_.insert(i);
-    }
+    num_reserved_regs_ = num_reserved;
+    reg_positions_.assign(num_regs_, 0);
+    reg_weights_.assign(num_regs_, 0.0);
 }
 
+// Scratch registers are only needed to reload operands from the stack and to move between stack
+// slots, so all registers are allocated first. If some value has to be spilled after all, the
+// allocation starts over with two registers reserved.
 void RegisterAllocator::Run() {
+    if (mode_ == AllocationMode::BLOCK_LOCAL) {
+        LocalRegisterAllocator(graph_, num_total_regs_).Run();
+        return;
+    }
+
+    ReserveRegisters(reserve_up_front_ ? SCRATCH_REGS : 0);
     if (num_regs_ == 0)
         return; // Nothing to allocate
 
-    analysis::LivenessAnalyzer liveness_analyzer(graph_);
-    liveness_analyzer.Analyze();
+    SplitCriticalEdges();
+    if (!Allocate()) {
+        Reset();
+        ReserveRegisters(SCRATCH_REGS);
+        if (num_regs_ == 0) {
+            return;
+        }
+        Allocate();
+    }
+
+    CountCoalescedMoves();
+    num_rematerializations_ = 0;
+    RewriteAndInsertSpillFill();
+    // The frame keeps the alignment of its largest slots.
+    graph_->SetFrameSize((stack_offset_ + 7) / 8 * 8);
+    // Spill, fill and resolution moves are inserted into the existing blocks.
+    graph_->GetAnalyses().KeepOnly(AnalysisSet::ControlFlow());
+}
 
-    for (auto &block : liveness_analyzer.GetLinearOrder()) {
+// Runs the linear scan, or colors the intervals. Without reserved registers it gives up, returning
+// false, as soon as some interval would have to be spilled.
+bool RegisterAllocator::Allocate() {
+    liveness_ = &graph_->GetAnalyses().GetLivenessAnalyzer();
+    spill_slots_.Reset(graph_->GetInstIdLimit());
+    NumberBlocks();
+    CollectPhiUses();
+
+    for (auto *block : liveness_->GetLinearOrder()) {
         for (auto *inst = block->GetFirstInstruction(); inst; inst = inst->GetNext()) {
-            auto interval = liveness_analyzer.GetLiveInterval(inst);
+            auto interval = liveness_->GetLiveInterval(inst);
             if (interval && !interval->GetRanges().empty()) {
                 intervals_.push_back(interval);
             }
         }
     }
 
-    std::sort(intervals_.begin(), intervals_.end(),
-              [](auto a, auto b) { return a->GetRanges().front().start < b->GetRanges().front().start; });
+    std::stable_sort(intervals_.begin(), intervals_.end(),
+                     [](auto a, auto b) { return a->GetStart() < b->GetStart(); });
+    if (mode_ == AllocationMode::GRAPH_COLORING) {
+        return ColorIntervals();
+    }
+
+    CollectRegisterHints();
+    unhandled_.assign(intervals_.rbegin(), intervals_.rend());
 
-    for (auto &interval : intervals_) {
-        ExpireOldIntervals(interval);
-        if (active_.size() == num_regs_) {
-            SpillAtInterval(interval);
-        } else {
-            AllocateRegister(interval);
+    while (!unhandled_.empty()) {
+        auto *current = unhandled_.back();
+        unhandled_.pop_back();
+        UpdateActiveAndInactive(current->GetStart());
+        if (TryAllocateFreeRegister(current)) {
+            continue;
+        }
+        if (num_reserved_regs_ == 0) {
+            return false;
         }
+        AllocateBlockedRegister(current);
     }
+    return true;
+}
 
-    RewriteAndInsertSpillFill();
+// Drops the result of an allocation that gave up; the split intervals go with the liveness.
+void RegisterAllocator::Reset() {
+    intervals_.clear();
+    unhandled_.clear();
+    active_.clear();
+    inactive_.clear();
+    blocks_.clear();
+    phi_uses_.clear();
+    hints_.clear();
+    spill_slots_.clear();
+    stored_at_definition_.clear();
+    stack_slots_.clear();
+    stack_offset_ = 0;
+    liveness_ = nullptr;
+    graph_->GetAnalyses().Invalidate(AnalysisKind::LIVENESS);
 }
 
-void RegisterAllocator::ExpireOldIntervals(analysis::LiveInterval *current) {
-    std::vector<analysis::LiveInterval *> still_active;
-    for (auto *active_interval : active_) {
-        if (active_interval->GetRanges().back().end >= current->GetRanges().front().start) {
-            still_active.push_back(active_interval);
-        } else {
-            auto loc = active_interval->GetInstruction()->GetLocation();
-            if (loc.GetKind() == Location::REGISTER) {
-                free_regs_.insert(loc.GetValue());
+// Moves on an edge from a block with several successors into a block with several predecessors
+// would have no place to go, so such edges get a block of their own.
+void RegisterAllocator::SplitCriticalEdges() {
+    std::vector<BasicBlock *> blocks;
+    for (auto &block : graph_->GetBlocks()) {
+        blocks.push_back(&block);
+    }
+
+    bool changed = false;
+    for (auto *block : blocks) {
+        if (block->GetSuccessors().size() < 2) {
+            continue;
+        }
+        for (size_t i = 0; i < block->GetSuccessors().size(); ++i) {
+            if (block->GetSuccessors()[i]->GetPredecessors().size() > 1) {
+                block->SplitEdge(i);
+                changed = true;
             }
         }
     }
-    active_ = still_active;
+    if (changed) {
+        graph_->GetAnalyses().KeepOnly(AnalysisSet::None());
+    }
 }
 
-static void SortedInsert(std::vector<analysis::LiveInterval *> &vec, analysis::LiveInterval *inst) {
-    vec.insert(std::lower_bound(vec.begin(), vec.end(), inst,
-                                [](auto a, auto b) { return a->GetRanges().back().end < b->GetRanges().back().end; }),
-               inst);
+void RegisterAllocator::NumberBlocks() {
+    LoopAnalyzer &loops = graph_->GetAnalyses().GetLoopAnalyzer();
+    for (auto *block : liveness_->GetLinearOrder()) {
+        auto range = liveness_->GetBlockRange(block);
+        uint32_t body = range.start;
+        for (auto *inst = block->GetFirstInstruction(); inst && inst->GetOpcode() == Opcode::PHI;
+             inst = inst->GetNext()) {
+            body += 2;
+        }
+        auto depth = static_cast<uint32_t>(loops.GetLoopsForBlock(block).size());
+        blocks_.push_back({block, range.start, body, range.end, depth});
+    }
 }
 
-void RegisterAllocator::SpillAtInterval(analysis::LiveInterval *current) {
-    auto spill = active_.back();
-    if (spill->GetRanges().back().end > current->GetRanges().back().end) {
-        auto loc = spill->GetInstruction()->GetLocation();
-        current->GetInstruction()->SetLocation(loc);
+void RegisterAllocator::CollectPhiUses() {
+    phi_uses_.Reset(graph_->GetInstIdLimit());
+    for (const auto &block : blocks_) {
+        const auto &preds = block.block->GetPredecessors();
+        for (auto *inst = block.block->GetFirstInstruction(); inst && inst->GetOpcode() == Opcode::PHI;
+             inst = inst->GetNext()) {
+            for (size_t i = 0; i < inst->GetInputs().size() && i < preds.size(); ++i) {
+                auto pred_range = liveness_->GetBlockRange(preds[i]);
+                if (inst->GetInputs()[i] != nullptr && pred_range.start != pred_range.end) {
+                    phi_uses_[inst->GetInputs()[i]].push_back(pred_range.end - 1);
+                }
+            }
+        }
+    }
+}
 
-        stack_offset_ += 8;
-        spill->GetInstruction()->SetLocation(Location::MakeStack(-stack_offset_));
+// Values connected by a move prefer to share a register so that the move disappears: a phi and
+// its inputs, and the two sides of a MoveInst. Arguments of a call prefer the register of their
+// position.
+void RegisterAllocator::CollectRegisterHints() {
+    hints_.Reset(graph_->GetInstIdLimit());
+    for (const auto &block : blocks_) {
+        const auto &preds = block.block->GetPredecessors();
+        uint32_t pos = block.from;
+        for (auto *inst = block.block->GetFirstInstruction(); inst; inst = inst->GetNext(), pos += 2) {
+            if (inst->GetOpcode() == Opcode::PHI) {
+                for (size_t i = 0; i < inst->GetInputs().size() && i < preds.size(); ++i) {
+                    auto pred_range = liveness_->GetBlockRange(preds[i]);
+                    Instruction *input = inst->GetInputs()[i];
+                    if (input != nullptr && pred_range.start != pred_range.end) {
+                        hints_[inst].push_back({input, pred_range.end - 1, NO_HINT});
+                        hints_[input].push_back({inst, pos, NO_HINT});
+                    }
+                }
+            } else if (inst->GetOpcode() == Opcode::MOVE && inst->GetInputs()[0] != nullptr) {
+                hints_[inst].push_back({inst->GetInputs()[0], pos > block.from ? pos - 1 : pos, NO_HINT});
+                hints_[inst->GetInputs()[0]].push_back({inst, pos, NO_HINT});
+            } else if (inst->GetOpcode() == Opcode::CALL_STATIC) {
+                for (size_t i = 0; i < inst->GetInputs().size() && i < num_regs_; ++i) {
+                    hints_[inst->GetInputs()[i]].push_back({nullptr, 0, static_cast<uint32_t>(i)});
+                }
+            }
+        }
+    }
+}
 
-        active_.pop_back();
-        SortedInsert(active_, current);
-    } else {
-        stack_offset_ += 8;
-        current->GetInstruction()->SetLocation(Location::MakeStack(-stack_offset_));
+// Phi inputs and MoveInsts whose source ends up where the destination is need no move.
+void RegisterAllocator::CountCoalescedMoves() {
+    num_coalesced_moves_ = 0;
+    for (const auto &block : blocks_) {
+        const auto &preds = block.block->GetPredecessors();
+        uint32_t pos = block.from;
+        for (auto *inst = block.block->GetFirstInstruction(); inst; inst = inst->GetNext(), pos += 2) {
+            Location location = GetLocationAt(inst, pos);
+            if (inst->GetOpcode() == Opcode::PHI) {
+                for (size_t i = 0; i < inst->GetInputs().size() && i < preds.size(); ++i) {
+                    auto pred_range = liveness_->GetBlockRange(preds[i]);
+                    if (inst->GetInputs()[i] != nullptr && pred_range.start != pred_range.end &&
+                        GetLocationAt(inst->GetInputs()[i], pred_range.end - 1) == location) {
+                        ++num_coalesced_moves_;
+                    }
+                }
+            } else if (inst->GetOpcode() == Opcode::MOVE && inst->GetInputs()[0] != nullptr &&
+                       GetLocationAt(inst->GetInputs()[0], pos > block.from ? pos - 1 : pos) == location) {
+                ++num_coalesced_moves_;
+            }
+        }
     }
 }
 
-void RegisterAllocator::AllocateRegister(analysis::LiveInterval *current) {
-    if (free_regs_.empty()) {
-        SpillAtInterval(current);
-        return;
+// Estimated execution frequency of a block: each enclosing loop is assumed to run ten times.
+static double GetBlockWeight(uint32_t loop_depth) {
+    return std::pow(10.0, std::min(loop_depth, 10U));
+}
+
+void RegisterAllocator::AddUnhandled(LiveInterval *interval) {
+    auto it = std::lower_bound(unhandled_.begin(), unhandled_.end(), interval->GetStart(),
+                               [](LiveInterval *other, uint32_t start) { return other->GetStart() > start; });
+    unhandled_.insert(it, interval);
+}
+
+// Intervals that ended are dropped; the others move between active and inactive depending on
+// whether `position` falls into one of their ranges or into a lifetime hole.
+void RegisterAllocator::UpdateActiveAndInactive(uint32_t position) {
+    std::vector<LiveInterval *> still_active;
+    std::vector<LiveInterval *> still_inactive;
+    for (auto *interval : active_) {
+        if (interval->GetEnd() <= position) {
+            continue;
+        }
+        (interval->IsLiveAt(position) ? still_active : still_inactive).push_back(interval);
     }
-    auto reg = *free_regs_.begin();
-    free_regs_.erase(free_regs_.begin());
+    for (auto *interval : inactive_) {
+        if (interval->GetEnd() <= position) {
+            continue;
+        }
+        (interval->IsLiveAt(position) ? still_active : still_inactive).push_back(interval);
+    }
+    active_ = std::move(still_active);
+    inactive_ = std::move(still_inactive);
+}
 
-    current->GetInstruction()->SetLocation(Location::MakeRegister(reg));
+static uint32_t GetRegister(const LiveInterval *interval) {
+    return static_cast<uint32_t>(interval->GetLocation().GetValue());
+}
 
-    SortedInsert(active_, current);
+// The first hinted register of the value of `current` that is free up to `needed_until`.
+uint32_t RegisterAllocator::GetRegisterHint(const LiveInterval *current, uint32_t needed_until) const {
+    for (const auto &hint : hints_[current->GetInstruction()]) {
+        uint32_t reg = hint.reg;
+        if (hint.value != nullptr) {
+            Location location = GetLocationAt(hint.value, hint.position);
+            reg = location.GetKind() == Location::REGISTER ? location.GetValue() : NO_HINT;
+        }
+        if (reg < num_regs_ && reg_positions_[reg] >= needed_until) {
+            return reg;
+        }
+    }
+    return NO_HINT;
 }
 
-void RegisterAllocator::RewriteAndInsertSpillFill() {
-    IRBuilder builder(graph_);
-    ResolvePhis(builder);
-    SpillFillInstructions(builder);
+// Operands of the first instruction of a block are live at the instruction itself, as there is no
+// gap before it. Where that use ends a range of the operand, the instruction can still write its
+// result into the operand's register, since it reads its operands first. Returns the position up
+// to which the register is then free for `current`, or 0 if it is not.
+static uint32_t GetFreeAfterLastUse(const LiveInterval *operand, const LiveInterval *current) {
+    Instruction *inst = current->GetInstruction();
+    uint32_t position = current->GetStart();
+    if (current->GetSplitParent() != current || inst->GetOpcode() == Opcode::PHI ||
+        operand->IsLiveAt(position + 1)) {
+        return 0;
+    }
+    const auto &inputs = inst->GetInputs();
+    if (std::find(inputs.begin(), inputs.end(), operand->GetInstruction()) == inputs.end()) {
+        return 0;
+    }
+    uint32_t free_until = LiveInterval::INVALID_POSITION;
+    for (const auto &range : operand->GetRanges()) {
+        for (const auto &other : current->GetRanges()) {
+            if (range.start > position && range.Intersects(other)) {
+                free_until = std::min(free_until, std::max(range.start, other.start));
+            }
+        }
+    }
+    return free_until;
 }
 
-void RegisterAllocator::ResolvePhis(IRBuilder &builder) {
-    for (auto &block : graph_->GetBlocks()) {
-        auto *terminator = block.GetLastInstruction();
-        if (!terminator)
+// Takes the register that stays free the longest. Registers of inactive intervals count as free
+// up to the point where that interval intersects `current` again. If the register is taken before
+// `current` ends, `current` keeps it up to a split position and the rest is allocated later.
+bool RegisterAllocator::TryAllocateFreeRegister(LiveInterval *current) {
+    std::fill(reg_positions_.begin(), reg_positions_.end(), LiveInterval::INVALID_POSITION);
+    for (auto *interval : active_) {
+        uint32_t &free_until = reg_positions_[GetRegister(interval)];
+        free_until = std::min(free_until, GetFreeAfterLastUse(interval, current));
+    }
+    for (auto *interval : inactive_) {
+        uint32_t &free_until = reg_positions_[GetRegister(interval)];
+        free_until = std::min(free_until, interval->FirstIntersection(*current));
+    }
+
+    uint32_t reg = std::max_element(reg_positions_.begin(), reg_positions_.end()) - reg_positions_.begin();
+    uint32_t free_until = reg_positions_[reg];
+    if (free_until <= current->GetStart()) {
+        return false;
+    }
+    // A hinted register is as good as any if it is free for as long as `current` needs one.
+    uint32_t hint = use_hints_ ? GetRegisterHint(current, std::min(free_until, current->GetEnd())) : NO_HINT;
+    if (hint != NO_HINT) {
+        reg = hint;
+        free_until = reg_positions_[reg];
+    }
+    if (free_until < current->GetEnd()) {
+        uint32_t split_pos = FindSplitPosition(current->GetStart() + 1, free_until);
+        if (split_pos == LiveInterval::INVALID_POSITION) {
+            return false;
+        }
+        AddUnhandled(current->SplitAt(split_pos));
+    }
+    current->SetLocation(Location::MakeRegister(reg));
+    active_.push_back(current);
+    return true;
+}
+
+// Every register is taken at the start of `current`. One register is freed by spilling the
+// intervals holding it, chosen by the spill heuristic, unless spilling `current` is no worse; then
+// `current` goes to the stack until shortly before its first use. A constant always yields, since
+// creating it again at the use is cheaper than moving any other value to the stack.
+void RegisterAllocator::AllocateBlockedRegister(LiveInterval *current) {
+    uint32_t position = current->GetStart();
+    std::fill(reg_positions_.begin(), reg_positions_.end(), LiveInterval::INVALID_POSITION);
+    std::fill(reg_weights_.begin(), reg_weights_.end(), 0.0);
+    auto add_holder = [&](LiveInterval *interval) {
+        uint32_t reg = GetRegister(interval);
+        reg_positions_[reg] = std::min(reg_positions_[reg], interval->GetNextUse(position));
+        if (spill_heuristic_ == SpillHeuristic::SPILL_WEIGHT) {
+            reg_weights_[reg] += GetSpillWeight(interval, position);
+        }
+    };
+    for (auto *interval : active_) {
+        add_holder(interval);
+    }
+    for (auto *interval : inactive_) {
+        if (interval->Intersects(*current)) {
+            add_holder(interval);
+        }
+    }
+
+    // Equal weights fall back to the furthest next use, and on a tie there too `current` yields:
+    // a part that was split off a spilled interval needs no store.
+    uint32_t reg = 0;
+    for (uint32_t other = 1; other < num_regs_; ++other) {
+        if (reg_weights_[other] < reg_weights_[reg] ||
+            (reg_weights_[other] == reg_weights_[reg] && reg_positions_[other] > reg_positions_[reg])) {
+            reg = other;
+        }
+    }
+    uint32_t first_use = current->GetNextUse(position);
+    double current_weight = spill_heuristic_ == SpillHeuristic::SPILL_WEIGHT ? GetSpillWeight(current, position) : 0;
+    bool spill_current = current_weight < reg_weights_[reg];
+    if (current_weight == reg_weights_[reg]) {
+        spill_current = first_use == LiveInterval::INVALID_POSITION || reg_positions_[reg] <= first_use;
+    }
+    if (IsRematerializable(current->GetInstruction())) {
+        spill_current = true;
+    }
+    if (spill_current) {
+        Spill(current);
+        SplitBeforeNextUse(current, position);
+        return;
+    }
+
+    for (auto *list : {&active_, &inactive_}) {
+        auto evicted = std::stable_partition(list->begin(), list->end(), [&](auto *interval) {
+            return GetRegister(interval) != reg || !interval->Intersects(*current);
+        });
+        std::vector<LiveInterval *> spilled(evicted, list->end());
+        list->erase(evicted, list->end());
+        for (auto *interval : spilled) {
+            SpillFrom(interval, position);
+        }
+    }
+    current->SetLocation(Location::MakeRegister(reg));
+    active_.push_back(current);
+}
+
+// Frees the register of `interval` from `position` on: the interval keeps it up to a split
+// position, preferably after its last use before `position`, and the rest goes to the stack.
+void RegisterAllocator::SpillFrom(LiveInterval *interval, uint32_t position) {
+    uint32_t min_pos = interval->GetStart() + 1;
+    uint32_t split_pos = LiveInterval::INVALID_POSITION;
+    const auto &uses = interval->GetUsePositions();
+    auto next_use = std::lower_bound(uses.begin(), uses.end(), position);
+    if (next_use != uses.begin()) {
+        split_pos = FindSplitPosition(std::max(min_pos, *std::prev(next_use) + 1), position);
+    }
+    if (split_pos == LiveInterval::INVALID_POSITION) {
+        split_pos = FindSplitPosition(min_pos, position);
+    }
+    // Keeping the register from the start of the block up to a split without a use in between
+    // only makes the incoming edges move the value into it.
+    if (split_pos != LiveInterval::INVALID_POSITION) {
+        uint32_t block_from = GetBlockAt(split_pos).from;
+        auto use = std::lower_bound(uses.begin(), uses.end(), block_from);
+        if (block_from >= min_pos && (use == uses.end() || *use >= split_pos)) {
+            split_pos = block_from;
+        }
+    }
+
+    LiveInterval *spilled = interval;
+    if (split_pos != LiveInterval::INVALID_POSITION) {
+        spilled = interval->SplitAt(split_pos);
+    }
+    Spill(spilled);
+    SplitBeforeNextUse(spilled, position);
+}
+
+// Uses of a spilled interval are served from the stack by reloads into the reserved registers.
+// The part from the first use that can be split off after `position` gets a new chance at a register.
+void RegisterAllocator::SplitBeforeNextUse(LiveInterval *spilled, uint32_t position) {
+    uint32_t min_pos = std::max(spilled->GetStart(), position) + 1;
+    for (uint32_t use : spilled->GetUsePositions()) {
+        if (use < min_pos) {
             continue;
+        }
+        uint32_t split_pos = FindSplitPosition(min_pos, use);
+        if (split_pos != LiveInterval::INVALID_POSITION) {
+            AddUnhandled(spilled->SplitAt(split_pos));
+            return;
+        }
+    }
+}
 
-        for (auto *succ : block.GetSuccessors()) {
-            if (succ->GetFirstInstruction() == nullptr || succ->GetFirstInstruction()->GetOpcode() != Opcode::PHI) {
-                continue;
+void RegisterAllocator::Spill(LiveInterval *interval) {
+    if (IsRematerializable(interval->GetInstruction())) {
+        interval->SetLocation(Location::MakeConstant());
+        return;
+    }
+    Instruction *value = interval->GetInstruction();
+    if (spill_slots_[value].GetKind() == Location::UNASSIGNED) {
+        spill_slots_[value] = AssignStackSlot(interval->GetSplitParent());
+    }
+    interval->SetLocation(spill_slots_[value]);
+}
+
+// A constant can be created again at each use for no more than a reload would cost, and then
+// needs neither a stack slot nor a store.
+bool RegisterAllocator::IsRematerializable(const Instruction *value) const {
+    return rematerialize_ && value->GetOpcode() == Opcode::Constant;
+}
+
+// Stack slots are shared like registers: a value takes a slot of its size whose earlier values are
+// not live anywhere in its lifetime. The lifetime covers all parts of the value, as the slot may be
+// written once at the definition and read by any part that is on the stack.
+Location RegisterAllocator::AssignStackSlot(const LiveInterval *parent) {
+    LiveInterval lifetime(nullptr);
+    for (const auto &range : parent->GetRanges()) {
+        lifetime.AddRange(range.start, range.end);
+    }
+    for (const auto &child : parent->GetSplitChildren()) {
+        for (const auto &range : child->GetRanges()) {
+            lifetime.AddRange(range.start, range.end);
+        }
+    }
+
+    uint32_t size = std::max(GetTypeSize(parent->GetInstruction()->GetType()), 1U);
+    for (auto &slot : stack_slots_) {
+        if (slot.size == size && !slot.occupied.Intersects(lifetime)) {
+            for (const auto &range : lifetime.GetRanges()) {
+                slot.occupied.AddRange(range.start, range.end);
             }
+            return slot.location;
+        }
+    }
 
-            builder.SetInsertPoint(terminator);
+    // Slots are aligned to their size and grow the frame downwards.
+    stack_offset_ = (stack_offset_ + 2 * size - 1) / size * size;
+    auto &slot = stack_slots_.emplace_back(StackSlot{Location::MakeStack(-static_cast<int32_t>(stack_offset_)), size,
+                                                     std::move(lifetime)});
+    return slot.location;
+}
 
-            size_t pred_idx = -1;
-            const auto &succ_preds = succ->GetPredecessors();
-            for (size_t i = 0; i < succ_preds.size(); ++i) {
-                if (succ_preds[i] == &block) {
-                    pred_idx = i;
-                    break;
-                }
+// What keeping `interval` on the stack from `position` on would cost: each remaining use, including
+// the moves into phis at the end of predecessors, weighted by how often its block runs.
+// Constants cost half as much, as they are re-created where needed and never stored.
+double RegisterAllocator::GetSpillCost(const LiveInterval *interval, uint32_t position) const {
+    double cost = 0;
+    const auto &uses = interval->GetUsePositions();
+    for (auto use = std::lower_bound(uses.begin(), uses.end(), position); use != uses.end(); ++use) {
+        cost += GetBlockWeight(GetBlockAt(*use).loop_depth);
+    }
+    for (uint32_t use : phi_uses_[interval->GetInstruction()]) {
+        if (use >= position && interval->IsLiveAt(use)) {
+            cost += GetBlockWeight(GetBlockAt(use).loop_depth);
+        }
+    }
+    if (IsRematerializable(interval->GetInstruction())) {
+        cost /= 2;
+    }
+    return cost;
+}
+
+// The spill cost per position of the remaining lifetime, so long intervals with few uses go first.
+double RegisterAllocator::GetSpillWeight(const LiveInterval *interval, uint32_t position) const {
+    return GetSpillCost(interval, position) / (interval->GetEnd() - position);
+}
+
+// Intervals that are live at the same position interfere and need different registers; a phi and
+// its inputs, and the two sides of a MoveInst, are connected by moves. Intervals are never split:
+// a spilled value lives on the stack for its whole lifetime and is reloaded into a reserved register
+// at each use, so there is no need to build and color the graph again after spilling.
+bool RegisterAllocator::ColorIntervals() {
+    constexpr uint32_t NO_NODE = UINT32_MAX;
+    InstMap<uint32_t> nodes(graph_->GetInstIdLimit(), NO_NODE);
+    for (size_t i = 0; i < intervals_.size(); ++i) {
+        nodes[intervals_[i]->GetInstruction()] = static_cast<uint32_t>(i);
+    }
+
+    GraphColoring coloring(static_cast<uint32_t>(intervals_.size()));
+    std::vector<uint32_t> live;
+    for (uint32_t i = 0; i < intervals_.size(); ++i) {
+        LiveInterval *current = intervals_[i];
+        std::erase_if(live, [&](uint32_t node) { return intervals_[node]->GetEnd() <= current->GetStart(); });
+        for (uint32_t node : live) {
+            if (intervals_[node]->Intersects(*current)) {
+                coloring.AddInterference(node, i);
             }
-            if (pred_idx == (size_t)-1)
+        }
+        live.push_back(i);
+        // A spilled value is also stored once, after its definition.
+        double store_cost = IsRematerializable(current->GetInstruction())
+                                ? 0
+                                : GetBlockWeight(GetBlockAt(current->GetStart()).loop_depth);
+        coloring.SetSpillCost(i, GetSpillCost(current, current->GetStart()) + store_cost);
+    }
+
+    for (uint32_t i = 0; i < intervals_.size(); ++i) {
+        Instruction *inst = intervals_[i]->GetInstruction();
+        if (inst->GetOpcode() != Opcode::PHI && inst->GetOpcode() != Opcode::MOVE) {
+            continue;
+        }
+        for (auto *input : inst->GetInputs()) {
+            uint32_t node = input != nullptr ? std::as_const(nodes)[input] : NO_NODE;
+            if (node != NO_NODE) {
+                coloring.AddMove(i, node);
+            }
+        }
+    }
+
+    if (!coloring.Run(num_regs_) && num_reserved_regs_ == 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < intervals_.size(); ++i) {
+        uint32_t color = coloring.GetColor(i);
+        if (color == GraphColoring::SPILLED) {
+            Spill(intervals_[i]);
+        } else {
+            intervals_[i]->SetLocation(Location::MakeRegister(color));
+        }
+    }
+    return true;
+}
+
+// Intervals can be split at the start of a block, where edge moves reconcile the locations, and
+// at the gap before any non-phi instruction but the last one of a block, where the move goes in
+// front of that instruction. Among the positions in [min_pos, max_pos], a block start at the
+// lowest loop depth wins if it is outside the loop of max_pos; otherwise the latest one is taken.
+uint32_t RegisterAllocator::FindSplitPosition(uint32_t min_pos, uint32_t max_pos) const {
+    if (min_pos > max_pos) {
+        return LiveInterval::INVALID_POSITION;
+    }
+
+    size_t last = &GetBlockAt(max_pos) - blocks_.data();
+    const BlockPositions &block = blocks_[last];
+    const BlockPositions *shallowest = &block;
+    for (size_t i = last; i > 0 && blocks_[i - 1].from >= min_pos; --i) {
+        if (blocks_[i - 1].loop_depth < shallowest->loop_depth) {
+            shallowest = &blocks_[i - 1];
+        }
+    }
+    if (shallowest != &block) {
+        return shallowest->from;
+    }
+
+    if (block.to >= block.from + 2) {
+        uint32_t next_inst = std::min((max_pos + 1) & ~1U, block.to - 2);
+        if (next_inst >= std::max(block.body, block.from + 2) && next_inst - 1 >= min_pos) {
+            return next_inst - 1;
+        }
+    }
+    return block.from >= min_pos ? block.from : LiveInterval::INVALID_POSITION;
+}
+
+const RegisterAllocator::BlockPositions &RegisterAllocator::GetBlockAt(uint32_t pos) const {
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), pos,
+                               [](uint32_t p, const BlockPositions &block) { return p < block.from; });
+    return *std::prev(it);
+}
+
+// Instructions take the location of their whole interval; operands are then redirected to the
+// copy that holds the value where its interval is split, and the copies are inserted as parallel
+// moves: on block entry (for an edge out of a branch), at split positions inside the block, and
+// before the jump of the block (for an edge into a merge). Reloads for operands of values that
+// live on the stack as a whole come last.
+
+void RegisterAllocator::RewriteAndInsertSpillFill() {
+    stored_at_definition_.Reset(graph_->GetInstIdLimit());
+    copies_of_.Reset(graph_->GetInstIdLimit());
+    unpatched_inputs_.clear();
+    rematerialized_operands_.Reset(graph_->GetInstIdLimit());
+    for (auto *interval : intervals_) {
+        interval->GetInstruction()->SetLocation(interval->GetLocation());
+    }
+
+    std::vector<Instruction *> inst_at(blocks_.empty() ? 0 : blocks_.back().to / 2, nullptr);
+    for (auto &block : blocks_) {
+        uint32_t pos = block.from;
+        for (auto *inst = block.block->GetFirstInstruction(); inst; inst = inst->GetNext(), pos += 2) {
+            inst_at[pos / 2] = inst;
+        }
+    }
+
+    // Split children starting in a gap are entered by a copy in front of the next instruction.
+    std::vector<std::vector<Copy>> split_copies(inst_at.size());
+    for (auto *interval : intervals_) {
+        for (const auto &child : interval->GetSplitChildren()) {
+            uint32_t start = child->GetStart();
+            if (start % 2 == 0) {
                 continue;
+            }
+            Location from = interval->GetSplitChildAt(start - 1)->GetLocation();
+            if (from != child->GetLocation()) {
+                split_copies[(start + 1) / 2].push_back(
+                    {interval->GetInstruction(), from, child->GetLocation(), false});
+            }
+        }
+    }
 
-            struct Move {
-                Instruction *to_inst;
-                Instruction *from_inst;
-            };
-            std::list<Move> parallel_moves;
-            for (auto *inst = succ->GetFirstInstruction(); inst && inst->GetOpcode() == Opcode::PHI;
-                 inst = inst->GetNext()) {
-                auto *phi = static_cast<PhiInst *>(inst);
-                if (pred_idx < phi->GetInputs().size()) {
-                    Instruction *incoming_val = phi->GetInputs()[pred_idx];
-                    if (incoming_val) {
-                        auto to_loc = phi->GetLocation();
-                        auto from_loc = incoming_val->GetLocation();
-                        if (to_loc.GetKind() != from_loc.GetKind() || to_loc.GetValue() != from_loc.GetValue()) {
-                            parallel_moves.push_back({phi, incoming_val});
-                        }
-                    }
+    struct OperandUse {
+        Instruction *inst;
+        size_t index;
+        Location location;
+    };
+    std::vector<OperandUse> operand_uses;
+    for (auto &block : blocks_) {
+        for (uint32_t pos = block.body; pos < block.to; pos += 2) {
+            Instruction *inst = inst_at[pos / 2];
+            uint32_t use_pos = pos > block.from ? pos - 1 : pos;
+            for (size_t i = 0; i < inst->GetInputs().size(); ++i) {
+                Instruction *input = inst->GetInputs()[i];
+                if (input == nullptr) {
+                    continue;
+                }
+                Location location = GetLocationAt(input, use_pos);
+                if (location != input->GetLocation()) {
+                    operand_uses.push_back({inst, i, location});
                 }
             }
+        }
+    }
+
+    // Copies on the edge into a block with a single, branching predecessor go to the start of the
+    // block, those on the edge out of a block with a single successor before its terminator.
+    std::vector<std::vector<Copy>> entry_copies(blocks_.size());
+    std::vector<std::vector<Copy>> exit_copies(blocks_.size());
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        BasicBlock *bb = blocks_[i].block;
+        if (bb->GetPredecessors().size() == 1 && bb->GetPredecessors()[0]->GetSuccessors().size() > 1) {
+            entry_copies[i] = ResolveEdge(bb->GetPredecessors()[0], bb);
+        }
+        if (bb->GetSuccessors().size() == 1) {
+            exit_copies[i] = ResolveEdge(bb, bb->GetSuccessors()[0]);
+        }
+    }
 
-            if (parallel_moves.empty())
+    // A value goes into its stack slot either once after its definition, or wherever one of its
+    // parts moves from a register to the stack, whichever is executed less often.
+    InstMap<double> store_weights(graph_->GetInstIdLimit());
+    auto add_store_weights = [&](const std::vector<Copy> &copies, uint32_t loop_depth) {
+        for (const auto &copy : copies) {
+            if (!copy.defines_phi && copy.from.GetKind() == Location::REGISTER &&
+                copy.to.GetKind() == Location::STACK) {
+                store_weights[copy.value] += GetBlockWeight(loop_depth);
+            }
+        }
+    };
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        add_store_weights(entry_copies[i], blocks_[i].loop_depth);
+        add_store_weights(exit_copies[i], blocks_[i].loop_depth);
+        for (uint32_t pos = blocks_[i].from; pos < blocks_[i].to; pos += 2) {
+            add_store_weights(split_copies[pos / 2], blocks_[i].loop_depth);
+        }
+    }
+    for (auto &block : blocks_) {
+        for (uint32_t pos = block.from; pos < block.to; pos += 2) {
+            Instruction *inst = inst_at[pos / 2];
+            if (spill_slots_[inst].GetKind() == Location::UNASSIGNED) {
                 continue;
+            }
+            if (inst->GetLocation().GetKind() == Location::STACK ||
+                GetBlockWeight(block.loop_depth) <= store_weights[inst]) {
+                stored_at_definition_[inst] = 1;
+            }
+        }
+    }
 
-            std::list<Move> pending = parallel_moves;
-            std::list<Move> ready;
-
-            while (!pending.empty()) {
-                bool found_ready = false;
-                for (auto it = pending.begin(); it != pending.end();) {
-                    bool is_source = false;
-                    for (const auto &other : pending) {
-                        if (&(*it) != &other && it->to_inst == other.from_inst &&
-                            it->to_inst->GetLocation().GetKind() == Location::REGISTER) {
-                            is_source = true;
-                            break;
-                        }
-                    }
-                    if (!is_source) {
-                        ready.push_back(*it);
-                        it = pending.erase(it);
-                        found_ready = true;
-                    } else {
-                        ++it;
-                    }
-                }
+    IRBuilder builder(graph_);
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        const BlockPositions &block = blocks_[i];
+        if (!entry_copies[i].empty()) {
+            builder.SetInsertPoint(inst_at[block.body / 2]);
+            InsertParallelCopies(builder, std::move(entry_copies[i]), block.from, block.body);
+        }
+        for (uint32_t pos = block.from; pos < block.to; pos += 2) {
+            Instruction *inst = inst_at[pos / 2];
+            if (!split_copies[pos / 2].empty()) {
+                builder.SetInsertPoint(inst);
+                InsertParallelCopies(builder, std::move(split_copies[pos / 2]), pos - 2, pos);
+            }
+            if (std::as_const(stored_at_definition_)[inst] && inst->GetLocation().GetKind() == Location::REGISTER) {
+                builder.SetInsertPoint(inst_at[std::max(pos + 2, block.body) / 2]);
+                auto *store = builder.CreateStore(inst->GetType(), inst, inst);
+                store->SetLocation(spill_slots_[inst]);
+                copies_of_[inst].emplace_back(store->GetLocation(), store);
+            }
+        }
+        if (!exit_copies[i].empty()) {
+            builder.SetInsertPoint(block.block->GetLastInstruction());
+            InsertParallelCopies(builder, std::move(exit_copies[i]), block.to - std::min(block.to - block.from, 3U),
+                                 block.to - 1);
+        }
+    }
 
-                if (!found_ready) {
-                    auto &move_to_break = pending.front();
-                    auto *temp_load = builder.CreateMove(move_to_break.from_inst->GetType(), move_to_break.from_inst);
-                    temp_load->SetLocation(Location::MakeRegister(reserved_regs_start_));
-                    move_to_break.from_inst = temp_load;
-                    continue;
-                }
+    for (const auto &input : unpatched_inputs_) {
+        input.inst->SetInput(input.index, GetCopyIn(input.value, input.from));
+    }
+    for (const auto &use : operand_uses) {
+        if (use.location.GetKind() == Location::CONSTANT) {
+            rematerialized_operands_[use.inst].push_back(use.index);
+            continue;
+        }
+        use.inst->SetInput(use.index, GetCopyIn(use.inst->GetInputs()[use.index], use.location));
+    }
+
+    SpillFillInstructions(builder);
+}
+
+// Copies for the edge `pred` -> `succ`: values live into `succ` whose location changes along the
+// edge, and the phi inputs coming from `pred`.
+std::vector<RegisterAllocator::Copy> RegisterAllocator::ResolveEdge(BasicBlock *pred, BasicBlock *succ) const {
+    std::vector<Copy> copies;
+    auto pred_range = liveness_->GetBlockRange(pred);
+    if (pred_range.start == pred_range.end) {
+        return copies; // Not in the linear order
+    }
+    uint32_t pred_end = pred_range.end - 1;
+    uint32_t succ_start = liveness_->GetBlockRange(succ).start;
+
+    liveness_->GetLiveIn(succ).ForEachSetBit([&](size_t value_number) {
+        Instruction *value = liveness_->GetValue(value_number);
+        Location from = GetLocationAt(value, pred_end);
+        Location to = GetLocationAt(value, succ_start);
+        // Live sets spread over irreducible loops can name values that have no interval on the edge.
+        if (from != to && from.GetKind() != Location::UNASSIGNED && to.GetKind() != Location::UNASSIGNED) {
+            copies.push_back({value, from, to, false});
+        }
+    });
+
+    const auto &preds = succ->GetPredecessors();
+    size_t pred_idx = std::find(preds.begin(), preds.end(), pred) - preds.begin();
+    for (auto *inst = succ->GetFirstInstruction(); inst && inst->GetOpcode() == Opcode::PHI; inst = inst->GetNext()) {
+        if (pred_idx >= inst->GetInputs().size() || inst->GetInputs()[pred_idx] == nullptr) {
+            continue;
+        }
+        Instruction *input = inst->GetInputs()[pred_idx];
+        Location from = GetLocationAt(input, pred_end);
+        if (from != inst->GetLocation()) {
+            copies.push_back({input, from, inst->GetLocation(), true});
+        }
+    }
+    return copies;
+}
+
+// Sequences copies that happen at once: a copy may run when no other pending copy still reads its
+// destination. When only cycles are left, two registers of a cycle swap their contents, which puts
+// one value in place per swap. Cycles through stack slots instead move one source aside into a
+// register that is free across [from, to], or else into a reserved one.
+void RegisterAllocator::InsertParallelCopies(IRBuilder &builder, std::vector<Copy> copies, uint32_t from,
+                                             uint32_t to) {
+    struct PendingCopy {
+        Copy copy;
+        // Instruction to copy from, or nullptr while it is found only once every copy exists.
+        Instruction *source;
+    };
+    std::vector<PendingCopy> pending;
+    for (const auto &copy : copies) {
+        // A stack slot written at the definition already holds the value, and a constant needs no
+        // location to be created again from.
+        bool already_stored = !copy.defines_phi && copy.to.GetKind() == Location::STACK &&
+                              std::as_const(stored_at_definition_)[copy.value];
+        if (copy.from != copy.to && !already_stored && copy.to.GetKind() != Location::CONSTANT) {
+            pending.push_back({copy, nullptr});
+        }
+    }
+
+    // Destinations of copies already made hold their values from here on.
+    auto find_scratch = [&](uint32_t reserved) {
+        std::vector<Location> taken;
+        for (const auto &copy : copies) {
+            taken.push_back(copy.to);
+        }
+        for (const auto &other : pending) {
+            taken.push_back(other.copy.from);
+            taken.push_back(other.copy.to);
+        }
+        return FindScratchRegister(from, to, taken, reserved);
+    };
+    auto complete = [&](const Copy &copy, Instruction *copy_inst) {
+        if (copy.defines_phi) {
+            return;
+        }
+        auto &copies_of_value = copies_of_[copy.value];
+        if (std::none_of(copies_of_value.begin(), copies_of_value.end(),
+                         [&](const auto &entry) { return entry.first == copy.to; })) {
+            copies_of_value.emplace_back(copy.to, copy_inst);
+        }
+    };
+    // The instruction holding the value a pending copy reads; recorded for patching if not known yet.
+    auto source_of = [&](const PendingCopy &pending_copy, Instruction *reader, size_t index) {
+        if (pending_copy.source == nullptr) {
+            unpatched_inputs_.push_back({reader, index, pending_copy.copy.value, pending_copy.copy.from});
+        }
+        return pending_copy.source != nullptr ? pending_copy.source : pending_copy.copy.value;
+    };
+
+    while (!pending.empty()) {
+        auto ready = std::find_if(pending.begin(), pending.end(), [&](const PendingCopy &candidate) {
+            return std::none_of(pending.begin(), pending.end(),
+                                [&](const PendingCopy &other) { return other.copy.from == candidate.copy.to; });
+        });
+        if (ready != pending.end()) {
+            // The first reserved register may hold a value moved aside to break a cycle.
+            Location scratch;
+            if (ready->copy.from.GetKind() != Location::REGISTER && ready->copy.to.GetKind() == Location::STACK) {
+                scratch = find_scratch(reserved_regs_start_ + 1);
+            }
+            complete(ready->copy, CreateCopy(builder, ready->copy, ready->source, scratch));
+            pending.erase(ready);
+            continue;
+        }
 
-                for (const auto &move : ready) {
-                    auto *new_move = builder.CreateMove(move.from_inst->GetType(), move.from_inst);
-                    new_move->SetLocation(move.to_inst->GetLocation());
+        auto swappable = std::find_if(pending.begin(), pending.end(), [](const PendingCopy &candidate) {
+            return candidate.copy.from.GetKind() == Location::REGISTER &&
+                   candidate.copy.to.GetKind() == Location::REGISTER;
+        });
+        if (swappable != pending.end()) {
+            Copy done = swappable->copy;
+            auto reader = std::find_if(pending.begin(), pending.end(),
+                                       [&](const PendingCopy &other) { return other.copy.from == done.to; });
+            Instruction *displaced = reader->copy.value;
+            auto *swap = builder.CreateSwap(done.value->GetType(), done.value, displaced);
+            swap->SetInput(0, source_of(*swappable, swap, 0));
+            swap->SetInput(1, source_of(*reader, swap, 1));
+            swap->SetLocation(done.to);
+            auto *second_half = builder.CreateSwapSecondHalf(displaced->GetType(), swap);
+            second_half->SetLocation(done.from);
+            complete(done, swap);
+            pending.erase(swappable);
+
+            // Whatever was read from either register is now found in the other one.
+            for (auto &other : pending) {
+                if (other.copy.from == done.from) {
+                    other.copy.from = done.to;
+                    other.source = swap;
+                } else if (other.copy.from == done.to) {
+                    other.copy.from = done.from;
+                    other.source = second_half;
                 }
-                ready.clear();
             }
+            std::erase_if(pending, [&](const PendingCopy &other) {
+                if (other.copy.from != other.copy.to) {
+                    return false;
+                }
+                complete(other.copy, other.source);
+                return true;
+            });
+            continue;
+        }
+
+        PendingCopy &blocked = pending.front();
+        Copy aside = blocked.copy;
+        aside.to = find_scratch(reserved_regs_start_);
+        blocked.source = CreateCopy(builder, aside, blocked.source, Location());
+        blocked.copy.from = aside.to;
+    }
+}
+
+// A register that holds no value live in [from, to] and is not taken, or else the reserved one.
+Location RegisterAllocator::FindScratchRegister(uint32_t from, uint32_t to, const std::vector<Location> &taken,
+                                                uint32_t reserved) const {
+    LiveInterval span(nullptr);
+    span.AddRange(from, to + 1);
+    std::vector<bool> busy(num_regs_, false);
+    for (const auto &location : taken) {
+        if (location.GetKind() == Location::REGISTER && static_cast<uint32_t>(location.GetValue()) < num_regs_) {
+            busy[location.GetValue()] = true;
+        }
+    }
+    auto mark = [&](const LiveInterval *interval) {
+        if (interval->GetLocation().GetKind() == Location::REGISTER && interval->Intersects(span)) {
+            busy[GetRegister(interval)] = true;
+        }
+    };
+    for (auto *interval : intervals_) {
+        mark(interval);
+        for (const auto &child : interval->GetSplitChildren()) {
+            mark(child.get());
+        }
+    }
+    auto free = std::find(busy.begin(), busy.end(), false);
+    if (free != busy.end()) {
+        return Location::MakeRegister(static_cast<int32_t>(free - busy.begin()));
+    }
+    if (reserved >= reserved_regs_start_ + num_reserved_regs_) {
+        throw std::runtime_error("No scratch register for a move through the stack.");
+    }
+    return Location::MakeRegister(static_cast<int32_t>(reserved));
+}
+
+// Copies from the stack or from a constant into a stack slot go through `scratch`.
+Instruction *RegisterAllocator::CreateCopy(IRBuilder &builder, const Copy &copy, Instruction *source,
+                                           Location scratch) {
+    Instruction *input = source != nullptr ? source : copy.value;
+    Type type = copy.value->GetType();
+    Instruction *copy_inst;
+    Instruction *reads_source = nullptr;
+    if (copy.from.GetKind() == Location::CONSTANT) {
+        copy_inst = Rematerialize(builder, copy.value);
+        if (copy.to.GetKind() == Location::STACK) {
+            copy_inst->SetLocation(scratch);
+            copy_inst = builder.CreateStore(type, copy_inst, copy_inst);
+        }
+    } else if (copy.from.GetKind() == Location::STACK) {
+        auto *load = builder.CreateLoad(type, input);
+        reads_source = load;
+        copy_inst = load;
+        if (copy.to.GetKind() == Location::STACK) {
+            load->SetLocation(scratch);
+            copy_inst = builder.CreateStore(type, load, load);
+        }
+    } else if (copy.to.GetKind() == Location::STACK) {
+        copy_inst = builder.CreateStore(type, input, input);
+        reads_source = copy_inst;
+    } else {
+        copy_inst = builder.CreateMove(type, input);
+        reads_source = copy_inst;
+    }
+    copy_inst->SetLocation(copy.to);
+    if (source == nullptr && reads_source != nullptr) {
+        for (size_t i = 0; i < reads_source->GetInputs().size(); ++i) {
+            unpatched_inputs_.push_back({reads_source, i, copy.value, copy.from});
+        }
+    }
+    return copy_inst;
+}
+
+Instruction *RegisterAllocator::Rematerialize(IRBuilder &builder, Instruction *value) {
+    ++num_rematerializations_;
+    return builder.CreateConstant(value->GetType(), static_cast<ConstantInst *>(value)->GetValue());
+}
+
+Location RegisterAllocator::GetLocationAt(Instruction *value, uint32_t pos) const {
+    LiveInterval *interval = liveness_->GetLiveInterval(value);
+    LiveInterval *child = interval != nullptr ? interval->GetSplitChildAt(pos) : nullptr;
+    return child != nullptr ? child->GetLocation() : Location();
+}
+
+Instruction *RegisterAllocator::GetCopyIn(Instruction *value, Location location) const {
+    if (location == value->GetLocation() || location.GetKind() == Location::UNASSIGNED) {
+        return value;
+    }
+    for (const auto &[copy_location, copy_inst] : copies_of_[value]) {
+        if (copy_location == location) {
+            return copy_inst;
         }
     }
+    throw std::runtime_error("No copy of i" + std::to_string(value->GetId()) + " reaches its location.");
 }
 
 void RegisterAllocator::SpillFillInstructions(IRBuilder &builder) {
@@ -213,7 +1030,8 @@ void RegisterAllocator::SpillFillInstructions(IRBuilder &builder) {
     }
 
     for (auto *inst : all_instructions) {
-        if (inst->GetOpcode() == Opcode::PHI) {
+        // Loads of resolution moves read the stack slot on purpose.
+        if (inst->GetOpcode() == Opcode::PHI || inst->GetOpcode() == Opcode::LOAD) {
             continue;
         }
         SpillFillForInstruction(inst, builder);
@@ -222,9 +1040,17 @@ void RegisterAllocator::SpillFillInstructions(IRBuilder &builder) {
 
 void RegisterAllocator::SpillFillForInstruction(Instruction *inst, IRBuilder &builder) {
     std::vector<std::pair<size_t, Instruction *>> spilled_inputs;
+    // Read-only, so that instructions created since the table was sized do not grow it.
+    const auto &rematerialized = std::as_const(rematerialized_operands_)[inst];
     for (size_t i = 0; i < inst->GetInputs().size(); ++i) {
-        if (inst->GetInputs()[i] && inst->GetInputs()[i]->GetLocation().GetKind() == Location::STACK) {
-            spilled_inputs.emplace_back(i, inst->GetInputs()[i]);
+        Instruction *input = inst->GetInputs()[i];
+        if (input == nullptr) {
+            continue;
+        }
+        auto kind = input->GetLocation().GetKind();
+        if (kind == Location::STACK || kind == Location::CONSTANT ||
+            std::find(rematerialized.begin(), rematerialized.end(), i) != rematerialized.end()) {
+            spilled_inputs.emplace_back(i, input);
         }
     }
 
@@ -241,7 +1067,9 @@ void RegisterAllocator::SpillFillForInstruction(Instruction *inst, IRBuilder &bu
             if (reloads.count(original_input)) {
                 reloaded_val = reloads.at(original_input);
             } else {
-                reloaded_val = builder.CreateLoad(original_input->GetType(), original_input);
+                reloaded_val = original_input->GetLocation().GetKind() == Location::STACK
+                                   ? builder.CreateLoad(original_input->GetType(), original_input)
+                                   : Rematerialize(builder, original_input);
                 reloaded_val->SetLocation(Location::MakeRegister(reserved_regs_start_ + reserved_idx++));
                 reloads[original_input] = reloaded_val;
             }
@@ -1,37 +1,189 @@
 #pragma once
 
 #include "ir/analysis/liveness_analyzer.h"
+#include "ir/analysis/side_table.h"
 #include "ir/graph.h"
 #include "ir/ir_builder.h"
-#include <set>
 #include <vector>
 
 namespace opt {
 
+enum class SpillHeuristic {
+    // Frees the register whose holders are needed again the latest, however often they are used.
+    FURTHEST_USE,
+    // Frees the register whose holders have the lowest spill weight: their remaining uses, each
+    // counted with the estimated execution frequency of its block, per position of lifetime left.
+    SPILL_WEIGHT,
+};
+
+enum class AllocationMode {
+    // Linear scan over the live intervals of the whole graph, below.
+    LINEAR_SCAN,
+    // LocalRegisterAllocator: a single pass per block that keeps values crossing blocks on the stack.
+    // Much faster to run, for first-tier compiles whose code does not have to be the best.
+    BLOCK_LOCAL,
+    // Chaitin-Briggs coloring of the interference graph of the live intervals (see GraphColoring)
+    // in place of the linear scan; slower, for ahead-of-time compiles. Spilled values stay on the
+    // stack for their whole lifetime rather than being split around their uses.
+    GRAPH_COLORING,
+};
+
+// Linear scan over the live intervals of LivenessAnalyzer, following Wimmer's SSA linear scan:
+// intervals keep their lifetime holes, so a register held by an interval that is currently in a
+// hole (inactive) can be given to another interval that ends before the hole does. Intervals are
+// split when no register is free for their whole lifetime, so that a value can live in a register
+// around its uses and on the stack elsewhere; moves between the locations of the parts are then
+// inserted at the split positions and on the control-flow edges where the locations differ.
+// Critical edges are split first, so that every edge has a block of its own to hold its moves.
+// Constants are never stored: where they would live on the stack they are created again instead.
+// Registers are only reserved as scratch for reloads and stack-to-stack moves when some value has
+// to live on the stack; cycles of moves between registers are broken by swapping them.
+// A free register is chosen by hints where possible, so that a phi and its inputs, or the two
+// sides of a move, share a register and the move between them disappears.
 class RegisterAllocator {
   public:
-    RegisterAllocator(Graph *graph, uint32_t num_regs);
+    RegisterAllocator(Graph *graph, uint32_t num_regs, SpillHeuristic heuristic = SpillHeuristic::SPILL_WEIGHT);
+
+    void SetMode(AllocationMode mode) { mode_ = mode; }
+    AllocationMode GetMode() const { return mode_; }
+    void SetSpillHeuristic(SpillHeuristic heuristic) { spill_heuristic_ = heuristic; }
+    SpillHeuristic GetSpillHeuristic() const { return spill_heuristic_; }
+    // Register hints let a value take the register of a value it is moved from or to.
+    void SetUseHints(bool use_hints) { use_hints_ = use_hints; }
+    // Spilled constants are re-created where they are needed instead of being reloaded.
+    void SetRematerialize(bool rematerialize) { rematerialize_ = rematerialize; }
+    // Scratch registers are reserved before allocating, instead of only once some value is spilled.
+    void SetReserveScratchUpFront(bool up_front) { reserve_up_front_ = up_front; }
+
+    // Phi inputs and moves that needed no move instruction after the last Run, because the
+    // source and the destination got the same location.
+    uint32_t GetNumCoalescedMoves() const { return num_coalesced_moves_; }
+    // Constants created by the last Run in place of reloads from the stack.
+    uint32_t GetNumRematerializations() const { return num_rematerializations_; }
+    // Registers the last Run kept out of the allocation as scratch: none unless a value was spilled.
+    uint32_t GetNumReservedRegisters() const { return num_reserved_regs_; }
 
     void Run();
 
   private:
-    void ExpireOldIntervals(analysis::LiveInterval *current);
-    void SpillAtInterval(analysis::LiveInterval *current);
-    void AllocateRegister(analysis::LiveInterval *current);
+    // A copy of one value between two locations, executed as part of a parallel move.
+    struct Copy {
+        Instruction *value;
+        Location from;
+        Location to;
+        // Copies into a phi define the phi rather than a new location of `value`.
+        bool defines_phi;
+    };
+
+    // A register preferred by a value: a fixed one, or the one `value` has at `position`.
+    struct RegisterHint {
+        Instruction *value;
+        uint32_t position;
+        uint32_t reg;
+    };
+    static constexpr uint32_t NO_HINT = UINT32_MAX;
+
+    // Positions of a block in the linear order: [from, to), with the phis before `body`.
+    struct BlockPositions {
+        BasicBlock *block;
+        uint32_t from;
+        uint32_t body;
+        uint32_t to;
+        uint32_t loop_depth;
+    };
+
+    void ReserveRegisters(uint32_t num_reserved);
+    bool Allocate();
+    bool ColorIntervals();
+    void Reset();
+    void SplitCriticalEdges();
+    void NumberBlocks();
+    void CollectPhiUses();
+    void CollectRegisterHints();
+    void CountCoalescedMoves();
+
+    void AddUnhandled(analysis::LiveInterval *interval);
+    void UpdateActiveAndInactive(uint32_t position);
+    uint32_t GetRegisterHint(const analysis::LiveInterval *current, uint32_t needed_until) const;
+    bool TryAllocateFreeRegister(analysis::LiveInterval *current);
+    void AllocateBlockedRegister(analysis::LiveInterval *current);
+    void SpillFrom(analysis::LiveInterval *interval, uint32_t position);
+    void SplitBeforeNextUse(analysis::LiveInterval *spilled, uint32_t position);
+    void Spill(analysis::LiveInterval *interval);
+    bool IsRematerializable(const Instruction *value) const;
+    Location AssignStackSlot(const analysis::LiveInterval *parent);
+    double GetSpillCost(const analysis::LiveInterval *interval, uint32_t position) const;
+    double GetSpillWeight(const analysis::LiveInterval *interval, uint32_t position) const;
+    uint32_t FindSplitPosition(uint32_t min_pos, uint32_t max_pos) const;
+    const BlockPositions &GetBlockAt(uint32_t pos) const;
 
     void RewriteAndInsertSpillFill();
-    void ResolvePhis(IRBuilder &builder);
+    std::vector<Copy> ResolveEdge(BasicBlock *pred, BasicBlock *succ) const;
+    void InsertParallelCopies(IRBuilder &builder, std::vector<Copy> copies, uint32_t from, uint32_t to);
+    Location FindScratchRegister(uint32_t from, uint32_t to, const std::vector<Location> &taken,
+                                 uint32_t reserved) const;
+    Instruction *CreateCopy(IRBuilder &builder, const Copy &copy, Instruction *source, Location scratch);
+    Instruction *Rematerialize(IRBuilder &builder, Instruction *value);
+    Location GetLocationAt(Instruction *value, uint32_t pos) const;
+    Instruction *GetCopyIn(Instruction *value, Location location) const;
     void SpillFillInstructions(IRBuilder &builder);
     void SpillFillForInstruction(Instruction *inst, IRBuilder &builder);
 
     Graph *graph_;
-    uint32_t num_regs_;
-    uint32_t num_reserved_regs_ = 2;
+    analysis::LivenessAnalyzer *liveness_ = nullptr;
+    uint32_t num_total_regs_;
+    uint32_t num_regs_ = 0;
+    AllocationMode mode_ = AllocationMode::LINEAR_SCAN;
+    SpillHeuristic spill_heuristic_;
+    bool use_hints_ = true;
+    bool rematerialize_ = true;
+    bool reserve_up_front_ = false;
+    uint32_t num_coalesced_moves_ = 0;
+    uint32_t num_rematerializations_ = 0;
+    uint32_t num_reserved_regs_ = 0;
     uint32_t reserved_regs_start_ = 0;
     std::vector<analysis::LiveInterval *> intervals_;
+    // Intervals still to be allocated, sorted by decreasing start so the next one is at the back.
+    std::vector<analysis::LiveInterval *> unhandled_;
+    // Intervals holding a register that are live at the current position, and those in a lifetime hole.
     std::vector<analysis::LiveInterval *> active_;
-    std::set<uint32_t> free_regs_;
+    std::vector<analysis::LiveInterval *> inactive_;
+    // Scratch per register: position until which the register is free, or its next use.
+    std::vector<uint32_t> reg_positions_;
+    // Scratch per register: spill weight of the intervals that would have to give it up.
+    std::vector<double> reg_weights_;
+    std::vector<BlockPositions> blocks_;
+    // Positions at the end of the predecessors where a value is read by the moves into a phi.
+    InstMap<std::vector<uint32_t>> phi_uses_;
+    InstMap<std::vector<RegisterHint>> hints_;
+    // A stack slot and the positions where a value it holds is live.
+    struct StackSlot {
+        Location location;
+        uint32_t size;
+        analysis::LiveInterval occupied;
+    };
+
+    // All spilled parts of a value share one stack slot, keyed by the split parent's instruction.
+    InstMap<Location> spill_slots_;
+    std::vector<StackSlot> stack_slots_;
     uint32_t stack_offset_ = 0;
+    // Values whose stack slot is written right after their definition rather than by the copies
+    // that move them from a register to the stack.
+    InstMap<uint8_t> stored_at_definition_;
+
+    // After rewriting, the instruction that holds a value in each location other than its own.
+    InstMap<std::vector<std::pair<Location, Instruction *>>> copies_of_;
+    // Inputs of copies created before the copy of their source value existed, with the value and the
+    // location to read it from; patched once all copies are in place.
+    struct UnpatchedInput {
+        Instruction *inst;
+        size_t index;
+        Instruction *value;
+        Location from;
+    };
+    std::vector<UnpatchedInput> unpatched_inputs_;
+    // Operands read where their constant is held nowhere, by instruction; re-created in front of it.
+    InstMap<std::vector<size_t>> rematerialized_operands_;
 };
 
 } // namespace opt
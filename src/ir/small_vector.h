@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Vector of trivially copyable values that keeps up to N elements inline and
+// only spills to the heap beyond that. Used for instruction operands, where
+// almost every opcode has a fixed arity of at most two.
+template <typename T, size_t N> class SmallVector {
+    static_assert(std::is_trivially_copyable_v<T>, "SmallVector only holds trivially copyable values");
+
+  public:
+    using value_type = T;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    SmallVector() = default;
+    ~SmallVector() {
+        if (!IsInline()) {
+            delete[] data_;
+        }
+    }
+
+    SmallVector(const SmallVector &) = delete;
+    SmallVector &operator=(const SmallVector &) = delete;
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+    bool IsInline() const { return data_ == inline_; }
+
+    T *data() { return data_; }
+    const T *data() const { return data_; }
+
+    T &operator[](size_t idx) { return data_[idx]; }
+    const T &operator[](size_t idx) const { return data_[idx]; }
+    T &front() { return data_[0]; }
+    const T &front() const { return data_[0]; }
+    T &back() { return data_[size_ - 1]; }
+    const T &back() const { return data_[size_ - 1]; }
+
+    iterator begin() { return data_; }
+    iterator end() { return data_ + size_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+
+    void push_back(T value) {
+        if (size_ == capacity_) {
+            Grow(capacity_ * 2);
+        }
+        data_[size_++] = value;
+    }
+
+    void pop_back() { --size_; }
+
+    void resize(size_t new_size, T value = T()) {
+        if (new_size > capacity_) {
+            Grow(std::max<size_t>(new_size, capacity_ * 2));
+        }
+        for (size_t i = size_; i < new_size; ++i) {
+            data_[i] = value;
+        }
+        size_ = static_cast<uint32_t>(new_size);
+    }
+
+    void reserve(size_t new_capacity) {
+        if (new_capacity > capacity_) {
+            Grow(new_capacity);
+        }
+    }
+
+    void clear() { size_ = 0; }
+
+  private:
+    void Grow(size_t new_capacity) {
+        T *new_data = new T[new_capacity];
+        std::memcpy(static_cast<void *>(new_data), data_, size_ * sizeof(T));
+        if (!IsInline()) {
+            delete[] data_;
+        }
+        data_ = new_data;
+        capacity_ = static_cast<uint32_t>(new_capacity);
+    }
+
+    T *data_ = inline_;
+    uint32_t size_ = 0;
+    uint32_t capacity_ = N;
+    T inline_[N];
+};
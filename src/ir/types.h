@@ -10,6 +10,37 @@ enum class Type {
     U64,
 };
 
+// Bytes a value of the type takes in memory.
+constexpr uint32_t GetTypeSize(Type type) {
+    switch (type) {
+    case Type::VOID:
+        return 0;
+    case Type::BOOL:
+        return 1;
+    case Type::U32:
+    case Type::S32:
+        return 4;
+    case Type::U64:
+        return 8;
+    }
+    return 0;
+}
+
+// Keeps the bits of `value` that fit in a value of the type.
+constexpr uint64_t TruncateToType(uint64_t value, Type type) {
+    uint32_t bits = GetTypeSize(type) * 8;
+    return bits >= 64 ? value : value & ((uint64_t{1} << bits) - 1);
+}
+
+// The value of a cast of `value` from type `from` to type `to`. Only signed values are
+// sign-extended when widened.
+constexpr uint64_t FoldCastValue(uint64_t value, Type from, Type to) {
+    if (from == Type::S32) {
+        value = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(value)));
+    }
+    return TruncateToType(value, to);
+}
+
 enum class Opcode {
     Constant,
     Argument,
@@ -27,6 +58,7 @@ enum class Opcode {
     MOVE,
     LOAD,
     STORE,
+    SWAP,
     CALL_STATIC,
     NULL_CHECK,
     BOUNDS_CHECK,
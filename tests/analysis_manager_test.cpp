@@ -0,0 +1,78 @@
+#include "helpers/factorial_graph.h"
+#include "ir/analysis/analysis_manager.h"
+#include "ir/analysis/graph_analyzer.h"
+#include "ir/analysis/linear_order.h"
+#include "ir/analysis/liveness_analyzer.h"
+#include "ir/analysis/loop_analyzer.h"
+#include "ir/ir.h"
+#include "ir/opt/checks_elimination.h"
+#include "ir/opt/peephole_optimizer.h"
+#include "ir/opt/register_allocator.h"
+#include <gtest/gtest.h>
+
+TEST(AnalysisManager, CachesResults) {
+    Graph graph;
+    BuildFactorialGraph(&graph);
+    AnalysisManager &analyses = graph.GetAnalyses();
+
+    EXPECT_FALSE(analyses.IsValid(AnalysisKind::LIVENESS));
+    analysis::LivenessAnalyzer &liveness = analyses.GetLivenessAnalyzer();
+    EXPECT_TRUE(analyses.IsValid(AnalysisKind::DOMINATORS));
+    EXPECT_TRUE(analyses.IsValid(AnalysisKind::LOOPS));
+    EXPECT_TRUE(analyses.IsValid(AnalysisKind::LINEAR_ORDER));
+
+    EXPECT_EQ(&analyses.GetLivenessAnalyzer(), &liveness);
+    analyses.GetLoopAnalyzer();
+    analyses.GetLinearOrder();
+    EXPECT_EQ(analyses.GetComputeCount(AnalysisKind::DOMINATORS), 1);
+    EXPECT_EQ(analyses.GetComputeCount(AnalysisKind::LOOPS), 1);
+    EXPECT_EQ(analyses.GetComputeCount(AnalysisKind::LIVENESS), 1);
+
+    // The shared results agree with a standalone run.
+    analysis::LivenessAnalyzer standalone(&graph);
+    standalone.Analyze();
+    EXPECT_EQ(standalone.GetLinearOrder(), liveness.GetLinearOrder());
+}
+
+TEST(AnalysisManager, InvalidationDropsDependents) {
+    Graph graph;
+    BuildFactorialGraph(&graph);
+    AnalysisManager &analyses = graph.GetAnalyses();
+    analyses.GetLivenessAnalyzer();
+    analyses.GetBoundsAnalysis();
+
+    analyses.Invalidate(AnalysisKind::LOOPS);
+    EXPECT_TRUE(analyses.IsValid(AnalysisKind::DOMINATORS));
+    EXPECT_FALSE(analyses.IsValid(AnalysisKind::LOOPS));
+    // The linear order keeps loops contiguous, so it is rebuilt with them.
+    EXPECT_FALSE(analyses.IsValid(AnalysisKind::LINEAR_ORDER));
+    EXPECT_FALSE(analyses.IsValid(AnalysisKind::BOUNDS));
+    EXPECT_FALSE(analyses.IsValid(AnalysisKind::LIVENESS));
+
+    analyses.GetLivenessAnalyzer();
+    EXPECT_EQ(analyses.GetComputeCount(AnalysisKind::DOMINATORS), 1);
+    EXPECT_EQ(analyses.GetComputeCount(AnalysisKind::LOOPS), 2);
+    EXPECT_EQ(analyses.GetComputeCount(AnalysisKind::LINEAR_ORDER), 2);
+
+    analyses.KeepOnly({AnalysisKind::LOOPS, AnalysisKind::LIVENESS});
+    // Loops are built on top of the dominator tree, so they cannot outlive it.
+    EXPECT_FALSE(analyses.IsValid(AnalysisKind::DOMINATORS));
+    EXPECT_FALSE(analyses.IsValid(AnalysisKind::LOOPS));
+    EXPECT_FALSE(analyses.IsValid(AnalysisKind::LIVENESS));
+}
+
+TEST(AnalysisManager, PassesReuseControlFlowAnalyses) {
+    Graph graph;
+    BuildFactorialGraph(&graph);
+    AnalysisManager &analyses = graph.GetAnalyses();
+
+    opt::ChecksElimination(&graph).Run();
+    PeepholeOptimizer(&graph).Run();
+    opt::RegisterAllocator(&graph, 8).Run();
+
+    // No pass changed the CFG, so a single dominator tree and loop forest served all of them.
+    EXPECT_EQ(analyses.GetComputeCount(AnalysisKind::DOMINATORS), 1);
+    EXPECT_EQ(analyses.GetComputeCount(AnalysisKind::LOOPS), 1);
+    EXPECT_TRUE(analyses.IsValid(AnalysisKind::LOOPS));
+    EXPECT_FALSE(analyses.IsValid(AnalysisKind::LIVENESS));
+}
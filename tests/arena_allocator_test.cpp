@@ -0,0 +1,63 @@
+#include "ir/arena_allocator.h"
+#include "ir/ir.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <list>
+
+TEST(ArenaAllocator, AllocationsAreAligned) {
+    ArenaAllocator arena(256);
+
+    auto *c = arena.New<char>('x');
+    auto *d = arena.New<double>(1.5);
+    auto *u = arena.New<uint64_t>(42);
+
+    EXPECT_EQ(*c, 'x');
+    EXPECT_EQ(*d, 1.5);
+    EXPECT_EQ(*u, 42);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(d) % alignof(double), 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(u) % alignof(uint64_t), 0);
+    EXPECT_EQ(arena.GetChunkCount(), 1);
+}
+
+TEST(ArenaAllocator, GrowsByChunks) {
+    ArenaAllocator arena(128);
+
+    for (int i = 0; i < 64; ++i) {
+        arena.New<uint64_t>(i);
+    }
+    EXPECT_GT(arena.GetChunkCount(), 1);
+    EXPECT_GE(arena.GetAllocatedBytes(), 64 * sizeof(uint64_t));
+
+    // Requests larger than a chunk are served from a dedicated chunk.
+    auto *big = arena.AllocateArray<char>(1024);
+    ASSERT_NE(big, nullptr);
+    big[1023] = 1;
+}
+
+TEST(ArenaAllocator, StdAdapter) {
+    ArenaAllocator arena;
+    std::list<int, ArenaStdAllocator<int>> list{ArenaStdAllocator<int>(&arena)};
+    for (int i = 0; i < 10; ++i) {
+        list.push_back(i);
+    }
+    EXPECT_EQ(list.size(), 10);
+    EXPECT_EQ(list.back(), 9);
+    EXPECT_GT(arena.GetAllocatedBytes(), 0);
+}
+
+TEST(ArenaAllocator, GraphStorageComesFromArena) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    size_t initial = graph.GetArena()->GetAllocatedBytes();
+
+    auto *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+    auto *c1 = builder.CreateConstant(Type::U32, 1);
+    auto *c2 = builder.CreateConstant(Type::U32, 2);
+    auto *add = builder.CreateAdd(c1, c2);
+    builder.CreateRet(add);
+
+    EXPECT_GT(graph.GetArena()->GetAllocatedBytes(), initial);
+    EXPECT_EQ(c1->GetFirstUser()->GetUserInstruction(), add);
+    EXPECT_EQ(add->GetId(), 2);
+}
@@ -133,3 +133,74 @@ TEST(IRBuilder, PhiAddIncomingInvalidPredThrows) {
     auto *val = builder.CreateConstant(Type::U32, 0);
     ASSERT_THROW(phi->AddIncoming(val, entry_bb), std::runtime_error);
 }
+
+static bool IsBeforeByWalk(const Instruction *a, const Instruction *b) {
+    for (auto *curr = a->GetNext(); curr != nullptr; curr = curr->GetNext()) {
+        if (curr == b) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(BasicBlock, InstructionOrderSurvivesInserts) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *basic_block = graph.CreateBasicBlock();
+    builder.SetInsertPoint(basic_block);
+
+    auto *first = builder.CreateConstant(Type::U32, 0);
+    auto *last = builder.CreateConstant(Type::U32, 1);
+    builder.CreateRet(last);
+
+    // Keep inserting right after `first` until the gaps are exhausted and renumbering kicks in.
+    std::vector<Instruction *> insts;
+    for (int i = 0; i < 40; ++i) {
+        builder.SetInsertPoint(first->GetNext());
+        insts.push_back(builder.CreateConstant(Type::U32, i + 2));
+    }
+    builder.SetInsertPoint(basic_block);
+    auto *phi = builder.CreatePhi(Type::U32);
+    insts.push_back(phi);
+    insts.push_back(first);
+    insts.push_back(last);
+
+    for (auto *a : insts) {
+        for (auto *b : insts) {
+            EXPECT_EQ(basic_block->IsBefore(a, b), IsBeforeByWalk(a, b));
+        }
+    }
+
+    basic_block->EraseInstruction(insts[10]);
+    EXPECT_TRUE(basic_block->IsBefore(insts[11], insts[9]));
+    EXPECT_TRUE(basic_block->IsBefore(phi, first));
+}
+
+TEST(BasicBlock, SplitEdgeKeepsParallelEdgesApart) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *entry_bb = graph.CreateBasicBlock();
+    auto *merge_bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(entry_bb);
+    auto *cond = builder.CreateConstant(Type::BOOL, 1);
+    auto *branch = builder.CreateBranch(cond, merge_bb, merge_bb);
+
+    auto *false_edge = entry_bb->SplitEdge(1);
+    ASSERT_EQ(entry_bb->GetSuccessors().size(), 2);
+    EXPECT_EQ(entry_bb->GetSuccessors()[0], merge_bb);
+    EXPECT_EQ(entry_bb->GetSuccessors()[1], false_edge);
+    EXPECT_EQ(branch->GetTrueBB(), merge_bb);
+    EXPECT_EQ(branch->GetFalseBB(), false_edge);
+    // The second predecessor slot belonged to the false edge.
+    ASSERT_EQ(merge_bb->GetPredecessors().size(), 2);
+    EXPECT_EQ(merge_bb->GetPredecessors()[0], entry_bb);
+    EXPECT_EQ(merge_bb->GetPredecessors()[1], false_edge);
+
+    ASSERT_EQ(false_edge->GetPredecessors().size(), 1);
+    EXPECT_EQ(false_edge->GetPredecessors()[0], entry_bb);
+    ASSERT_EQ(false_edge->GetSuccessors().size(), 1);
+    EXPECT_EQ(false_edge->GetSuccessors()[0], merge_bb);
+    auto *jump = dynamic_cast<JumpInst *>(false_edge->GetFirstInstruction());
+    ASSERT_NE(jump, nullptr);
+    EXPECT_EQ(jump->GetTarget(), merge_bb);
+}
@@ -0,0 +1,55 @@
+#include "ir/bit_vector.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(BitVector, SetTestClear) {
+    BitVector bits(10);
+    EXPECT_EQ(bits.size(), 10);
+    EXPECT_FALSE(bits.Test(3));
+    bits.Set(3);
+    bits.Set(9);
+    EXPECT_TRUE(bits.Test(3));
+    EXPECT_TRUE(bits.Test(9));
+    EXPECT_FALSE(bits.Test(4));
+    bits.Clear(3);
+    EXPECT_FALSE(bits.Test(3));
+    EXPECT_FALSE(bits.Test(1000));
+}
+
+TEST(BitVector, GrowsOnSet) {
+    BitVector bits;
+    bits.Set(130);
+    EXPECT_EQ(bits.size(), 131);
+    EXPECT_TRUE(bits.Test(130));
+    EXPECT_FALSE(bits.Test(64));
+
+    bits.Resize(70);
+    bits.Resize(200);
+    EXPECT_FALSE(bits.Test(130));
+    bits.ClearAll();
+    EXPECT_FALSE(bits.Test(1));
+}
+
+TEST(BitVector, UnionAndIteration) {
+    BitVector a(100);
+    BitVector b(300);
+    a.Set(1);
+    a.Set(64);
+    b.Set(64);
+    b.Set(250);
+
+    EXPECT_TRUE(a.Union(b));
+    EXPECT_FALSE(a.Union(b));
+    EXPECT_EQ(a.size(), 300);
+    EXPECT_EQ(a.Count(), 3);
+
+    std::vector<size_t> bits;
+    a.ForEachSetBit([&](size_t idx) { bits.push_back(idx); });
+    EXPECT_EQ(bits, (std::vector<size_t>{1, 64, 250}));
+
+    a.Clear(250);
+    a.ShrinkToFit();
+    EXPECT_EQ(a.size(), 128);
+    EXPECT_TRUE(a.Test(64));
+    EXPECT_TRUE(a.Any());
+}
@@ -0,0 +1,148 @@
+#include "helpers/count_opcode.h"
+#include "helpers/factorial_graph.h"
+#include "ir/basic_block.h"
+#include "ir/graph.h"
+#include "ir/instruction.h"
+#include "ir/ir_builder.h"
+#include "ir/opt/constant_propagation.h"
+#include <gtest/gtest.h>
+
+using namespace opt;
+
+class ConstantPropagationTest : public ::testing::Test {
+  protected:
+    uint64_t ReturnedConstant(BasicBlock *bb) {
+        auto *ret = bb->GetLastInstruction();
+        EXPECT_EQ(ret->GetOpcode(), Opcode::RET);
+        auto *value = dynamic_cast<ConstantInst *>(ret->GetInputs()[0]);
+        EXPECT_NE(value, nullptr);
+        return value ? value->GetValue() : 0;
+    }
+};
+
+TEST_F(ConstantPropagationTest, FoldsArithmeticCompareAndCast) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+    auto *minus_one = builder.CreateConstant(Type::S32, 0xffffffff);
+    auto *one = builder.CreateConstant(Type::S32, 1);
+    auto *sum = builder.CreateAdd(minus_one, minus_one);
+    auto *shifted = builder.CreateShl(sum, one);
+    auto *wide = builder.CreateCast(Type::U64, shifted);
+    auto *signed_less = builder.CreateCmp(ConditionCode::LT, minus_one, one);
+    auto *unsigned_greater = builder.CreateCmp(ConditionCode::UGT, minus_one, one);
+    auto *both = builder.CreateAnd(signed_less, unsigned_greater);
+    auto *flag = builder.CreateCast(Type::U64, both);
+    builder.CreateRet(builder.CreateMul(wide, flag));
+
+    ConstantPropagation sccp(&graph);
+    sccp.Run();
+
+    // (-1 + -1) << 1 is -4 in 32 bits, sign-extended to 64.
+    EXPECT_EQ(ReturnedConstant(bb), static_cast<uint64_t>(-4));
+    EXPECT_EQ(sccp.GetNumFoldedValues(), 8);
+    EXPECT_EQ(CountOpcode(graph, Opcode::CMP), 0);
+}
+
+// The branch on a constant becomes a jump; the other arm is deleted, and with it the phi input
+// that made the result varying.
+TEST_F(ConstantPropagationTest, FoldsBranchAndRemovesDeadArm) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *arg = builder.CreateArgument(Type::U32);
+    auto *two = builder.CreateConstant(Type::U32, 2);
+    auto *cond = builder.CreateCmp(ConditionCode::LT, builder.CreateConstant(Type::U32, 1), two);
+    builder.CreateBranch(cond, bb1, bb2);
+
+    builder.SetInsertPoint(bb1);
+    auto *five = builder.CreateAdd(two, builder.CreateConstant(Type::U32, 3));
+    builder.CreateJump(bb3);
+
+    builder.SetInsertPoint(bb2);
+    auto *varying = builder.CreateMul(arg, two);
+    builder.CreateJump(bb3);
+
+    builder.SetInsertPoint(bb3);
+    auto *phi = builder.CreatePhi(Type::U32);
+    phi->AddIncoming(five, bb1);
+    phi->AddIncoming(varying, bb2);
+    builder.CreateRet(phi);
+
+    ConstantPropagation sccp(&graph);
+    sccp.Run();
+
+    EXPECT_EQ(sccp.GetNumFoldedBranches(), 1);
+    EXPECT_EQ(sccp.GetNumRemovedBlocks(), 1);
+    EXPECT_EQ(graph.GetBlocks().size(), 3);
+    EXPECT_EQ(bb0->GetLastInstruction()->GetOpcode(), Opcode::JUMP);
+    EXPECT_EQ(bb0->GetSuccessors(), std::vector<BasicBlock *>{bb1});
+    EXPECT_EQ(bb3->GetPredecessors(), std::vector<BasicBlock *>{bb1});
+    EXPECT_EQ(CountOpcode(graph, Opcode::PHI), 0);
+    EXPECT_EQ(arg->GetFirstUser(), nullptr);
+    EXPECT_EQ(ReturnedConstant(bb3), 5);
+}
+
+// A loop-carried value that only ever gets its initial value back stays constant, which folding
+// without the optimistic start could not show.
+TEST_F(ConstantPropagationTest, LoopCarriedConstantIsFound) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *n = builder.CreateArgument(Type::U64);
+    auto *one = builder.CreateConstant(Type::U64, 1);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb1);
+    auto *x = builder.CreatePhi(Type::U64);
+    auto *i = builder.CreatePhi(Type::U64);
+    auto *cond = builder.CreateCmp(ConditionCode::LT, i, n);
+    builder.CreateBranch(cond, bb2, bb3);
+
+    builder.SetInsertPoint(bb2);
+    auto *y = builder.CreateMul(x, one);
+    auto *next = builder.CreateAdd(i, y);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb3);
+    builder.CreateRet(x);
+
+    x->AddIncoming(one, bb0);
+    x->AddIncoming(y, bb2);
+    i->AddIncoming(one, bb0);
+    i->AddIncoming(next, bb2);
+
+    ConstantPropagation sccp(&graph);
+    sccp.Run();
+
+    EXPECT_EQ(sccp.GetNumFoldedValues(), 2);
+    EXPECT_EQ(sccp.GetNumRemovedBlocks(), 0);
+    EXPECT_EQ(CountOpcode(graph, Opcode::PHI), 1);
+    EXPECT_EQ(CountOpcode(graph, Opcode::JA), 1);
+    EXPECT_EQ(ReturnedConstant(bb3), 1);
+    EXPECT_EQ(dynamic_cast<ConstantInst *>(next->GetInputs()[1])->GetValue(), 1);
+}
+
+TEST_F(ConstantPropagationTest, FactorialIsLeftAlone) {
+    Graph graph;
+    BuildFactorialGraph(&graph);
+    size_t num_blocks = graph.GetBlocks().size();
+
+    ConstantPropagation sccp(&graph);
+    sccp.Run();
+
+    EXPECT_EQ(sccp.GetNumFoldedBranches(), 0);
+    EXPECT_EQ(graph.GetBlocks().size(), num_blocks);
+    EXPECT_EQ(CountOpcode(graph, Opcode::PHI), 2);
+}
@@ -0,0 +1,147 @@
+#include "helpers/count_opcode.h"
+#include "ir/basic_block.h"
+#include "ir/graph.h"
+#include "ir/instruction.h"
+#include "ir/ir_builder.h"
+#include "ir/opt/dead_code_elimination.h"
+#include <gtest/gtest.h>
+
+using namespace opt;
+
+class DeadCodeEliminationTest : public ::testing::Test {
+  protected:
+    size_t CountInstructions(const Graph &graph) {
+        size_t count = 0;
+        for (const auto &bb : graph.GetBlocks()) {
+            for (auto *inst = bb.GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
+                ++count;
+            }
+        }
+        return count;
+    }
+};
+
+TEST_F(DeadCodeEliminationTest, UnusedValuesAreRemoved) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+    auto *a = builder.CreateArgument(Type::U64);
+    auto *obj = builder.CreateArgument(Type::U64);
+    auto *two = builder.CreateConstant(Type::U64, 2);
+    auto *unused = builder.CreateMul(a, two);
+    builder.CreateAdd(unused, builder.CreateConstant(Type::U64, 7));
+    // The check is kept for its effect although nothing reads it.
+    builder.CreateNullCheck(obj);
+    builder.CreateRet(builder.CreateAdd(a, two));
+
+    DeadCodeElimination dce(&graph);
+    dce.Run();
+
+    EXPECT_EQ(dce.GetNumRemoved(), 3);
+    EXPECT_EQ(CountInstructions(graph), 4);
+    EXPECT_EQ(CountOpcode(graph, Opcode::NULL_CHECK), 1);
+    EXPECT_EQ(CountOpcode(graph, Opcode::MUL), 0);
+    EXPECT_EQ(two->GetFirstUser()->GetNextUser(), nullptr);
+}
+
+// A loop counter that only feeds itself is dead, even though every part of the cycle has a user.
+TEST_F(DeadCodeEliminationTest, DeadCyclesAreRemoved) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *n = builder.CreateArgument(Type::U64);
+    auto *zero = builder.CreateConstant(Type::U64, 0);
+    auto *one = builder.CreateConstant(Type::U64, 1);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb1);
+    auto *i = builder.CreatePhi(Type::U64);
+    auto *dead = builder.CreatePhi(Type::U64);
+    auto *cond = builder.CreateCmp(ConditionCode::LT, i, n);
+    builder.CreateBranch(cond, bb2, bb3);
+
+    builder.SetInsertPoint(bb2);
+    auto *next = builder.CreateAdd(i, one);
+    auto *dead_next = builder.CreateMul(dead, n);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb3);
+    builder.CreateRet(i);
+
+    i->AddIncoming(zero, bb0);
+    i->AddIncoming(next, bb2);
+    dead->AddIncoming(one, bb0);
+    dead->AddIncoming(dead_next, bb2);
+
+    DeadCodeElimination dce(&graph);
+    dce.Run();
+
+    EXPECT_EQ(dce.GetNumRemoved(), 2);
+    EXPECT_EQ(CountOpcode(graph, Opcode::PHI), 1);
+    EXPECT_EQ(CountOpcode(graph, Opcode::MUL), 0);
+    EXPECT_EQ(bb1->GetFirstInstruction(), i);
+}
+
+// Phis that only see one value besides themselves are replaced by it, which can make the phis
+// reading them trivial as well.
+TEST_F(DeadCodeEliminationTest, TrivialPhisAreReplaced) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+    auto *bb4 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *a = builder.CreateArgument(Type::U32);
+    auto *n = builder.CreateArgument(Type::U32);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb1);
+    auto *x = builder.CreatePhi(Type::U32);
+    auto *cond = builder.CreateCmp(ConditionCode::LT, x, n);
+    builder.CreateBranch(cond, bb2, bb3);
+
+    builder.SetInsertPoint(bb2);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb3);
+    builder.CreateJump(bb4);
+
+    builder.SetInsertPoint(bb4);
+    auto *y = builder.CreatePhi(Type::U32);
+    auto *ret = builder.CreateRet(y);
+
+    x->AddIncoming(a, bb0);
+    x->AddIncoming(x, bb2);
+    y->AddIncoming(x, bb3);
+
+    DeadCodeElimination dce(&graph);
+    dce.Run();
+
+    EXPECT_EQ(dce.GetNumRemovedPhis(), 2);
+    EXPECT_EQ(CountOpcode(graph, Opcode::PHI), 0);
+    EXPECT_EQ(ret->GetInputs()[0], a);
+    EXPECT_EQ(cond->GetInputs()[0], a);
+}
+
+TEST_F(DeadCodeEliminationTest, OnlyDetachedInstructionsCanBeDeleted) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+    auto *one = builder.CreateConstant(Type::U32, 1);
+    auto *sum = builder.CreateAdd(one, one);
+    builder.CreateRet(sum);
+
+    EXPECT_THROW(graph.DeleteInstruction(sum), std::runtime_error);
+    bb->RemoveInstruction(one);
+    EXPECT_THROW(graph.DeleteInstruction(one), std::runtime_error);
+}
@@ -0,0 +1,40 @@
+#include "helpers/random_cfg.h"
+#include "ir/analysis/graph_analyzer.h"
+#include "ir/ir.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static double TimeBuild(DominatorAlgorithm algorithm, int repeats, GraphAnalyzer &analyzer) {
+    analyzer.SetDominatorAlgorithm(algorithm);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i) {
+        analyzer.BuildDominatorTree();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+}
+
+int main(int argc, char **argv) {
+    size_t max_blocks = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+
+    std::printf("%10s %14s %14s %8s %s\n", "blocks", "iterative(ms)", "semi-nca(ms)", "speedup", "match");
+    for (size_t num_blocks = 100; num_blocks <= max_blocks; num_blocks *= 10) {
+        Graph graph;
+        BuildRandomCFG(&graph, num_blocks, 42);
+        int repeats = num_blocks <= 1000 ? 50 : 3;
+
+        GraphAnalyzer iterative(&graph);
+        GraphAnalyzer semi_nca(&graph);
+        double iterative_ms = TimeBuild(DominatorAlgorithm::ITERATIVE, repeats, iterative);
+        double semi_nca_ms = TimeBuild(DominatorAlgorithm::SEMI_NCA, repeats, semi_nca);
+
+        bool match = true;
+        for (auto &bb : graph.GetBlocks()) {
+            match &= iterative.GetImmediateDominator(&bb) == semi_nca.GetImmediateDominator(&bb);
+        }
+        std::printf("%10zu %14.3f %14.3f %7.1fx %s\n", num_blocks, iterative_ms, semi_nca_ms,
+                    iterative_ms / semi_nca_ms, match ? "yes" : "NO");
+    }
+    return 0;
+}
@@ -1,7 +1,11 @@
+#include "helpers/random_cfg.h"
 #include "ir/analysis/graph_analyzer.h"
 #include "ir/analysis/loop_analyzer.h"
+#include "ir/analysis/side_table.h"
 #include "ir/ir.h"
 #include <gtest/gtest.h>
+#include <pthread.h>
+#include <unordered_set>
 
 TEST(GraphAnalyzer, RPONumbering) {
     Graph graph;
@@ -906,3 +910,260 @@ TEST(LoopAnalyzer, TwoNestedLoopsComplex) {
     EXPECT_FALSE(analyzer.IsLoopHeader(H));
     EXPECT_FALSE(analyzer.IsLoopHeader(I));
 }
+
+TEST(SideTable, BlockMapIsIndexedById) {
+    Graph graph;
+    BasicBlock *A = graph.CreateBasicBlock();
+    BasicBlock *B = graph.CreateBasicBlock();
+
+    BlockMap<int> numbers(graph.GetBlockIdLimit(), -1);
+    EXPECT_EQ(numbers.size(), 2);
+    EXPECT_EQ(numbers[A], -1);
+
+    numbers[B] = 7;
+    EXPECT_EQ(numbers.at(B), 7);
+
+    // Blocks created after sizing the table still map to the default value.
+    BasicBlock *C = graph.CreateBasicBlock();
+    const auto &const_numbers = numbers;
+    EXPECT_EQ(const_numbers[C], -1);
+    EXPECT_THROW(const_numbers.at(C), std::out_of_range);
+
+    numbers[C] = 3;
+    EXPECT_EQ(numbers.size(), 3);
+    EXPECT_EQ(numbers.at(C), 3);
+}
+
+static void ExpectSameDominators(Graph *graph) {
+    GraphAnalyzer iterative(graph, DominatorAlgorithm::ITERATIVE);
+    iterative.BuildDominatorTree();
+    GraphAnalyzer semi_nca(graph, DominatorAlgorithm::SEMI_NCA);
+    semi_nca.BuildDominatorTree();
+
+    EXPECT_EQ(iterative.GetReversePostOrder(), semi_nca.GetReversePostOrder());
+    for (auto &bb : graph->GetBlocks()) {
+        EXPECT_EQ(iterative.GetImmediateDominator(&bb), semi_nca.GetImmediateDominator(&bb))
+            << "idom mismatch for BB" << bb.GetId();
+    }
+}
+
+TEST(GraphAnalyzer, SemiNCAMatchesIterative) {
+    for (uint32_t seed = 0; seed < 20; ++seed) {
+        Graph graph;
+        BuildRandomCFG(&graph, 10 + seed * 15, seed);
+        ExpectSameDominators(&graph);
+    }
+}
+
+TEST(GraphAnalyzer, SemiNCAIrreducibleLoop) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    // A -> B, C; B -> C; C -> B, D: the B/C cycle has two entries.
+    BasicBlock *A = graph.CreateBasicBlock();
+    BasicBlock *B = graph.CreateBasicBlock();
+    BasicBlock *C = graph.CreateBasicBlock();
+    BasicBlock *D = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(A);
+    builder.CreateBranch(builder.CreateConstant(Type::BOOL, 1), B, C);
+    builder.SetInsertPoint(B);
+    builder.CreateJump(C);
+    builder.SetInsertPoint(C);
+    builder.CreateBranch(builder.CreateConstant(Type::BOOL, 1), B, D);
+    builder.SetInsertPoint(D);
+    builder.CreateRet(nullptr);
+
+    GraphAnalyzer analyzer(&graph, DominatorAlgorithm::SEMI_NCA);
+    analyzer.BuildDominatorTree();
+    EXPECT_EQ(analyzer.GetImmediateDominator(A), nullptr);
+    EXPECT_EQ(analyzer.GetImmediateDominator(B), A);
+    EXPECT_EQ(analyzer.GetImmediateDominator(C), A);
+    EXPECT_EQ(analyzer.GetImmediateDominator(D), C);
+    ExpectSameDominators(&graph);
+}
+
+static bool DominatesByIdomChain(const GraphAnalyzer &analyzer, BasicBlock *dominator, BasicBlock *dominated) {
+    for (BasicBlock *bb = dominated; bb != nullptr; bb = analyzer.GetImmediateDominator(bb)) {
+        if (bb == dominator) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(GraphAnalyzer, DominanceQueriesMatchIdomChain) {
+    Graph graph;
+    BuildRandomCFG(&graph, 120, 7);
+
+    GraphAnalyzer analyzer(&graph);
+    analyzer.BuildDominatorTree();
+
+    for (auto &a : graph.GetBlocks()) {
+        for (auto &b : graph.GetBlocks()) {
+            bool reachable = analyzer.GetRPONumbers()[&b] != GraphAnalyzer::INVALID_RPO_NUMBER;
+            bool expected = &a == &b || (reachable && DominatesByIdomChain(analyzer, &a, &b));
+            EXPECT_EQ(analyzer.Dominates(&a, &b), expected) << "BB" << a.GetId() << " dom BB" << b.GetId();
+        }
+    }
+}
+
+TEST(GraphAnalyzer, DominatorTreePreorder) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    // A -> B, C; B -> D; C -> D
+    BasicBlock *A = graph.CreateBasicBlock();
+    BasicBlock *B = graph.CreateBasicBlock();
+    BasicBlock *C = graph.CreateBasicBlock();
+    BasicBlock *D = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(A);
+    builder.CreateBranch(builder.CreateConstant(Type::BOOL, 1), B, C);
+    builder.SetInsertPoint(B);
+    builder.CreateJump(D);
+    builder.SetInsertPoint(C);
+    builder.CreateJump(D);
+    builder.SetInsertPoint(D);
+    builder.CreateRet(nullptr);
+
+    GraphAnalyzer analyzer(&graph);
+    analyzer.BuildDominatorTree();
+
+    const auto &children = analyzer.GetDominatedChildren(A);
+    ASSERT_EQ(children.size(), 3);
+    EXPECT_TRUE(analyzer.GetDominatedChildren(B).empty());
+
+    const auto &preorder = analyzer.GetDominatorTreePreorder();
+    ASSERT_EQ(preorder.size(), 4);
+    EXPECT_EQ(preorder[0], A);
+    for (size_t i = 1; i < preorder.size(); ++i) {
+        EXPECT_EQ(analyzer.GetImmediateDominator(preorder[i]), A);
+    }
+
+    EXPECT_TRUE(analyzer.Dominates(A, D));
+    EXPECT_FALSE(analyzer.Dominates(B, D));
+    EXPECT_FALSE(analyzer.Dominates(D, A));
+}
+
+static void RecursivePostorder(BasicBlock *block, std::vector<uint8_t> &visited, std::vector<BasicBlock *> &out) {
+    visited[block->GetId()] = 1;
+    for (BasicBlock *succ : block->GetSuccessors()) {
+        if (!visited[succ->GetId()]) {
+            RecursivePostorder(succ, visited, out);
+        }
+    }
+    out.push_back(block);
+}
+
+TEST(GraphAnalyzer, IterativeRPOMatchesRecursive) {
+    for (uint32_t seed = 0; seed < 10; ++seed) {
+        Graph graph;
+        BuildRandomCFG(&graph, 50 + seed * 20, seed);
+
+        std::vector<uint8_t> visited(graph.GetBlockIdLimit(), 0);
+        std::vector<BasicBlock *> expected;
+        RecursivePostorder(&graph.GetBlocks().front(), visited, expected);
+        std::reverse(expected.begin(), expected.end());
+
+        GraphAnalyzer analyzer(&graph);
+        analyzer.ComputeRPO();
+        EXPECT_EQ(analyzer.GetReversePostOrder(), expected);
+    }
+}
+
+// Analyses of a 100k-block chain must fit into the 256 KiB stack of a compiler thread.
+static void *AnalyzeLongChain(void *arg) {
+    auto *loop_count = static_cast<size_t *>(arg);
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    constexpr size_t NUM_BLOCKS = 100000;
+    std::vector<BasicBlock *> blocks;
+    for (size_t i = 0; i < NUM_BLOCKS; ++i) {
+        blocks.push_back(graph.CreateBasicBlock());
+    }
+    for (size_t i = 0; i + 1 < NUM_BLOCKS; ++i) {
+        builder.SetInsertPoint(blocks[i]);
+        if (i == NUM_BLOCKS - 2) {
+            // Small loop at the deepest point of the walk.
+            builder.CreateBranch(builder.CreateConstant(Type::BOOL, 1), blocks[i - 4], blocks[i + 1]);
+        } else {
+            builder.CreateJump(blocks[i + 1]);
+        }
+    }
+    builder.SetInsertPoint(blocks.back());
+    builder.CreateRet(nullptr);
+
+    GraphAnalyzer analyzer(&graph);
+    analyzer.BuildDominatorTree();
+    LoopAnalyzer loop_analyzer(&graph);
+    loop_analyzer.Analyze();
+    *loop_count = loop_analyzer.GetLoops().size();
+    return nullptr;
+}
+
+TEST(GraphAnalyzer, LongChainOnSmallStack) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+
+    size_t loop_count = 0;
+    pthread_t thread;
+    ASSERT_EQ(pthread_create(&thread, &attr, AnalyzeLongChain, &loop_count), 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+
+    EXPECT_EQ(loop_count, 1);
+}
+
+TEST(LoopAnalyzer, DeeplyNestedLoops) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    // entry -> h0 -> h1 -> ... -> h(N-1) -> l(N-1) -> ... -> l0 -> exit, each l(i) branching back to h(i).
+    constexpr size_t DEPTH = 300;
+    BasicBlock *entry = graph.CreateBasicBlock();
+    std::vector<BasicBlock *> headers;
+    std::vector<BasicBlock *> latches;
+    for (size_t i = 0; i < DEPTH; ++i) {
+        headers.push_back(graph.CreateBasicBlock());
+    }
+    for (size_t i = 0; i < DEPTH; ++i) {
+        latches.push_back(graph.CreateBasicBlock());
+    }
+    BasicBlock *exit = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(entry);
+    builder.CreateJump(headers[0]);
+    for (size_t i = 0; i < DEPTH; ++i) {
+        builder.SetInsertPoint(headers[i]);
+        builder.CreateJump(i + 1 < DEPTH ? headers[i + 1] : latches[i]);
+        builder.SetInsertPoint(latches[i]);
+        builder.CreateBranch(builder.CreateConstant(Type::BOOL, 1), headers[i], i > 0 ? latches[i - 1] : exit);
+    }
+    builder.SetInsertPoint(exit);
+    builder.CreateRet(nullptr);
+
+    LoopAnalyzer loop_analyzer(&graph);
+    loop_analyzer.Analyze();
+
+    ASSERT_EQ(loop_analyzer.GetLoops().size(), DEPTH);
+    for (size_t i = 0; i < DEPTH; ++i) {
+        Loop *loop = loop_analyzer.GetLoopForBlock(headers[i]);
+        ASSERT_NE(loop, nullptr);
+        EXPECT_EQ(loop->GetHeader(), headers[i]);
+        EXPECT_EQ(loop_analyzer.GetLoopForBlock(latches[i]), loop);
+        EXPECT_EQ(loop->GetBlocks().size(), 2 * (DEPTH - i));
+        EXPECT_EQ(loop->GetOuterLoop(), i > 0 ? loop_analyzer.GetLoopForBlock(headers[i - 1]) : nullptr);
+        EXPECT_TRUE(loop->ContainsBlock(headers.back()));
+        EXPECT_FALSE(loop->ContainsBlock(exit));
+
+        const auto &loops = loop_analyzer.GetLoopsForBlock(latches[i]);
+        ASSERT_EQ(loops.size(), i + 1);
+        for (size_t depth = 0; depth <= i; ++depth) {
+            EXPECT_EQ(loops[depth]->GetHeader(), headers[depth]);
+        }
+    }
+    EXPECT_EQ(loop_analyzer.GetRootLoop()->GetInnerLoops().size(), 1);
+}
@@ -0,0 +1,94 @@
+#include "ir/opt/graph_coloring.h"
+#include <gtest/gtest.h>
+#include <utility>
+
+using namespace opt;
+
+// Every node of a square has two neighbours, so none can be simplified with two colors; the
+// optimistic select still finds the two-coloring.
+TEST(GraphColoring, SquareIsColoredOptimistically) {
+    GraphColoring coloring(4);
+    for (uint32_t node = 0; node < 4; ++node) {
+        coloring.AddInterference(node, (node + 1) % 4);
+    }
+
+    EXPECT_TRUE(coloring.Run(2));
+    for (uint32_t node = 0; node < 4; ++node) {
+        EXPECT_NE(coloring.GetColor(node), GraphColoring::SPILLED);
+        EXPECT_NE(coloring.GetColor(node), coloring.GetColor((node + 1) % 4));
+    }
+}
+
+TEST(GraphColoring, CliqueSpillsTheCheapestNode) {
+    GraphColoring coloring(4);
+    for (uint32_t a = 0; a < 4; ++a) {
+        for (uint32_t b = a + 1; b < 4; ++b) {
+            coloring.AddInterference(a, b);
+        }
+        coloring.SetSpillCost(a, a == 2 ? 1.0 : 10.0);
+    }
+
+    EXPECT_FALSE(coloring.Run(3));
+    EXPECT_EQ(coloring.GetColor(2), GraphColoring::SPILLED);
+    EXPECT_NE(coloring.GetColor(0), coloring.GetColor(1));
+    EXPECT_NE(coloring.GetColor(0), coloring.GetColor(3));
+    EXPECT_NE(coloring.GetColor(1), coloring.GetColor(3));
+}
+
+// Nodes 0 and 1 are connected by a move and do not interfere, so they are merged; the move between
+// the interfering nodes 1 and 2 has to stay.
+TEST(GraphColoring, MovesBetweenNonInterferingNodesAreCoalesced) {
+    GraphColoring coloring(4);
+    coloring.AddInterference(1, 2);
+    coloring.AddInterference(0, 3);
+    coloring.AddMove(0, 1);
+    coloring.AddMove(1, 2);
+
+    EXPECT_TRUE(coloring.Run(2));
+    EXPECT_EQ(coloring.GetNumCoalescedMoves(), 1);
+    EXPECT_EQ(coloring.GetColor(0), coloring.GetColor(1));
+    EXPECT_NE(coloring.GetColor(1), coloring.GetColor(2));
+    EXPECT_NE(coloring.GetColor(0), coloring.GetColor(3));
+}
+
+// Merging nodes 0 and 1 would give them three neighbours of high degree, which the Briggs and George
+// tests reject with three colors: the merged node would have to be spilled, as the triangle takes all
+// colors. The move is frozen instead.
+TEST(GraphColoring, CoalescingThatCouldSpillIsRefused) {
+    // Nodes 2, 3 and 4 form a triangle; 0 interferes with 2 and 3, 1 with 4.
+    GraphColoring coloring(5);
+    coloring.AddInterference(2, 3);
+    coloring.AddInterference(3, 4);
+    coloring.AddInterference(2, 4);
+    coloring.AddInterference(0, 2);
+    coloring.AddInterference(0, 3);
+    coloring.AddInterference(1, 4);
+    coloring.AddMove(0, 1);
+
+    EXPECT_TRUE(coloring.Run(3));
+    EXPECT_EQ(coloring.GetNumCoalescedMoves(), 0);
+    EXPECT_NE(coloring.GetColor(0), coloring.GetColor(1));
+    for (auto [a, b] : {std::pair{2, 3}, {3, 4}, {2, 4}, {0, 2}, {0, 3}, {1, 4}}) {
+        EXPECT_NE(coloring.GetColor(a), coloring.GetColor(b));
+    }
+}
+
+// Above MATRIX_NODE_LIMIT nodes the edges are hashed; the coloring is the same as with the matrix.
+TEST(GraphColoring, LargeGraphUsesHashedEdges) {
+    constexpr uint32_t NUM_NODES = GraphColoring::MATRIX_NODE_LIMIT * 2;
+    GraphColoring coloring(NUM_NODES);
+    // A ring; adding an edge twice counts it once.
+    for (uint32_t node = 0; node < NUM_NODES; ++node) {
+        coloring.AddInterference(node, (node + 1) % NUM_NODES);
+        coloring.AddInterference((node + 1) % NUM_NODES, node);
+    }
+    coloring.AddMove(0, 2);
+    coloring.AddMove(1, 2);
+
+    EXPECT_TRUE(coloring.Run(3));
+    EXPECT_EQ(coloring.GetNumCoalescedMoves(), 1);
+    EXPECT_EQ(coloring.GetColor(0), coloring.GetColor(2));
+    for (uint32_t node = 0; node < NUM_NODES; ++node) {
+        EXPECT_NE(coloring.GetColor(node), coloring.GetColor((node + 1) % NUM_NODES));
+    }
+}
@@ -0,0 +1,129 @@
+#include "helpers/count_opcode.h"
+#include "ir/basic_block.h"
+#include "ir/graph.h"
+#include "ir/instruction.h"
+#include "ir/ir_builder.h"
+#include "ir/opt/global_value_numbering.h"
+#include <gtest/gtest.h>
+
+using namespace opt;
+
+TEST(GvnTest, RepeatedValuesInOneBlock) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+    auto *a = builder.CreateArgument(Type::U32);
+    auto *b = builder.CreateArgument(Type::U32);
+    auto *one = builder.CreateConstant(Type::U32, 1);
+    auto *sum = builder.CreateAdd(a, b);
+    builder.CreateConstant(Type::U32, 1);
+    auto *same_sum = builder.CreateAdd(a, b);
+    auto *shifted = builder.CreateShl(sum, one);
+    auto *result = builder.CreateMul(shifted, same_sum);
+    builder.CreateRet(result);
+
+    GlobalValueNumbering gvn(&graph);
+    gvn.Run();
+
+    EXPECT_EQ(gvn.GetNumRemoved(), 2);
+    EXPECT_EQ(CountOpcode(graph, Opcode::ADD), 1);
+    EXPECT_EQ(CountOpcode(graph, Opcode::Constant), 1);
+    EXPECT_EQ(result->GetInputs()[1], sum);
+}
+
+TEST(GvnTest, CommutativeOperandsMatch) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+    auto *a = builder.CreateArgument(Type::U64);
+    auto *b = builder.CreateArgument(Type::U64);
+    auto *product = builder.CreateMul(a, b);
+    auto *swapped = builder.CreateMul(b, a);
+    auto *shifted = builder.CreateShl(a, b);
+    auto *shifted_other = builder.CreateShl(b, a);
+    auto *x = builder.CreateAnd(product, swapped);
+    auto *y = builder.CreateAdd(shifted, shifted_other);
+    builder.CreateRet(builder.CreateAdd(x, y));
+
+    GlobalValueNumbering(&graph).Run();
+
+    EXPECT_EQ(CountOpcode(graph, Opcode::MUL), 1);
+    // SHL is not commutative.
+    EXPECT_EQ(CountOpcode(graph, Opcode::SHL), 2);
+    EXPECT_EQ(x->GetInputs()[1], product);
+}
+
+TEST(GvnTest, ComparesAndCastsKeepTheirAttributes) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb0);
+    auto *a = builder.CreateArgument(Type::U32);
+    auto *b = builder.CreateArgument(Type::U32);
+    auto *lt = builder.CreateCmp(ConditionCode::LT, a, b);
+    auto *ge = builder.CreateCmp(ConditionCode::GE, a, b);
+    auto *wide = builder.CreateCast(Type::U64, a);
+    auto *narrow = builder.CreateCast(Type::U32, wide);
+    builder.CreateCast(Type::U64, a);
+    auto *same_lt = builder.CreateCmp(ConditionCode::LT, a, b);
+    auto *both = builder.CreateAnd(lt, ge);
+    builder.CreateBranch(builder.CreateAnd(both, same_lt), bb1, bb2);
+    builder.SetInsertPoint(bb1);
+    builder.CreateRet(narrow);
+    builder.SetInsertPoint(bb2);
+    builder.CreateRet(wide);
+
+    GlobalValueNumbering gvn(&graph);
+    gvn.Run();
+
+    EXPECT_EQ(gvn.GetNumRemoved(), 2);
+    EXPECT_EQ(CountOpcode(graph, Opcode::CMP), 2);
+    EXPECT_EQ(CountOpcode(graph, Opcode::CAST), 2);
+}
+
+// A value computed in a dominator is reused; one computed in a sibling branch is not.
+TEST(GvnTest, OnlyDominatingValuesAreReused) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *a = builder.CreateArgument(Type::U32);
+    auto *b = builder.CreateArgument(Type::U32);
+    auto *sum = builder.CreateAdd(a, b);
+    auto *cond = builder.CreateCmp(ConditionCode::LT, a, b);
+    builder.CreateBranch(cond, bb1, bb2);
+
+    builder.SetInsertPoint(bb1);
+    auto *left_sum = builder.CreateAdd(b, a);
+    auto *left = builder.CreateMul(left_sum, a);
+    builder.CreateJump(bb3);
+
+    builder.SetInsertPoint(bb2);
+    auto *right = builder.CreateMul(sum, a);
+    builder.CreateJump(bb3);
+
+    builder.SetInsertPoint(bb3);
+    auto *phi = builder.CreatePhi(Type::U32);
+    phi->AddIncoming(left, bb1);
+    phi->AddIncoming(right, bb2);
+    auto *joined = builder.CreateMul(sum, a);
+    builder.CreateRet(builder.CreateAdd(phi, joined));
+
+    GlobalValueNumbering gvn(&graph);
+    gvn.Run();
+
+    // `left_sum` folds into `sum`, which makes `left` and `right` equal, but neither branch
+    // dominates the other or the join.
+    EXPECT_EQ(gvn.GetNumRemoved(), 1);
+    EXPECT_EQ(left->GetInputs()[0], sum);
+    EXPECT_EQ(CountOpcode(graph, Opcode::MUL), 3);
+    EXPECT_EQ(joined->GetBasicBlock(), bb3);
+}
@@ -0,0 +1,115 @@
+#include "allocation_verifier.h"
+#include "ir/ir.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <utility>
+
+Instruction *ValueOf(Instruction *inst) {
+    while (inst->GetOpcode() == Opcode::MOVE || inst->GetOpcode() == Opcode::LOAD ||
+           inst->GetOpcode() == Opcode::STORE || inst->GetOpcode() == Opcode::SWAP) {
+        if (inst->GetOpcode() == Opcode::SWAP && static_cast<SwapInst *>(inst)->IsSecondHalf()) {
+            inst = inst->GetInputs()[0]->GetInputs()[1];
+        } else {
+            inst = inst->GetInputs()[0];
+        }
+    }
+    return inst;
+}
+
+// Constants re-created by the allocator hold the same value as the original.
+static bool SameValue(Instruction *held, Instruction *value) {
+    if (held == nullptr || value == nullptr || held == value) {
+        return held == value;
+    }
+    return held->GetOpcode() == Opcode::Constant && value->GetOpcode() == Opcode::Constant &&
+           held->GetType() == value->GetType() &&
+           static_cast<ConstantInst *>(held)->GetValue() == static_cast<ConstantInst *>(value)->GetValue();
+}
+
+// Value held by each register and stack slot.
+using LocationState = std::map<std::pair<Location::Kind, int32_t>, Instruction *>;
+
+static std::pair<Location::Kind, int32_t> Key(Location location) { return {location.GetKind(), location.GetValue()}; }
+
+static void Execute(Instruction *inst, LocationState &state, bool check) {
+    for (auto *input : inst->GetInputs()) {
+        if (check && input != nullptr && input->GetLocation().GetKind() != Location::UNASSIGNED) {
+            auto it = state.find(Key(input->GetLocation()));
+            Instruction *held = it != state.end() ? it->second : nullptr;
+            EXPECT_TRUE(SameValue(held, ValueOf(input))) << "i" << inst->GetId() << " reads i" << input->GetId()
+                                            << " from a location that does not hold its value.";
+        }
+    }
+    if (inst->GetOpcode() == Opcode::SWAP && !static_cast<SwapInst *>(inst)->IsSecondHalf()) {
+        state[Key(inst->GetInputs()[0]->GetLocation())] = ValueOf(inst->GetInputs()[1]);
+    }
+    if (inst->GetLocation().GetKind() != Location::UNASSIGNED) {
+        state[Key(inst->GetLocation())] = ValueOf(inst);
+    }
+}
+
+void VerifyAllocation(Graph &graph) {
+    std::map<uint32_t, LocationState> out_states;
+    auto compute_in_state = [&](BasicBlock *block, LocationState &in_state) {
+        bool any_pred = block == graph.GetStartBlock();
+        const auto &preds = block->GetPredecessors();
+        for (size_t i = 0; i < preds.size(); ++i) {
+            auto pred_state = out_states.find(preds[i]->GetId());
+            if (pred_state == out_states.end()) {
+                continue;
+            }
+            LocationState edge_state = pred_state->second;
+            for (auto *inst = block->GetFirstInstruction(); inst && inst->GetOpcode() == Opcode::PHI;
+                 inst = inst->GetNext()) {
+                auto it = edge_state.find(Key(inst->GetLocation()));
+                if (it != edge_state.end() && SameValue(it->second, ValueOf(inst->GetInputs()[i]))) {
+                    it->second = inst;
+                } else if (it != edge_state.end()) {
+                    edge_state.erase(it);
+                }
+            }
+            if (!any_pred) {
+                in_state = std::move(edge_state);
+                any_pred = true;
+                continue;
+            }
+            std::erase_if(in_state, [&](const auto &entry) {
+                auto it = edge_state.find(entry.first);
+                return it == edge_state.end() || !SameValue(it->second, entry.second);
+            });
+        }
+        return any_pred;
+    };
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto &block : graph.GetBlocks()) {
+            LocationState state;
+            if (!compute_in_state(&block, state)) {
+                continue;
+            }
+            for (auto *inst = block.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+                if (inst->GetOpcode() != Opcode::PHI) {
+                    Execute(inst, state, false);
+                }
+            }
+            auto [it, inserted] = out_states.try_emplace(block.GetId(), state);
+            if (inserted || it->second != state) {
+                it->second = std::move(state);
+                changed = true;
+            }
+        }
+    }
+
+    for (auto &block : graph.GetBlocks()) {
+        LocationState state;
+        if (!compute_in_state(&block, state)) {
+            continue;
+        }
+        for (auto *inst = block.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+            if (inst->GetOpcode() != Opcode::PHI) {
+                Execute(inst, state, true);
+            }
+        }
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+class Graph;
+class Instruction;
+
+// Value an instruction holds after allocation: spill, fill and resolution code copies its first input,
+// and the second half of a swap holds the second input of the exchange.
+Instruction *ValueOf(Instruction *inst);
+
+// Tracks which value each location holds along the CFG: states meet by intersection at merges,
+// and phi moves on an edge make the phi's location hold the phi. Every operand must then be read
+// from a location holding its value; mismatches are reported as gtest failures.
+void VerifyAllocation(Graph &graph);
@@ -0,0 +1,12 @@
+#include "count_opcode.h"
+#include "ir/ir.h"
+
+size_t CountOpcode(const Graph &graph, Opcode opcode) {
+    size_t count = 0;
+    for (const auto &bb : graph.GetBlocks()) {
+        for (auto *inst = bb.GetFirstInstruction(); inst != nullptr; inst = inst->GetNext()) {
+            count += inst->GetOpcode() == opcode;
+        }
+    }
+    return count;
+}
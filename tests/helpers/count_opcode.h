@@ -0,0 +1,9 @@
+#pragma once
+
+#include "ir/types.h"
+#include <cstddef>
+
+class Graph;
+
+// Number of instructions with `opcode` in the blocks of `graph`.
+size_t CountOpcode(const Graph &graph, Opcode opcode);
@@ -0,0 +1,105 @@
+#include "random_cfg.h"
+#include "ir/analysis/graph_analyzer.h"
+#include "ir/ir.h"
+#include <random>
+#include <vector>
+
+void BuildRandomCFG(Graph *graph, size_t num_blocks, uint32_t seed, double branch_probability) {
+    IRBuilder builder(graph);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+    std::vector<BasicBlock *> blocks;
+    blocks.reserve(num_blocks);
+    for (size_t i = 0; i < num_blocks; ++i) {
+        blocks.push_back(graph->CreateBasicBlock());
+    }
+
+    for (size_t i = 0; i + 1 < num_blocks; ++i) {
+        builder.SetInsertPoint(blocks[i]);
+        BasicBlock *next = blocks[i + 1];
+        if (num_blocks > 2 && coin(rng) < branch_probability) {
+            // Prefer short edges so loops nest, with occasional long jumps across the graph.
+            std::uniform_int_distribution<size_t> near(i > 8 ? i - 8 : 1, std::min(i + 8, num_blocks - 1));
+            std::uniform_int_distribution<size_t> far(1, num_blocks - 1);
+            size_t target = coin(rng) < 0.8 ? near(rng) : far(rng);
+            if (target != i + 1) {
+                auto *cond = builder.CreateConstant(Type::BOOL, 1);
+                builder.CreateBranch(cond, next, blocks[target]);
+                continue;
+            }
+        }
+        builder.CreateJump(next);
+    }
+
+    builder.SetInsertPoint(blocks.back());
+    builder.CreateRet(nullptr);
+}
+
+void AddRandomValues(Graph *graph, uint32_t seed, size_t values_per_block) {
+    GraphAnalyzer analyzer(graph);
+    analyzer.BuildDominatorTree();
+    const auto &rpo = analyzer.GetReversePostOrder();
+    if (rpo.empty()) {
+        return;
+    }
+
+    IRBuilder builder(graph);
+    std::mt19937 rng(seed);
+    BlockMap<std::vector<Instruction *>> defined(graph->GetBlockIdLimit());
+    std::vector<PhiInst *> phis;
+
+    // Values visible at the end of `block`: everything defined along its dominator chain.
+    auto pick_available = [&](BasicBlock *block) -> Instruction * {
+        std::vector<BasicBlock *> chain;
+        for (BasicBlock *bb = block; bb != nullptr; bb = analyzer.GetImmediateDominator(bb)) {
+            chain.push_back(bb);
+        }
+        size_t total = 0;
+        for (BasicBlock *bb : chain) {
+            total += defined[bb].size();
+        }
+        size_t idx = std::uniform_int_distribution<size_t>(0, total - 1)(rng);
+        for (BasicBlock *bb : chain) {
+            if (idx < defined[bb].size()) {
+                return defined[bb][idx];
+            }
+            idx -= defined[bb].size();
+        }
+        return nullptr;
+    };
+
+    builder.SetInsertPoint(rpo[0]->GetFirstInstruction());
+    defined[rpo[0]].push_back(builder.CreateConstant(Type::U64, 1));
+    defined[rpo[0]].push_back(builder.CreateConstant(Type::U64, 2));
+
+    for (BasicBlock *block : rpo) {
+        if (block->GetPredecessors().size() > 1) {
+            builder.SetInsertPoint(block);
+            auto *phi = builder.CreatePhi(Type::U64);
+            phis.push_back(phi);
+            defined[block].push_back(phi);
+        }
+        builder.SetInsertPoint(block->GetLastInstruction());
+        for (size_t i = 0; i < values_per_block; ++i) {
+            Instruction *lhs = pick_available(block);
+            Instruction *rhs = pick_available(block);
+            defined[block].push_back(rng() % 2 ? builder.CreateAdd(lhs, rhs) : builder.CreateMul(lhs, rhs));
+        }
+    }
+
+    for (PhiInst *phi : phis) {
+        for (BasicBlock *pred : phi->GetBasicBlock()->GetPredecessors()) {
+            if (analyzer.GetRPONumbers()[pred] != GraphAnalyzer::INVALID_RPO_NUMBER) {
+                phi->AddIncoming(pick_available(pred), pred);
+            }
+        }
+    }
+
+    // Keep the last value of the exit block alive through the return.
+    Instruction *ret = rpo.back()->GetLastInstruction();
+    if (ret != nullptr && ret->GetOpcode() == Opcode::RET && ret->GetInputs().size() == 1 &&
+        ret->GetInputs()[0] == nullptr) {
+        ret->SetInput(0, pick_available(rpo.back()));
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class Graph;
+
+// Builds a CFG of `num_blocks` blocks: a fall-through chain where some blocks branch to a
+// random second target, which yields forward edges, natural loops and irreducible regions.
+void BuildRandomCFG(Graph *graph, size_t num_blocks, uint32_t seed, double branch_probability = 0.4);
+
+// Fills a CFG built by BuildRandomCFG with SSA values: phis in merge blocks and arithmetic
+// whose operands are picked among the values available in dominating blocks.
+void AddRandomValues(Graph *graph, uint32_t seed, size_t values_per_block = 4);
@@ -1,4 +1,7 @@
+#include "helpers/random_cfg.h"
+#include "ir/analysis/graph_analyzer.h"
 #include "ir/analysis/linear_order.h"
+#include "ir/analysis/loop_analyzer.h"
 #include "ir/ir.h"
 #include <algorithm>
 #include <gtest/gtest.h>
@@ -123,3 +126,98 @@ TEST(LinearOrder, SimpleLoop) {
     EXPECT_EQ(ordered_ids[0], bb0->GetId());
     EXPECT_EQ(ordered_ids[1], bb1->GetId());
 }
+
+// Nested loops whose exits are reached before their bodies in RPO.
+TEST(LinearOrder, LoopsAreContiguous) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    // BB0 -> BB1 (outer header) -> BB2 / BB6 (exit)
+    // BB2 -> BB3 (inner header) -> BB4 / BB5
+    // BB4 -> BB3, BB5 -> BB1
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+    auto *bb4 = graph.CreateBasicBlock();
+    auto *bb5 = graph.CreateBasicBlock();
+    auto *bb6 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *cond = builder.CreateConstant(Type::BOOL, 1);
+    builder.CreateJump(bb1);
+    builder.SetInsertPoint(bb1);
+    builder.CreateBranch(cond, bb2, bb6);
+    builder.SetInsertPoint(bb2);
+    builder.CreateJump(bb3);
+    builder.SetInsertPoint(bb3);
+    builder.CreateBranch(cond, bb4, bb5);
+    builder.SetInsertPoint(bb4);
+    builder.CreateJump(bb3);
+    builder.SetInsertPoint(bb5);
+    builder.CreateJump(bb1);
+    builder.SetInsertPoint(bb6);
+    builder.CreateRet(nullptr);
+
+    std::vector<uint32_t> expected_ids = {bb0->GetId(), bb1->GetId(), bb2->GetId(), bb3->GetId(),
+                                          bb4->GetId(), bb5->GetId(), bb6->GetId()};
+    EXPECT_EQ(GetBlockIds(LinearOrder(&graph).GetBlocks()), expected_ids);
+
+    // The RPO fallback interleaves the exits with the loop bodies.
+    GraphAnalyzer analyzer(&graph);
+    analyzer.ComputeRPO();
+    EXPECT_EQ(LinearOrder(&graph, LinearOrderMode::RPO).GetBlocks(), analyzer.GetReversePostOrder());
+    EXPECT_NE(LinearOrder(&graph, LinearOrderMode::RPO).GetBlocks(), LinearOrder(&graph).GetBlocks());
+}
+
+TEST(LinearOrder, RandomGraphsKeepLoopsContiguous) {
+    for (uint32_t seed = 0; seed < 40; ++seed) {
+        Graph graph;
+        BuildRandomCFG(&graph, 20 + seed * 5, seed);
+        GraphAnalyzer analyzer(&graph);
+        analyzer.BuildDominatorTree();
+        LoopAnalyzer loops(&graph, &analyzer);
+        loops.Analyze();
+
+        LinearOrder linear_order(&graph, analyzer, loops);
+        const auto &order = linear_order.GetBlocks();
+        ASSERT_EQ(order.size(), analyzer.GetReversePostOrder().size()) << "seed " << seed;
+        std::vector<size_t> position(graph.GetBlockIdLimit());
+        for (size_t i = 0; i < order.size(); ++i) {
+            position[order[i]->GetId()] = i;
+        }
+
+        std::vector<Loop *> worklist(loops.GetRootLoop()->GetInnerLoops().begin(),
+                                     loops.GetRootLoop()->GetInnerLoops().end());
+        while (!worklist.empty()) {
+            Loop *loop = worklist.back();
+            worklist.pop_back();
+            worklist.insert(worklist.end(), loop->GetInnerLoops().begin(), loop->GetInnerLoops().end());
+
+            // A loop, including its inner loops, occupies one run starting at its header.
+            size_t size = 0;
+            size_t last = 0;
+            for (BasicBlock *block : order) {
+                if (loop->ContainsBlock(block) ||
+                    std::any_of(loop->GetInnerLoops().begin(), loop->GetInnerLoops().end(),
+                                [&](Loop *inner) { return inner->ContainsBlock(block); })) {
+                    ++size;
+                    last = position[block->GetId()];
+                }
+            }
+            EXPECT_EQ(last + 1 - position[loop->GetHeader()->GetId()], size) << "seed " << seed;
+
+            if (loop->IsReducible()) {
+                for (BasicBlock *block : loop->GetBlocks()) {
+                    for (BasicBlock *succ : block->GetSuccessors()) {
+                        Loop *succ_loop = loops.GetLoopWithHeader(succ);
+                        bool back_edge = succ_loop != nullptr && succ_loop->ContainsBlock(block);
+                        if (!back_edge && loop->ContainsBlock(succ)) {
+                            EXPECT_LT(position[block->GetId()], position[succ->GetId()]) << "seed " << seed;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#include "helpers/allocation_verifier.h"
+#include "helpers/count_opcode.h"
+#include "helpers/factorial_graph.h"
+#include "helpers/random_cfg.h"
+#include "ir/ir.h"
+#include "ir/ir_builder.h"
+#include "ir/opt/local_register_allocator.h"
+#include "ir/opt/register_allocator.h"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace opt;
+
+// Values of one block that fit in the registers need no stack slots.
+TEST(LocalRegisterAllocator, BlockWithoutPressureStaysInRegisters) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+    auto *a = builder.CreateArgument(Type::U32);
+    auto *b = builder.CreateArgument(Type::U32);
+    auto *sum = builder.CreateAdd(a, b);
+    auto *product = builder.CreateMul(sum, a);
+    auto *result = builder.CreateAdd(product, sum);
+    builder.CreateRet(result);
+
+    LocalRegisterAllocator allocator(&graph, 2);
+    allocator.Run();
+
+    EXPECT_EQ(allocator.GetNumLoads(), 0);
+    EXPECT_EQ(allocator.GetNumStores(), 0);
+    EXPECT_EQ(graph.GetFrameSize(), 0);
+    for (auto *inst : {static_cast<Instruction *>(sum), static_cast<Instruction *>(product),
+                       static_cast<Instruction *>(result)}) {
+        EXPECT_EQ(inst->GetLocation().GetKind(), Location::REGISTER) << "i" << inst->GetId();
+    }
+    VerifyAllocation(graph);
+}
+
+// With every register taken, the value with the fewest uses left is stored and loaded again.
+TEST(LocalRegisterAllocator, EvictsTheValueWithFewestUsesLeft) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+    auto *n = builder.CreateArgument(Type::U64);
+    auto *once = builder.CreateAdd(n, n);
+    auto *often = builder.CreateMul(n, n);
+    auto *x = builder.CreateAdd(often, often);
+    auto *y = builder.CreateMul(x, often);
+    auto *z = builder.CreateAdd(y, once);
+    builder.CreateRet(z);
+
+    LocalRegisterAllocator allocator(&graph, 2);
+    allocator.Run();
+
+    // `x` needs a third register while `once` and `often` are held; `once` is used once more.
+    EXPECT_EQ(allocator.GetNumStores(), 1);
+    EXPECT_EQ(allocator.GetNumLoads(), 1);
+    for (auto &block : graph.GetBlocks()) {
+        for (auto *inst = block.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+            if (inst->GetOpcode() == Opcode::STORE || inst->GetOpcode() == Opcode::LOAD) {
+                EXPECT_EQ(ValueOf(inst), once);
+            }
+        }
+    }
+    EXPECT_EQ(graph.GetFrameSize(), 8);
+    VerifyAllocation(graph);
+}
+
+// Phis live in their stack slots; values of the loop body reach them through copies at its end.
+TEST(LocalRegisterAllocator, FactorialKeepsPhisOnTheStack) {
+    Graph graph;
+    BuildFactorialGraph(&graph);
+    LocalRegisterAllocator allocator(&graph, 4);
+    allocator.Run();
+
+    for (auto &block : graph.GetBlocks()) {
+        for (auto *inst = block.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+            auto kind = inst->GetLocation().GetKind();
+            if (inst->GetOpcode() == Opcode::PHI || inst->GetOpcode() == Opcode::STORE) {
+                EXPECT_EQ(kind, Location::STACK) << "i" << inst->GetId();
+            } else if (inst->GetType() != Type::VOID) {
+                EXPECT_EQ(kind, Location::REGISTER) << "i" << inst->GetId();
+            }
+        }
+    }
+    // Two phis, two copies into each; the cast is read by the loop header.
+    EXPECT_EQ(allocator.GetNumStores(), 5);
+    VerifyAllocation(graph);
+}
+
+// Phis swapped by the back edge: one of them is held in a register while the other is written.
+TEST(LocalRegisterAllocator, PhiCyclesKeepOneOldValueInARegister) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *a0 = builder.CreateArgument(Type::U32);
+    auto *b0 = builder.CreateArgument(Type::U32);
+    auto *n = builder.CreateArgument(Type::U32);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb1);
+    auto *a = builder.CreatePhi(Type::U32);
+    auto *b = builder.CreatePhi(Type::U32);
+    auto *cond = builder.CreateCmp(ConditionCode::LT, a, n);
+    builder.CreateBranch(cond, bb2, bb3);
+
+    builder.SetInsertPoint(bb2);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb3);
+    builder.CreateRet(b);
+
+    a->AddIncoming(a0, bb0);
+    a->AddIncoming(b, bb2);
+    b->AddIncoming(b0, bb0);
+    b->AddIncoming(a, bb2);
+
+    LocalRegisterAllocator allocator(&graph, 2);
+    allocator.Run();
+
+    EXPECT_NE(a->GetLocation(), b->GetLocation());
+    size_t loads = 0;
+    for (auto *inst = bb2->GetFirstInstruction(); inst; inst = inst->GetNext()) {
+        loads += inst->GetOpcode() == Opcode::LOAD;
+    }
+    EXPECT_EQ(loads, 2);
+    VerifyAllocation(graph);
+}
+
+TEST(LocalRegisterAllocator, ThrowsWithFewerThanTwoRegisters) {
+    Graph graph;
+    BuildFactorialGraph(&graph);
+    EXPECT_THROW(LocalRegisterAllocator(&graph, 1).Run(), std::runtime_error);
+}
+
+TEST(LocalRegisterAllocator, SelectedThroughRegisterAllocator) {
+    Graph graph;
+    BuildFactorialGraph(&graph);
+    RegisterAllocator allocator(&graph, 4);
+    allocator.SetMode(AllocationMode::BLOCK_LOCAL);
+    allocator.Run();
+
+    EXPECT_EQ(CountOpcode(graph, Opcode::MOVE), 0);
+    EXPECT_GT(CountOpcode(graph, Opcode::STORE), 0);
+    VerifyAllocation(graph);
+}
+
+// No liveness is needed, so irreducible graphs are allocated as well.
+TEST(LocalRegisterAllocator, RandomGraphsAllocateCorrectly) {
+    for (uint32_t num_regs : {2, 3, 4, 8}) {
+        for (uint32_t seed = 0; seed < 30; ++seed) {
+            SCOPED_TRACE("seed " + std::to_string(seed) + ", " + std::to_string(num_regs) + " registers");
+            Graph graph;
+            BuildRandomCFG(&graph, 12 + seed, seed, 0.2);
+            AddRandomValues(&graph, seed);
+
+            LocalRegisterAllocator(&graph, num_regs).Run();
+            VerifyAllocation(graph);
+        }
+    }
+}
@@ -1,6 +1,7 @@
 #include "ir/ir.h"
 #include "ir/opt/peephole_optimizer.h"
 #include <gtest/gtest.h>
+#include <utility>
 
 void RunOptimization(Graph *graph) {
     PeepholeOptimizer pass(graph);
@@ -245,3 +246,164 @@ TEST(Optimization, AddNegationCommutative) {
     ASSERT_EQ(val->GetOpcode(), Opcode::Constant);
     EXPECT_EQ(static_cast<ConstantInst *>(val)->GetValue(), 0);
 }
+
+TEST(Optimization, MulPeepholes) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    BasicBlock *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+
+    auto *arg = builder.CreateArgument(Type::U64);
+    auto *zero = builder.CreateConstant(Type::U64, 0);
+    auto *one = builder.CreateConstant(Type::U64, 1);
+    auto *eight = builder.CreateConstant(Type::U64, 8);
+
+    // Case 1: X * 1 -> X
+    auto *ret1 = builder.CreateRet(builder.CreateMul(arg, one));
+    // Case 2: 0 * X -> 0
+    auto *ret2 = builder.CreateRet(builder.CreateMul(zero, arg));
+    // Case 3: 8 * X -> X << 3
+    auto *ret3 = builder.CreateRet(builder.CreateMul(eight, arg));
+    // Case 4: 8 * 8 -> 64
+    auto *ret4 = builder.CreateRet(builder.CreateMul(eight, eight));
+
+    RunOptimization(&graph);
+
+    EXPECT_EQ(ret1->GetInputs()[0], arg);
+    EXPECT_EQ(ret2->GetInputs()[0], zero);
+
+    auto *shl = ret3->GetInputs()[0];
+    ASSERT_EQ(shl->GetOpcode(), Opcode::SHL);
+    EXPECT_EQ(shl->GetInputs()[0], arg);
+    EXPECT_EQ(static_cast<ConstantInst *>(shl->GetInputs()[1])->GetValue(), 3);
+    EXPECT_EQ(shl->GetNext(), ret3);
+
+    auto *val4 = ret4->GetInputs()[0];
+    ASSERT_EQ(val4->GetOpcode(), Opcode::Constant);
+    EXPECT_EQ(static_cast<ConstantInst *>(val4)->GetValue(), 64);
+}
+
+TEST(Optimization, CompareOfEqualOperands) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    BasicBlock *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+
+    auto *arg = builder.CreateArgument(Type::U32);
+    auto *ret_le = builder.CreateRet(builder.CreateCmp(ConditionCode::LE, arg, arg));
+    auto *ret_ugt = builder.CreateRet(builder.CreateCmp(ConditionCode::UGT, arg, arg));
+
+    RunOptimization(&graph);
+
+    auto *le = ret_le->GetInputs()[0];
+    ASSERT_EQ(le->GetOpcode(), Opcode::Constant);
+    EXPECT_EQ(le->GetType(), Type::BOOL);
+    EXPECT_EQ(static_cast<ConstantInst *>(le)->GetValue(), 1);
+    auto *ugt = ret_ugt->GetInputs()[0];
+    ASSERT_EQ(ugt->GetOpcode(), Opcode::Constant);
+    EXPECT_EQ(static_cast<ConstantInst *>(ugt)->GetValue(), 0);
+}
+
+TEST(Optimization, CastChains) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    BasicBlock *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+
+    auto *arg = builder.CreateArgument(Type::U32);
+    auto *wide = builder.CreateArgument(Type::U64);
+
+    // Case 1: widening and narrowing back -> X
+    auto *ret1 = builder.CreateRet(builder.CreateCast(Type::U32, builder.CreateCast(Type::U64, arg)));
+    // Case 2: two truncations -> one
+    auto *ret2 = builder.CreateRet(builder.CreateCast(Type::BOOL, builder.CreateCast(Type::U32, wide)));
+    // Case 3: narrowing and widening again loses the upper bits and stays
+    auto *ret3 = builder.CreateRet(builder.CreateCast(Type::U64, builder.CreateCast(Type::U32, wide)));
+    // Case 4: a negative signed constant is sign-extended
+    auto *ret4 = builder.CreateRet(builder.CreateCast(Type::U64, builder.CreateConstant(Type::S32, 0xfffffffe)));
+
+    RunOptimization(&graph);
+
+    EXPECT_EQ(ret1->GetInputs()[0], arg);
+
+    auto *cast2 = ret2->GetInputs()[0];
+    ASSERT_EQ(cast2->GetOpcode(), Opcode::CAST);
+    EXPECT_EQ(cast2->GetType(), Type::BOOL);
+    EXPECT_EQ(cast2->GetInputs()[0], wide);
+
+    auto *cast3 = ret3->GetInputs()[0];
+    ASSERT_EQ(cast3->GetOpcode(), Opcode::CAST);
+    EXPECT_EQ(cast3->GetInputs()[0]->GetOpcode(), Opcode::CAST);
+
+    auto *val4 = ret4->GetInputs()[0];
+    ASSERT_EQ(val4->GetOpcode(), Opcode::Constant);
+    EXPECT_EQ(static_cast<ConstantInst *>(val4)->GetValue(), static_cast<uint64_t>(-2));
+}
+
+// Each fold only revisits the users of the folded value; the originals are erased on the way.
+TEST(Optimization, LongFoldChainLeavesOnlyTheResult) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    BasicBlock *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+
+    Instruction *value = builder.CreateConstant(Type::U64, 1);
+    auto *two = builder.CreateConstant(Type::U64, 2);
+    for (int i = 0; i < 1000; ++i) {
+        value = builder.CreateAdd(builder.CreateMul(value, two), builder.CreateConstant(Type::U64, 1));
+    }
+    auto *ret = builder.CreateRet(value);
+
+    RunOptimization(&graph);
+
+    auto *result = ret->GetInputs()[0];
+    ASSERT_EQ(result->GetOpcode(), Opcode::Constant);
+    // 2^1001 - 1, wrapped to 64 bits.
+    EXPECT_EQ(static_cast<ConstantInst *>(result)->GetValue(), UINT64_MAX);
+    EXPECT_EQ(bb->GetFirstInstruction(), result);
+    EXPECT_EQ(result->GetNext(), ret);
+}
+
+// Folded products keep only the bits of their type, like any other folded constant.
+TEST(Optimization, MulFoldingWrapsToItsType) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    BasicBlock *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+
+    auto *big = builder.CreateConstant(Type::U32, 0x10000);
+    auto *arg = builder.CreateArgument(Type::U32);
+    auto *ret1 = builder.CreateRet(builder.CreateMul(big, big));
+    auto *ret2 = builder.CreateRet(builder.CreateMul(arg, builder.CreateConstant(Type::U32, 0x100000002)));
+
+    RunOptimization(&graph);
+
+    auto *val1 = ret1->GetInputs()[0];
+    ASSERT_EQ(val1->GetOpcode(), Opcode::Constant);
+    EXPECT_EQ(static_cast<ConstantInst *>(val1)->GetValue(), 0);
+
+    auto *shl = ret2->GetInputs()[0];
+    ASSERT_EQ(shl->GetOpcode(), Opcode::SHL);
+    EXPECT_EQ(static_cast<ConstantInst *>(shl->GetInputs()[1])->GetValue(), 1);
+}
+
+TEST(Optimization, AddAndShlFoldingWrapToTheirType) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    BasicBlock *bb = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb);
+
+    auto *max = builder.CreateConstant(Type::U32, 0xffffffff);
+    auto *one = builder.CreateConstant(Type::U32, 1);
+    auto *ret1 = builder.CreateRet(builder.CreateAdd(max, one));
+    auto *ret2 = builder.CreateRet(builder.CreateShl(max, builder.CreateConstant(Type::U32, 4)));
+    auto *ret3 = builder.CreateRet(builder.CreateShl(one, builder.CreateConstant(Type::U32, 64)));
+
+    RunOptimization(&graph);
+
+    for (auto [ret, expected] : {std::pair{ret1, uint64_t{0}}, {ret2, uint64_t{0xfffffff0}}, {ret3, uint64_t{0}}}) {
+        auto *val = ret->GetInputs()[0];
+        ASSERT_EQ(val->GetOpcode(), Opcode::Constant);
+        EXPECT_EQ(static_cast<ConstantInst *>(val)->GetValue(), expected);
+    }
+}
@@ -1,9 +1,16 @@
+#include "helpers/allocation_verifier.h"
+#include "helpers/factorial_graph.h"
+#include "helpers/random_cfg.h"
+#include "ir/analysis/loop_analyzer.h"
 #include "ir/ir.h"
 #include "ir/ir_builder.h"
 #include "ir/opt/register_allocator.h"
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 using namespace opt;
@@ -34,7 +41,7 @@ AllocationStats CollectAllocationStats(Graph &graph, const std::vector<Instructi
         }
     }
 
-    for (auto &block : const_cast<std::list<BasicBlock> &>(graph.GetBlocks())) {
+    for (auto &block : graph.GetBlocks()) {
         for (auto *inst = block.GetFirstInstruction(); inst; inst = inst->GetNext()) {
             if (inst->GetOpcode() == Opcode::LOAD || inst->GetOpcode() == Opcode::STORE) {
                 stats.load_stores++;
@@ -44,51 +51,6 @@ AllocationStats CollectAllocationStats(Graph &graph, const std::vector<Instructi
     return stats;
 }
 
-// Helper to check for allocation validity
-void VerifyAllocation(Graph &graph) {
-    analysis::LivenessAnalyzer liveness(&graph);
-    liveness.Analyze();
-
-    std::vector<Instruction *> instructions;
-    for (auto &block : liveness.GetLinearOrder()) {
-        for (auto *inst = block->GetFirstInstruction(); inst; inst = inst->GetNext()) {
-            instructions.push_back(inst);
-        }
-    }
-
-    for (size_t i = 0; i < instructions.size(); ++i) {
-        for (size_t j = i + 1; j < instructions.size(); ++j) {
-            auto *inst1 = instructions[i];
-            auto *inst2 = instructions[j];
-
-            auto loc1 = inst1->GetLocation();
-            auto loc2 = inst2->GetLocation();
-
-            if (loc1.GetKind() == Location::REGISTER && loc2.GetKind() == Location::REGISTER &&
-                loc1.GetValue() == loc2.GetValue()) {
-                auto interval1 = liveness.GetLiveInterval(inst1);
-                auto interval2 = liveness.GetLiveInterval(inst2);
-
-                if (interval1 && interval2) {
-                    bool intersects = false;
-                    for (const auto &r1 : interval1->GetRanges()) {
-                        for (const auto &r2 : interval2->GetRanges()) {
-                            if (r1.Intersects(r2)) {
-                                intersects = true;
-                                break;
-                            }
-                        }
-                        if (intersects)
-                            break;
-                    }
-                    EXPECT_FALSE(intersects) << "Live intervals for i" << inst1->GetId() << " and i" << inst2->GetId()
-                                             << " use the same register and intersect.";
-                }
-            }
-        }
-    }
-}
-
 // Test case to check simple register allocation and spilling
 TEST(RegisterAllocator, Spill) {
     Graph graph;
@@ -106,8 +68,11 @@ TEST(RegisterAllocator, Spill) {
     auto *v4 = builder.CreateAdd(v3, v1); // v3, v1 live
     builder.CreateRet(v4);
 
-    // Run register allocator with 1 allocatable register (+2 reserved)
+    // Run register allocator with 1 allocatable register (+2 reserved); the constants have to go to
+    // the stack rather than be re-created at their uses.
     RegisterAllocator allocator(&graph, 3);
+    allocator.SetRematerialize(false);
+    allocator.SetReserveScratchUpFront(true);
     allocator.Run();
 
     // Verification: With only 1 register, we expect some values to be spilled.
@@ -157,8 +122,9 @@ TEST(RegisterAllocator, IfElseBranch) {
     auto *v4 = builder.CreateAdd(phi, v1);
     builder.CreateRet(v4);
 
-    // Run allocator with 2 allocatable registers.
+    // Run allocator with 2 allocatable registers (+2 reserved).
     RegisterAllocator allocator(&graph, 4);
+    allocator.SetReserveScratchUpFront(true);
     allocator.Run();
 
     // Verification: Check that spilling has occurred.
@@ -311,7 +277,8 @@ TEST(RegisterAllocator, NestedLoopWithBranch) {
 
     // Inner loop
     builder.SetInsertPoint(bb_inner_header);
-    auto *phi_j = builder.CreatePhi(Type::U32); // j
+    auto *phi_j = builder.CreatePhi(Type::U32);     // j
+    auto *phi_sum_j = builder.CreatePhi(Type::U32); // sum in the inner loop
     auto *cond_j = builder.CreateCmp(ConditionCode::LT, phi_j, c5);
     builder.CreateBranch(cond_j, bb_inner_body_if, bb_outer_latch);
 
@@ -321,12 +288,12 @@ TEST(RegisterAllocator, NestedLoopWithBranch) {
     builder.CreateBranch(cond_inner, bb_inner_body_else, bb_inner_merge);
 
     builder.SetInsertPoint(bb_inner_body_else);
-    auto *upd_sum_else = builder.CreateMul(phi_sum, live_in_outer);
+    auto *upd_sum_else = builder.CreateMul(phi_sum_j, live_in_outer);
     builder.CreateJump(bb_inner_merge);
 
     builder.SetInsertPoint(bb_inner_merge);
     auto *phi_inner = builder.CreatePhi(Type::U32);
-    phi_inner->AddIncoming(phi_sum, bb_inner_body_if);
+    phi_inner->AddIncoming(phi_sum_j, bb_inner_body_if);
     phi_inner->AddIncoming(upd_sum_else, bb_inner_body_else);
     auto *upd_j = builder.CreateAdd(phi_j, c1);
     builder.CreateJump(bb_inner_header);
@@ -344,9 +311,11 @@ TEST(RegisterAllocator, NestedLoopWithBranch) {
     phi_i->AddIncoming(c0, bb_entry);
     phi_i->AddIncoming(upd_i, bb_outer_latch);
     phi_sum->AddIncoming(c0, bb_entry);
-    phi_sum->AddIncoming(phi_inner, bb_outer_latch);
+    phi_sum->AddIncoming(phi_sum_j, bb_outer_latch);
     phi_j->AddIncoming(c0, bb_outer_body);
     phi_j->AddIncoming(upd_j, bb_inner_merge);
+    phi_sum_j->AddIncoming(phi_sum, bb_outer_body);
+    phi_sum_j->AddIncoming(phi_inner, bb_inner_merge);
 
     // Run allocator with 2 allocatable registers.
     // The implementation spills in this case, so the test verifies this behavior.
@@ -360,3 +329,357 @@ TEST(RegisterAllocator, NestedLoopWithBranch) {
 
     VerifyAllocation(graph);
 }
+
+// A value used only in the else branch is in a lifetime hole during the then branch.
+TEST(RegisterAllocator, IntervalFitsInLifetimeHole) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    auto *bb_entry = graph.CreateBasicBlock();
+    auto *bb_then = graph.CreateBasicBlock();
+    auto *bb_else = graph.CreateBasicBlock();
+    auto *bb_exit = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb_entry);
+    auto *a = builder.CreateConstant(Type::U32, 7);
+    auto *cond = builder.CreateConstant(Type::BOOL, 1);
+    builder.CreateBranch(cond, bb_then, bb_else);
+
+    // Needs both registers while `a` is not live.
+    builder.SetInsertPoint(bb_then);
+    auto *b0 = builder.CreateConstant(Type::U32, 1);
+    auto *b1 = builder.CreateConstant(Type::U32, 2);
+    auto *sum = builder.CreateAdd(b0, b1);
+    builder.CreateJump(bb_exit);
+
+    builder.SetInsertPoint(bb_else);
+    auto *twice = builder.CreateAdd(a, a);
+    builder.CreateJump(bb_exit);
+
+    builder.SetInsertPoint(bb_exit);
+    builder.CreateRet(nullptr);
+
+    // 2 allocatable registers (+2 reserved).
+    RegisterAllocator allocator(&graph, 4);
+    allocator.Run();
+
+    auto stats = CollectAllocationStats(graph, {a, cond, b0, b1, sum, twice});
+    EXPECT_EQ(stats.stack_locations, 0);
+    EXPECT_EQ(stats.load_stores, 0);
+    EXPECT_TRUE(a->GetLocation() == b0->GetLocation() || a->GetLocation() == b1->GetLocation());
+
+    VerifyAllocation(graph);
+}
+
+// The loop updates take the registers of the phis they feed, so the latch needs no moves.
+TEST(RegisterAllocator, FactorialLatchNeedsNoMoves) {
+    Graph graph;
+    BuildFactorialGraph(&graph);
+
+    // 4 allocatable registers (+2 reserved).
+    RegisterAllocator allocator(&graph, 6);
+    allocator.Run();
+
+    BasicBlock *latch = nullptr;
+    for (auto &block : graph.GetBlocks()) {
+        for (auto *inst = block.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+            if (inst->GetOpcode() == Opcode::MUL) {
+                latch = &block;
+            }
+        }
+    }
+    ASSERT_NE(latch, nullptr);
+    for (auto *inst = latch->GetFirstInstruction(); inst; inst = inst->GetNext()) {
+        EXPECT_NE(inst->GetOpcode(), Opcode::MOVE);
+        EXPECT_NE(inst->GetOpcode(), Opcode::LOAD);
+        EXPECT_NE(inst->GetOpcode(), Opcode::STORE);
+    }
+    EXPECT_GE(allocator.GetNumCoalescedMoves(), 2);
+
+    VerifyAllocation(graph);
+}
+
+TEST(RegisterAllocator, CallArgumentsPreferTheirPositionRegisters) {
+    Graph callee;
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    auto *bb0 = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb0);
+    auto *a = builder.CreateConstant(Type::U32, 1);
+    auto *b = builder.CreateConstant(Type::U32, 2);
+    auto *c = builder.CreateConstant(Type::U32, 3);
+    builder.CreateCallStatic(&callee, {c, b, a});
+    builder.CreateRet(nullptr);
+
+    RegisterAllocator allocator(&graph, 6);
+    allocator.Run();
+
+    EXPECT_EQ(c->GetLocation(), Location::MakeRegister(0));
+    EXPECT_EQ(b->GetLocation(), Location::MakeRegister(1));
+    EXPECT_EQ(a->GetLocation(), Location::MakeRegister(2));
+
+    VerifyAllocation(graph);
+}
+
+// `a` is not needed while b0 and b1 take both registers, so it goes to the stack for that stretch
+// only: it keeps its register at the definition and is reloaded before its use.
+TEST(RegisterAllocator, SplitSpillsOnlyBetweenUses) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    auto *bb0 = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb0);
+    auto *a = builder.CreateConstant(Type::U32, 7);
+    auto *b0 = builder.CreateConstant(Type::U32, 1);
+    auto *b1 = builder.CreateConstant(Type::U32, 2);
+    auto *sum = builder.CreateAdd(b0, b1);
+    auto *result = builder.CreateAdd(sum, a);
+    builder.CreateRet(result);
+
+    // 2 allocatable registers (+2 reserved); `a` is not re-created, so that it needs the stack.
+    RegisterAllocator allocator(&graph, 4);
+    allocator.SetRematerialize(false);
+    allocator.SetReserveScratchUpFront(true);
+    allocator.Run();
+
+    auto stats = CollectAllocationStats(graph, {a, b0, b1, sum, result});
+    EXPECT_EQ(stats.stack_locations, 0);
+    std::vector<Instruction *> spill_code;
+    for (auto *inst = bb0->GetFirstInstruction(); inst; inst = inst->GetNext()) {
+        if (inst->GetOpcode() == Opcode::LOAD || inst->GetOpcode() == Opcode::STORE) {
+            spill_code.push_back(inst);
+        }
+    }
+    ASSERT_EQ(spill_code.size(), 2);
+    EXPECT_EQ(spill_code[0]->GetOpcode(), Opcode::STORE);
+    EXPECT_EQ(spill_code[1]->GetOpcode(), Opcode::LOAD);
+    EXPECT_EQ(ValueOf(spill_code[0]), a);
+    EXPECT_EQ(ValueOf(spill_code[1]), a);
+    EXPECT_EQ(result->GetInputs()[1], spill_code[1]);
+
+    VerifyAllocation(graph);
+}
+
+// Two groups of values that are live one after the other: the second group spills into the slots
+// the first one no longer needs, and each slot is sized and aligned for its type.
+TEST(RegisterAllocator, StackSlotsAreReusedAfterTheirValuesDie) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    auto *bb0 = graph.CreateBasicBlock();
+    builder.SetInsertPoint(bb0);
+    Instruction *sum = builder.CreateConstant(Type::U64, 0);
+    std::vector<Instruction *> values;
+    for (int group = 0; group < 2; ++group) {
+        std::vector<Instruction *> group_values;
+        for (int i = 0; i < 4; ++i) {
+            group_values.push_back(builder.CreateConstant(i % 2 == 0 ? Type::U32 : Type::U64, group * 10 + i));
+        }
+        for (auto *value : group_values) {
+            sum = builder.CreateAdd(sum, value);
+        }
+        values.insert(values.end(), group_values.begin(), group_values.end());
+    }
+    builder.CreateRet(sum);
+
+    // 1 allocatable register (+2 reserved); the constants stand in for values that need the stack.
+    RegisterAllocator allocator(&graph, 3);
+    allocator.SetRematerialize(false);
+    allocator.Run();
+
+    std::map<int32_t, Type> slot_types;
+    std::set<Instruction *> spilled;
+    for (auto &block : graph.GetBlocks()) {
+        for (auto *inst = block.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+            Location location = inst->GetLocation();
+            if (location.GetKind() != Location::STACK) {
+                continue;
+            }
+            Type type = ValueOf(inst)->GetType();
+            EXPECT_EQ(-location.GetValue() % GetTypeSize(type), 0);
+            auto [it, inserted] = slot_types.emplace(location.GetValue(), type);
+            EXPECT_EQ(it->second, type);
+            spilled.insert(ValueOf(inst));
+        }
+    }
+    EXPECT_GT(spilled.size(), slot_types.size());
+    uint32_t frame_size = 0;
+    for (const auto &[offset, type] : slot_types) {
+        frame_size = std::max<uint32_t>(frame_size, -offset);
+    }
+    EXPECT_EQ(graph.GetFrameSize(), (frame_size + 7) / 8 * 8);
+    EXPECT_LT(graph.GetFrameSize(), 8 * values.size());
+
+    VerifyAllocation(graph);
+}
+
+// Constants used in a loop under pressure are created again where they are needed: none of them
+// is stored or reloaded, and the loop body needs no stack access for them.
+TEST(RegisterAllocator, SpilledConstantsAreRematerialized) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *c0 = builder.CreateConstant(Type::U32, 0);
+    auto *c1 = builder.CreateConstant(Type::U32, 1);
+    auto *c3 = builder.CreateConstant(Type::U32, 3);
+    auto *c7 = builder.CreateConstant(Type::U32, 7);
+    auto *c100 = builder.CreateConstant(Type::U32, 100);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb1);
+    auto *i = builder.CreatePhi(Type::U32);
+    auto *acc = builder.CreatePhi(Type::U32);
+    auto *cond = builder.CreateCmp(ConditionCode::LT, i, c100);
+    builder.CreateBranch(cond, bb2, bb3);
+
+    builder.SetInsertPoint(bb2);
+    auto *scaled = builder.CreateMul(acc, c3);
+    auto *biased = builder.CreateAdd(scaled, c7);
+    auto *next_i = builder.CreateAdd(i, c1);
+    builder.CreateJump(bb1);
+
+    i->AddIncoming(c0, bb0);
+    i->AddIncoming(next_i, bb2);
+    acc->AddIncoming(c1, bb0);
+    acc->AddIncoming(biased, bb2);
+
+    builder.SetInsertPoint(bb3);
+    builder.CreateRet(acc);
+
+    // 3 allocatable registers (+2 reserved): enough for the phis and one temporary, the constants
+    // make way.
+    RegisterAllocator allocator(&graph, 5);
+    allocator.Run();
+
+    EXPECT_GT(allocator.GetNumRematerializations(), 0);
+    for (auto &block : graph.GetBlocks()) {
+        for (auto *inst = block.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+            if (inst->GetOpcode() == Opcode::LOAD || inst->GetOpcode() == Opcode::STORE) {
+                EXPECT_NE(ValueOf(inst)->GetOpcode(), Opcode::Constant) << "i" << inst->GetId();
+            }
+        }
+    }
+    for (auto *inst = bb2->GetFirstInstruction(); inst; inst = inst->GetNext()) {
+        EXPECT_NE(inst->GetOpcode(), Opcode::LOAD);
+        EXPECT_NE(inst->GetOpcode(), Opcode::STORE);
+    }
+    EXPECT_EQ(graph.GetFrameSize(), 0);
+
+    VerifyAllocation(graph);
+}
+
+// Two phis trade their values on every iteration. Without spills no register is reserved, and the
+// cycle of moves on the back edge becomes a single swap.
+TEST(RegisterAllocator, PhiCyclesAreSwappedWithoutReservedRegisters) {
+    Graph graph;
+    IRBuilder builder(&graph);
+
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *a0 = builder.CreateArgument(Type::U32);
+    auto *b0 = builder.CreateArgument(Type::U32);
+    auto *n = builder.CreateArgument(Type::U32);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb1);
+    auto *a = builder.CreatePhi(Type::U32);
+    auto *b = builder.CreatePhi(Type::U32);
+    auto *cond = builder.CreateCmp(ConditionCode::LT, a, n);
+    builder.CreateBranch(cond, bb2, bb3);
+
+    builder.SetInsertPoint(bb2);
+    builder.CreateJump(bb1);
+
+    builder.SetInsertPoint(bb3);
+    builder.CreateRet(b);
+
+    a->AddIncoming(a0, bb0);
+    a->AddIncoming(b, bb2);
+    b->AddIncoming(b0, bb0);
+    b->AddIncoming(a, bb2);
+
+    // Four registers fit all values; reserving two would have left too few.
+    RegisterAllocator allocator(&graph, 4);
+    allocator.Run();
+
+    EXPECT_EQ(allocator.GetNumReservedRegisters(), 0);
+    auto stats = CollectAllocationStats(graph, {a0, b0, n, a, b, cond});
+    EXPECT_EQ(stats.stack_locations, 0);
+    EXPECT_EQ(stats.load_stores, 0);
+    size_t swaps = 0;
+    size_t moves = 0;
+    for (auto *inst = bb2->GetFirstInstruction(); inst; inst = inst->GetNext()) {
+        if (inst->GetOpcode() == Opcode::SWAP && !static_cast<SwapInst *>(inst)->IsSecondHalf()) {
+            ++swaps;
+        }
+        moves += inst->GetOpcode() == Opcode::MOVE;
+    }
+    EXPECT_EQ(swaps, 1);
+    EXPECT_EQ(moves, 0);
+
+    VerifyAllocation(graph);
+}
+
+TEST(RegisterAllocator, RandomGraphsAllocateCorrectly) {
+    size_t checked = 0;
+    for (auto heuristic : {SpillHeuristic::FURTHEST_USE, SpillHeuristic::SPILL_WEIGHT}) {
+        for (uint32_t num_regs : {3, 4, 6, 8}) {
+            for (uint32_t seed = 0; seed < 30; ++seed) {
+                SCOPED_TRACE("seed " + std::to_string(seed) + ", " + std::to_string(num_regs) + " registers");
+                Graph graph;
+                BuildRandomCFG(&graph, 12 + seed, seed, 0.2);
+                AddRandomValues(&graph, seed);
+
+                LoopAnalyzer loops(&graph);
+                loops.Analyze();
+                if (std::any_of(loops.GetLoops().begin(), loops.GetLoops().end(),
+                                [](Loop *loop) { return !loop->IsReducible(); })) {
+                    continue; // liveness is only exact for reducible loops
+                }
+                ++checked;
+
+                RegisterAllocator allocator(&graph, num_regs, heuristic);
+                allocator.Run();
+                VerifyAllocation(graph);
+            }
+        }
+    }
+    EXPECT_GT(checked, 120);
+}
+
+TEST(RegisterAllocator, GraphColoringAllocatesRandomGraphsCorrectly) {
+    size_t checked = 0;
+    for (uint32_t num_regs : {3, 4, 6, 8}) {
+        for (uint32_t seed = 0; seed < 30; ++seed) {
+            SCOPED_TRACE("seed " + std::to_string(seed) + ", " + std::to_string(num_regs) + " registers");
+            Graph graph;
+            BuildRandomCFG(&graph, 12 + seed, seed, 0.2);
+            AddRandomValues(&graph, seed);
+
+            LoopAnalyzer loops(&graph);
+            loops.Analyze();
+            if (std::any_of(loops.GetLoops().begin(), loops.GetLoops().end(),
+                            [](Loop *loop) { return !loop->IsReducible(); })) {
+                continue; // liveness is only exact for reducible loops
+            }
+            ++checked;
+
+            RegisterAllocator allocator(&graph, num_regs);
+            allocator.SetMode(AllocationMode::GRAPH_COLORING);
+            allocator.Run();
+            VerifyAllocation(graph);
+        }
+    }
+    EXPECT_GT(checked, 60);
+}
@@ -0,0 +1,75 @@
+#include "ir/ir.h"
+#include "ir/small_vector.h"
+#include <gtest/gtest.h>
+
+TEST(SmallVector, StaysInlineUpToCapacity) {
+    SmallVector<int, 2> vec;
+    EXPECT_TRUE(vec.empty());
+    vec.push_back(1);
+    vec.push_back(2);
+    EXPECT_TRUE(vec.IsInline());
+    EXPECT_EQ(vec.size(), 2);
+    EXPECT_EQ(vec[0], 1);
+    EXPECT_EQ(vec.back(), 2);
+}
+
+TEST(SmallVector, SpillsToHeap) {
+    SmallVector<int, 2> vec;
+    for (int i = 0; i < 10; ++i) {
+        vec.push_back(i);
+    }
+    EXPECT_FALSE(vec.IsInline());
+    ASSERT_EQ(vec.size(), 10);
+    int expected = 0;
+    for (int value : vec) {
+        EXPECT_EQ(value, expected++);
+    }
+
+    vec.resize(3);
+    EXPECT_EQ(vec.size(), 3);
+    vec.resize(5, 42);
+    EXPECT_EQ(vec[4], 42);
+    vec.clear();
+    EXPECT_TRUE(vec.empty());
+}
+
+TEST(SmallVector, InstructionOperandsAreInline) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+    auto *merge = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *c1 = builder.CreateConstant(Type::U32, 1);
+    auto *c2 = builder.CreateConstant(Type::U32, 2);
+    auto *add = builder.CreateAdd(c1, c2);
+    auto *cast = builder.CreateCast(Type::U64, add);
+    auto *cond = builder.CreateCmp(ConditionCode::EQ, c1, c2);
+    builder.CreateBranch(cond, bb1, bb2);
+
+    builder.SetInsertPoint(bb1);
+    builder.CreateJump(merge);
+    builder.SetInsertPoint(bb2);
+    auto *cond2 = builder.CreateCmp(ConditionCode::NE, c1, c2);
+    builder.CreateBranch(cond2, bb3, merge);
+    builder.SetInsertPoint(bb3);
+    builder.CreateJump(merge);
+
+    builder.SetInsertPoint(merge);
+    auto *phi = builder.CreatePhi(Type::U32);
+    phi->AddIncoming(c1, bb1);
+    phi->AddIncoming(c2, bb2);
+    EXPECT_TRUE(phi->GetInputs().IsInline());
+    phi->AddIncoming(add, bb3);
+    builder.CreateRet(phi);
+
+    EXPECT_TRUE(add->GetInputs().IsInline());
+    EXPECT_TRUE(cast->GetInputs().IsInline());
+    EXPECT_FALSE(phi->GetInputs().IsInline());
+    ASSERT_EQ(phi->GetInputs().size(), 3);
+    EXPECT_EQ(phi->GetInputs()[2], add);
+    EXPECT_EQ(add->GetFirstUser()->GetUserInstruction(), phi);
+}
@@ -0,0 +1,258 @@
+#include "helpers/factorial_graph.h"
+#include "helpers/random_cfg.h"
+#include "ir/analysis/analysis_manager.h"
+#include "ir/analysis/loop_analyzer.h"
+#include "ir/ir.h"
+#include "ir/opt/graph_coloring.h"
+#include "ir/opt/register_allocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+struct SpillCost {
+    size_t spill_code = 0;
+    double weighted = 0;
+};
+
+// Loads and stores inserted by the allocator; each one also counts ten times per enclosing loop.
+static SpillCost MeasureSpillCode(Graph *graph) {
+    SpillCost cost;
+    LoopAnalyzer &loops = graph->GetAnalyses().GetLoopAnalyzer();
+    for (auto &bb : graph->GetBlocks()) {
+        double weight = std::pow(10.0, static_cast<double>(loops.GetLoopsForBlock(&bb).size()));
+        for (auto *inst = bb.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+            if (inst->GetOpcode() == Opcode::LOAD || inst->GetOpcode() == Opcode::STORE) {
+                ++cost.spill_code;
+                cost.weighted += weight;
+            }
+        }
+    }
+    return cost;
+}
+
+static bool IsReducible(Graph *graph) {
+    LoopAnalyzer loops(graph);
+    loops.Analyze();
+    return std::none_of(loops.GetLoops().begin(), loops.GetLoops().end(),
+                        [](Loop *loop) { return !loop->IsReducible(); });
+}
+
+// Spill code, moves left and allocation time of linear scan and of graph coloring on `builders`.
+static void CompareWithGraphColoring(const std::vector<std::function<void(Graph *)>> &builders) {
+    std::printf("%6s %12s %12s %8s %10s %12s %12s %8s %10s\n", "regs", "scan", "(weighted)", "moves", "(us)",
+                "coloring", "(weighted)", "moves", "(us)");
+    for (uint32_t num_regs : {3, 4, 6, 8, 12}) {
+        SpillCost costs[2];
+        size_t moves[2] = {0, 0};
+        double micros[2] = {0, 0};
+        opt::AllocationMode modes[2] = {opt::AllocationMode::LINEAR_SCAN, opt::AllocationMode::GRAPH_COLORING};
+        for (int i = 0; i < 2; ++i) {
+            for (const auto &build : builders) {
+                Graph graph;
+                build(&graph);
+                opt::RegisterAllocator allocator(&graph, num_regs);
+                allocator.SetMode(modes[i]);
+                auto start = std::chrono::steady_clock::now();
+                allocator.Run();
+                micros[i] +=
+                    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                SpillCost cost = MeasureSpillCode(&graph);
+                costs[i].spill_code += cost.spill_code;
+                costs[i].weighted += cost.weighted;
+                for (auto &bb : graph.GetBlocks()) {
+                    for (auto *inst = bb.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+                        moves[i] += inst->GetOpcode() == Opcode::MOVE || inst->GetOpcode() == Opcode::SWAP;
+                    }
+                }
+            }
+        }
+        std::printf("%6u %12zu %12.0f %8zu %10.0f %12zu %12.0f %8zu %10.0f\n", num_regs, costs[0].spill_code,
+                    costs[0].weighted, moves[0], micros[0], costs[1].spill_code, costs[1].weighted, moves[1],
+                    micros[1]);
+    }
+}
+
+// Graph coloring alone on a sparse interference graph of `num_nodes` nodes. As a num_nodes^2 bit
+// matrix its interference would take num_nodes^2 / 8 bytes, about 240 MB at the 44k values of the
+// largest random programs, so above MATRIX_NODE_LIMIT nodes the edges are hashed instead.
+static void TimeLargeColoring(uint32_t num_nodes) {
+    opt::GraphColoring coloring(num_nodes);
+    std::srand(num_nodes);
+    for (uint32_t node = 0; node < num_nodes; ++node) {
+        for (int i = 0; i < 8; ++i) {
+            coloring.AddInterference(node, static_cast<uint32_t>(std::rand()) % num_nodes);
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    coloring.Run(12);
+    double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    double matrix_mb = static_cast<double>(num_nodes) * num_nodes / 8 / (1 << 20);
+    std::printf("%8u nodes: %8.1f ms, a bit matrix would take %8.1f MB (%s)\n", num_nodes, millis, matrix_mb,
+                num_nodes <= opt::GraphColoring::MATRIX_NODE_LIMIT ? "used" : "hashed instead");
+}
+
+int main(int argc, char **argv) {
+    uint32_t num_seeds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 30;
+
+    // The graphs of the allocator tests: the factorial function and the reducible random CFGs.
+    // Variants with three times as many values per block keep many more values live at once.
+    std::vector<std::function<void(Graph *)>> builders = {BuildFactorialGraph};
+    std::vector<std::function<void(Graph *)>> high_pressure;
+    for (uint32_t seed = 0; seed < num_seeds; ++seed) {
+        Graph graph;
+        BuildRandomCFG(&graph, 12 + seed, seed, 0.2);
+        if (IsReducible(&graph)) {
+            builders.push_back([seed](Graph *graph) {
+                BuildRandomCFG(graph, 12 + seed, seed, 0.2);
+                AddRandomValues(graph, seed);
+            });
+            high_pressure.push_back([seed](Graph *graph) {
+                BuildRandomCFG(graph, 12 + seed, seed, 0.2);
+                AddRandomValues(graph, seed, 12);
+            });
+        }
+    }
+
+    std::printf("%u graphs; spill code as static loads and stores, weighted x10 per loop depth\n",
+                static_cast<unsigned>(builders.size()));
+    std::printf("%6s %14s %16s %14s %16s %8s\n", "regs", "furthest-use", "(weighted)", "spill-weight", "(weighted)",
+                "gain");
+    for (uint32_t num_regs : {3, 4, 6, 8, 12}) {
+        SpillCost costs[2];
+        opt::SpillHeuristic heuristics[2] = {opt::SpillHeuristic::FURTHEST_USE, opt::SpillHeuristic::SPILL_WEIGHT};
+        for (int i = 0; i < 2; ++i) {
+            for (const auto &build : builders) {
+                Graph graph;
+                build(&graph);
+                opt::RegisterAllocator(&graph, num_regs, heuristics[i]).Run();
+                SpillCost cost = MeasureSpillCode(&graph);
+                costs[i].spill_code += cost.spill_code;
+                costs[i].weighted += cost.weighted;
+            }
+        }
+        std::printf("%6u %14zu %16.0f %14zu %16.0f %7.1f%%\n", num_regs, costs[0].spill_code, costs[0].weighted,
+                    costs[1].spill_code, costs[1].weighted, 100.0 * (1.0 - costs[1].weighted / costs[0].weighted));
+    }
+
+    std::printf("\nmoves left after allocation, and phi inputs and moves that needed none\n");
+    std::printf("%6s %14s %14s %14s %14s\n", "regs", "no hints", "(coalesced)", "hints", "(coalesced)");
+    for (uint32_t num_regs : {3, 4, 6, 8, 12}) {
+        size_t moves[2] = {0, 0};
+        size_t coalesced[2] = {0, 0};
+        for (int i = 0; i < 2; ++i) {
+            for (const auto &build : builders) {
+                Graph graph;
+                build(&graph);
+                opt::RegisterAllocator allocator(&graph, num_regs);
+                allocator.SetUseHints(i == 1);
+                allocator.Run();
+                coalesced[i] += allocator.GetNumCoalescedMoves();
+                for (auto &bb : graph.GetBlocks()) {
+                    for (auto *inst = bb.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+                        moves[i] += inst->GetOpcode() == Opcode::MOVE;
+                    }
+                }
+            }
+        }
+        std::printf("%6u %14zu %14zu %14zu %14zu\n", num_regs, moves[0], coalesced[0], moves[1], coalesced[1]);
+    }
+
+    std::printf("\nspill code without and with spilled constants created again at their uses\n");
+    std::printf("%6s %14s %16s %14s %16s %14s\n", "regs", "stack", "(weighted)", "remat", "(weighted)",
+                "constants");
+    for (uint32_t num_regs : {3, 4, 6, 8, 12}) {
+        SpillCost costs[2];
+        size_t rematerialized = 0;
+        for (int i = 0; i < 2; ++i) {
+            for (const auto &build : builders) {
+                Graph graph;
+                build(&graph);
+                opt::RegisterAllocator allocator(&graph, num_regs);
+                allocator.SetRematerialize(i == 1);
+                allocator.Run();
+                rematerialized += allocator.GetNumRematerializations();
+                SpillCost cost = MeasureSpillCode(&graph);
+                costs[i].spill_code += cost.spill_code;
+                costs[i].weighted += cost.weighted;
+            }
+        }
+        std::printf("%6u %14zu %16.0f %14zu %16.0f %14zu\n", num_regs, costs[0].spill_code, costs[0].weighted,
+                    costs[1].spill_code, costs[1].weighted, rematerialized);
+    }
+
+    std::printf("\nspill code with scratch registers reserved up front and only when spilling\n");
+    std::printf("%6s %14s %16s %14s %16s %14s %8s\n", "regs", "up front", "(weighted)", "on demand", "(weighted)",
+                "unreserved", "swaps");
+    for (uint32_t num_regs : {3, 4, 6, 8, 12, 16}) {
+        SpillCost costs[2];
+        size_t unreserved = 0;
+        size_t swaps = 0;
+        for (int i = 0; i < 2; ++i) {
+            for (const auto &build : builders) {
+                Graph graph;
+                build(&graph);
+                opt::RegisterAllocator allocator(&graph, num_regs);
+                allocator.SetReserveScratchUpFront(i == 0);
+                allocator.Run();
+                SpillCost cost = MeasureSpillCode(&graph);
+                costs[i].spill_code += cost.spill_code;
+                costs[i].weighted += cost.weighted;
+                if (i == 1) {
+                    unreserved += allocator.GetNumReservedRegisters() == 0;
+                    for (auto &bb : graph.GetBlocks()) {
+                        for (auto *inst = bb.GetFirstInstruction(); inst; inst = inst->GetNext()) {
+                            swaps += inst->GetOpcode() == Opcode::SWAP && inst->GetInputs().size() == 2;
+                        }
+                    }
+                }
+            }
+        }
+        std::printf("%6u %14zu %16.0f %14zu %16.0f %14zu %8zu\n", num_regs, costs[0].spill_code, costs[0].weighted,
+                    costs[1].spill_code, costs[1].weighted, unreserved, swaps);
+    }
+
+    // Allocation time only: the graphs are built again for each run, outside the timed part.
+    std::printf("\nallocation time and spill code of linear scan and of the block-local allocator\n");
+    std::printf("%6s %14s %16s %14s %16s %8s\n", "regs", "scan (us)", "(weighted)", "local (us)", "(weighted)",
+                "speedup");
+    for (uint32_t num_regs : {3, 4, 6, 8, 12}) {
+        SpillCost costs[2];
+        double micros[2] = {0, 0};
+        opt::AllocationMode modes[2] = {opt::AllocationMode::LINEAR_SCAN, opt::AllocationMode::BLOCK_LOCAL};
+        for (int i = 0; i < 2; ++i) {
+            for (int repeat = 0; repeat < 10; ++repeat) {
+                for (const auto &build : builders) {
+                    Graph graph;
+                    build(&graph);
+                    opt::RegisterAllocator allocator(&graph, num_regs);
+                    allocator.SetMode(modes[i]);
+                    auto start = std::chrono::steady_clock::now();
+                    allocator.Run();
+                    micros[i] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+                                     .count();
+                    if (repeat == 0) {
+                        SpillCost cost = MeasureSpillCode(&graph);
+                        costs[i].spill_code += cost.spill_code;
+                        costs[i].weighted += cost.weighted;
+                    }
+                }
+            }
+        }
+        std::printf("%6u %14.0f %16.0f %14.0f %16.0f %7.1fx\n", num_regs, micros[0] / 10, costs[0].weighted,
+                    micros[1] / 10, costs[1].weighted, micros[0] / micros[1]);
+    }
+
+    std::printf("\nlinear scan and graph coloring: spill code, moves and swaps left, and allocation time\n");
+    CompareWithGraphColoring(builders);
+    std::printf("\nthe same on graphs with 12 values per block\n");
+    CompareWithGraphColoring(high_pressure);
+    std::printf("\ngraph coloring of sparse interference graphs with 16 neighbours per node on average\n");
+    for (uint32_t num_nodes : {4096, 44000}) {
+        TimeLargeColoring(num_nodes);
+    }
+    return 0;
+}
@@ -39,3 +39,147 @@ TEST(UseDefTest, PhiAddIncomingRegistersUses) {
     ASSERT_NE(use_on_c0, nullptr);
     EXPECT_EQ(use_on_c0->GetUserInstruction(), phi);
 }
+
+static size_t CountUsers(Instruction *inst) {
+    size_t count = 0;
+    for (User *u = inst->GetFirstUser(); u != nullptr; u = u->GetNextUser()) {
+        count++;
+    }
+    return count;
+}
+
+TEST(UseDefTest, SetInputMovesUse) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *basic_block = graph.CreateBasicBlock();
+    builder.SetInsertPoint(basic_block);
+
+    auto *const_1 = builder.CreateConstant(Type::U32, 1);
+    auto *const_2 = builder.CreateConstant(Type::U32, 2);
+    auto *const_3 = builder.CreateConstant(Type::U32, 3);
+    auto *add_inst = builder.CreateAdd(const_1, const_2);
+
+    add_inst->SetInput(0, const_3);
+
+    EXPECT_EQ(CountUsers(const_1), 0);
+    ASSERT_EQ(CountUsers(const_3), 1);
+    EXPECT_EQ(const_3->GetFirstUser()->GetUserInstruction(), add_inst);
+    EXPECT_EQ(const_3->GetFirstUser()->GetInputIndex(), 0);
+    EXPECT_EQ(const_3->GetFirstUser()->GetDef(), const_3);
+}
+
+TEST(UseDefTest, SetInputAfterClearingLinksUse) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *basic_block = graph.CreateBasicBlock();
+    builder.SetInsertPoint(basic_block);
+
+    auto *const_1 = builder.CreateConstant(Type::U32, 1);
+    auto *const_2 = builder.CreateConstant(Type::U32, 2);
+    auto *const_3 = builder.CreateConstant(Type::U32, 3);
+    auto *add_inst = builder.CreateAdd(const_1, const_2);
+
+    add_inst->SetInput(0, nullptr);
+    EXPECT_EQ(CountUsers(const_1), 0);
+    add_inst->SetInput(0, const_1);
+
+    ASSERT_EQ(CountUsers(const_1), 1);
+    EXPECT_EQ(const_1->GetFirstUser()->GetUserInstruction(), add_inst);
+    const_1->ReplaceAllUsesWith(const_3);
+    EXPECT_EQ(add_inst->GetInputs()[0], const_3);
+    EXPECT_EQ(CountUsers(const_1), 0);
+}
+
+TEST(UseDefTest, ReplaceAllUsesWithUnlinksOldUses) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *basic_block = graph.CreateBasicBlock();
+    builder.SetInsertPoint(basic_block);
+
+    auto *arg = builder.CreateArgument(Type::U32);
+    auto *const_0 = builder.CreateConstant(Type::U32, 0);
+    auto *add_inst = builder.CreateAdd(arg, const_0);
+    auto *mul_inst = builder.CreateMul(add_inst, add_inst);
+    auto *ret = builder.CreateRet(add_inst);
+
+    EXPECT_EQ(CountUsers(add_inst), 3);
+    add_inst->ReplaceAllUsesWith(arg);
+
+    EXPECT_EQ(CountUsers(add_inst), 0);
+    EXPECT_EQ(CountUsers(arg), 4);
+    EXPECT_EQ(mul_inst->GetInputs()[0], arg);
+    EXPECT_EQ(mul_inst->GetInputs()[1], arg);
+    EXPECT_EQ(ret->GetInputs()[0], arg);
+
+    // Repeated replacement keeps use-lists proportional to live uses.
+    arg->ReplaceAllUsesWith(const_0);
+    EXPECT_EQ(CountUsers(arg), 0);
+    EXPECT_EQ(CountUsers(const_0), 5);
+}
+
+TEST(UseDefTest, EraseInstructionReleasesUses) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *basic_block = graph.CreateBasicBlock();
+    builder.SetInsertPoint(basic_block);
+
+    auto *const_1 = builder.CreateConstant(Type::U32, 1);
+    auto *const_2 = builder.CreateConstant(Type::U32, 2);
+    auto *add_inst = builder.CreateAdd(const_1, const_2);
+
+    basic_block->EraseInstruction(add_inst);
+    EXPECT_EQ(CountUsers(const_1), 0);
+    EXPECT_EQ(CountUsers(const_2), 0);
+    EXPECT_TRUE(add_inst->GetInputs().empty());
+
+    // Released use nodes are recycled by the next registrations.
+    size_t allocated = graph.GetArena()->GetAllocatedBytes();
+    auto *mul_inst = graph.NewInstruction<BinaryInst>(Opcode::MUL, Type::U32, const_1, const_2);
+    size_t after_inst = graph.GetArena()->GetAllocatedBytes();
+    EXPECT_GT(after_inst, allocated);
+    basic_block->PushBackInstruction(mul_inst);
+    graph.RegisterUse(const_1, mul_inst, 0);
+    graph.RegisterUse(const_2, mul_inst, 1);
+    EXPECT_EQ(graph.GetArena()->GetAllocatedBytes(), after_inst);
+    EXPECT_EQ(CountUsers(const_1), 1);
+    EXPECT_EQ(CountUsers(const_2), 1);
+}
+
+TEST(UseDefTest, RemoveSuccessorDropsPhiInput) {
+    Graph graph;
+    IRBuilder builder(&graph);
+    auto *bb0 = graph.CreateBasicBlock();
+    auto *bb1 = graph.CreateBasicBlock();
+    auto *bb2 = graph.CreateBasicBlock();
+    auto *bb3 = graph.CreateBasicBlock();
+
+    builder.SetInsertPoint(bb0);
+    auto *const_0 = builder.CreateConstant(Type::U32, 0);
+    auto *const_1 = builder.CreateConstant(Type::U32, 1);
+    auto *const_2 = builder.CreateConstant(Type::U32, 2);
+    builder.CreateJump(bb3);
+    builder.SetInsertPoint(bb1);
+    builder.CreateJump(bb3);
+    builder.SetInsertPoint(bb2);
+    builder.CreateJump(bb3);
+
+    builder.SetInsertPoint(bb3);
+    auto *phi = builder.CreatePhi(Type::U32);
+    phi->AddIncoming(const_0, bb0);
+    phi->AddIncoming(const_1, bb1);
+    phi->AddIncoming(const_2, bb2);
+
+    bb0->RemoveSuccessor(bb3);
+    EXPECT_TRUE(bb0->GetSuccessors().empty());
+    EXPECT_EQ(bb3->GetPredecessors(), (std::vector<BasicBlock *>{bb1, bb2}));
+    ASSERT_EQ(phi->GetInputs().size(), 2);
+    EXPECT_EQ(phi->GetInputs()[0], const_1);
+    EXPECT_EQ(CountUsers(const_0), 0);
+    // The use of the remaining inputs follows them to their new index.
+    EXPECT_EQ(const_2->GetFirstUser()->GetInputIndex(), 1);
+
+    graph.RemoveBasicBlock(bb1);
+    EXPECT_EQ(graph.GetBlocks().size(), 3);
+    EXPECT_EQ(phi->GetInputs().size(), 1);
+    EXPECT_EQ(CountUsers(const_1), 0);
+}